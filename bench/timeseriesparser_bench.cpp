@@ -0,0 +1,175 @@
+// Times TimeSeriesParser against the QJsonDocument path it replaced, on a synthetic TIME_SERIES_INTRADAY response laid
+// out like the vendor's (pretty-printed, newest bar first), and parseEasternTimestamp against QDateTime::fromString on
+// bar keys, checking it against the America/New_York zone of the system. Build with -DSTOCKTRACKER_BUILD_BENCHMARKS=ON and
+// run
+//   timeseriesparser-bench [bars] [runs]
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QTextStream>
+#include <QTimeZone>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "timeseriesparser.hpp"
+#include "timestampparser.hpp"
+
+namespace {
+  // Regular-session 5min bars going back from a fixed date, 78 per weekday
+  QByteArray makeResponse(int barCount) {
+    QByteArray response;
+    response.reserve(qsizetype(barCount) * 170 + 512);
+    response += "{\n    \"Meta Data\": {\n"
+                "        \"1. Information\": \"Intraday (5min) open, high, low, close prices and volume\",\n"
+                "        \"2. Symbol\": \"IBM\",\n"
+                "        \"3. Last Refreshed\": \"2025-06-27 16:00:00\",\n"
+                "        \"4. Interval\": \"5min\",\n"
+                "        \"5. Output Size\": \"Full size\",\n"
+                "        \"6. Time Zone\": \"US/Eastern\"\n"
+                "    },\n    \"Time Series (5min)\": {\n";
+    QDate  day(2025, 6, 27);
+    double price = 180.0;
+    int    bars  = 0;
+    while (bars < barCount) {
+      if (day.dayOfWeek() <= 5) {
+        for (int slot = 77; slot >= 0 && bars < barCount; --slot, ++bars) {
+          const QTime  time   = QTime(9, 30).addSecs(slot * 300 + 300);
+          const double open   = price;
+          const double close  = price + ((bars * 7919) % 41 - 20) * 0.01;
+          const double high   = std::max(open, close) + 0.05;
+          const double low    = std::min(open, close) - 0.05;
+          price               = close;
+          const QString bar   = QString("%1        \"%2 %3\": {\n"
+                                        "            \"1. open\": \"%4\",\n"
+                                        "            \"2. high\": \"%5\",\n"
+                                        "            \"3. low\": \"%6\",\n"
+                                        "            \"4. close\": \"%7\",\n"
+                                        "            \"5. volume\": \"%8\"\n"
+                                        "        }")
+                                .arg(bars == 0 ? QString() : QString(",\n"), day.toString("yyyy-MM-dd"), time.toString("hh:mm:ss"))
+                                .arg(open, 0, 'f', 4)
+                                .arg(high, 0, 'f', 4)
+                                .arg(low, 0, 'f', 4)
+                                .arg(close, 0, 'f', 4)
+                                .arg(1000 + (bars * 104729) % 90000);
+          response += bar.toLatin1();
+        }
+      }
+      day = day.addDays(-1);
+    }
+    response += "\n    }\n}";
+    return response;
+  }
+
+  // What StockDataFetcher::onNetworkReplyFinished did before: a QJsonObject per bar, QString conversions, a QMap
+  qsizetype parseWithQJson(const QByteArray &response) {
+    QMap<time_record_t, HistoricalDataRecord> bars;
+    const QJsonObject series = QJsonDocument::fromJson(response).object()["Time Series (5min)"].toObject();
+    for (auto it = series.begin(); it != series.end(); ++it) {
+      const QJsonObject   values = it.value().toObject();
+      const time_record_t time   = QDateTime::fromString(it.key(), "yyyy-MM-dd hh:mm:ss").toSecsSinceEpoch();
+      bars.insert(time, { values["1. open"].toString().toDouble(), values["2. high"].toString().toDouble(),
+                          values["3. low"].toString().toDouble(), values["4. close"].toString().toDouble(),
+                          values["5. volume"].toString().toLongLong() });
+    }
+    return bars.size();
+  }
+
+  qsizetype parseWithParser(const QByteArray &response) {
+    TimeSeriesParser parser;
+    return parser.parse(response) ? parser.bars().size() : -1;
+  }
+
+  qsizetype parseKeysWithQDateTime(const QList<QByteArray> &keys) {
+    qsizetype valid = 0;
+    for (const QByteArray &key : keys) {
+      valid += QDateTime::fromString(QString::fromLatin1(key), "yyyy-MM-dd hh:mm:ss").isValid();
+    }
+    return valid;
+  }
+
+  qsizetype parseKeysWithParser(const QList<QByteArray> &keys) {
+    qsizetype valid = 0;
+    for (const QByteArray &key : keys) {
+      time_record_t time;
+      valid += parseEasternTimestamp(key.constData(), key.constData() + key.size(), time);
+    }
+    return valid;
+  }
+
+  // Every hour from 1990 to 2030 at half past, both DST changes of each year included
+  QList<QByteArray> makeKeys() {
+    QList<QByteArray> keys;
+    for (QDateTime time(QDate(1990, 1, 1), QTime(0, 30), QTimeZone::utc()); time.date().year() < 2030; time = time.addSecs(60 * 60)) {
+      keys.append(time.toString("yyyy-MM-dd hh:mm:ss").toLatin1());
+    }
+    return keys;
+  }
+
+  // Keys parseEasternTimestamp converts differently from the system's zone database. Keys within an hour of a change are
+  // left out, the hour skipped in spring and the one repeated in the fall have no single answer
+  qsizetype countMismatches(const QList<QByteArray> &keys) {
+    const QTimeZone eastern("America/New_York");
+    qsizetype       mismatches = 0;
+    for (const QByteArray &key : keys) {
+      const QDateTime expected(QDate::fromString(QString::fromLatin1(key.left(10)), "yyyy-MM-dd"),
+                               QTime::fromString(QString::fromLatin1(key.mid(11)), "hh:mm:ss"), eastern);
+      if (eastern.isDaylightTime(expected.addSecs(-60 * 60)) != eastern.isDaylightTime(expected.addSecs(60 * 60))) {
+        continue;
+      }
+      time_record_t time;
+      if (!parseEasternTimestamp(key.constData(), key.constData() + key.size(), time) || time != expected.toSecsSinceEpoch()) {
+        mismatches++;
+      }
+    }
+    return mismatches;
+  }
+
+  // Median of the runs, in milliseconds
+  double timeRuns(int runs, const std::function<qsizetype()> &parse, qsizetype &bars) {
+    std::vector<double> times;
+    for (int i = 0; i < runs; ++i) {
+      QElapsedTimer timer;
+      timer.start();
+      bars = parse();
+      times.push_back(timer.nsecsElapsed() / 1e6);
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+  }
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  const QStringList arguments = app.arguments();
+  const int         barCount  = arguments.size() > 1 ? arguments.at(1).toInt() : 25000;  // About 4 MB
+  const int         runs      = arguments.size() > 2 ? std::max(1, arguments.at(2).toInt()) : 15;
+
+  const QByteArray response = makeResponse(barCount);
+  QTextStream      out(stdout);
+  out << "Response: " << response.size() / 1024 << " KiB, " << barCount << " bars, median of " << runs << " runs\n";
+
+  qsizetype    qjsonBars = 0, parserBars = 0;
+  const double qjsonMs   = timeRuns(runs, [&]() { return parseWithQJson(response); }, qjsonBars);
+  const double parserMs  = timeRuns(runs, [&]() { return parseWithParser(response); }, parserBars);
+  out << QString("QJsonDocument + QMap:  %1 ms, %2 bars\n").arg(qjsonMs, 0, 'f', 2).arg(qjsonBars);
+  out << QString("TimeSeriesParser:      %1 ms, %2 bars\n").arg(parserMs, 0, 'f', 2).arg(parserBars);
+  out << QString("Speed-up:              %1x\n").arg(qjsonMs / std::max(parserMs, 1e-3), 0, 'f', 1);
+
+  const QList<QByteArray> keys       = makeKeys();
+  qsizetype               parsedKeys = 0;
+  const double            qtKeysMs   = timeRuns(runs, [&]() { return parseKeysWithQDateTime(keys); }, parsedKeys);
+  const double            keysMs     = timeRuns(runs, [&]() { return parseKeysWithParser(keys); }, parsedKeys);  // Last, counted
+  const qsizetype         mismatches = countMismatches(keys);
+  out << QString("\n%1 keys, 1990 to 2030\n").arg(keys.size());
+  out << QString("QDateTime::fromString: %1 ns per key\n").arg(qtKeysMs * 1e6 / keys.size(), 0, 'f', 1);
+  out << QString("parseEasternTimestamp: %1 ns per key, %2 differ from America/New_York\n")
+           .arg(keysMs * 1e6 / keys.size(), 0, 'f', 1)
+           .arg(mismatches);
+  return qjsonBars == parserBars && parsedKeys == keys.size() && mismatches == 0 ? 0 : 1;
+}
@@ -51,6 +51,7 @@ class AutoScaleChartView : public QChartView {
           // Constrain to data bounds
           constrainToBounds(newMin, newMax, dataBounds);
           xAxis->setRange(newMin, newMax);
+          requestOlderDataIfAtStart(newMin, dataBounds);
 
           autoScaleYAxis();
         }
@@ -96,6 +97,7 @@ class AutoScaleChartView : public QChartView {
 
           xAxis->setRange(newMin, newMax);
           autoScaleYAxis();
+          requestOlderDataIfAtStart(newMin, dataBounds);
 
           lastPanPoint = event->pos();
         }
@@ -116,7 +118,17 @@ class AutoScaleChartView : public QChartView {
       }
     }
 
+  signals:
+    // Emitted when panning or zooming reaches the first loaded bar, so the owner can page in older history
+    void olderDataRequested(qint64 oldestLoadedMSecs);
+
   private:
+    void requestOlderDataIfAtStart(const QDateTime &newMin, const QPair<QDateTime, QDateTime> &dataBounds) {
+      if (!dataBounds.first.isNull() && newMin <= dataBounds.first) {
+        emit olderDataRequested(dataBounds.first.toMSecsSinceEpoch());
+      }
+    }
+
     QPair<QDateTime, QDateTime> getDataBounds() {
       if (!chart()) {
         return QPair<QDateTime, QDateTime>();
@@ -0,0 +1,248 @@
+#include "barcodec.hpp"
+#include <QDebug>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+  // Differences are taken modulo 2^64 so they never overflow, decoding wraps back the same way
+  qint64 wrappingSub(qint64 a, qint64 b) {
+    return qint64(quint64(a) - quint64(b));
+  }
+  qint64 wrappingAdd(qint64 a, qint64 b) {
+    return qint64(quint64(a) + quint64(b));
+  }
+
+  void putUnsigned(QByteArray &out, quint64 value) {
+    while (value >= 0x80) {
+      out.append(char(value | 0x80));
+      value >>= 7;
+    }
+    out.append(char(value));
+  }
+  void putSigned(QByteArray &out, qint64 value) {
+    putUnsigned(out, (quint64(value) << 1) ^ quint64(value >> 63));  // Zigzag, small negatives stay small
+  }
+
+  // Bounds-checked varint reader, a truncated or corrupt block sets ok to false instead of reading past the end
+  struct VarintReader {
+      const uchar *position;
+      const uchar *end;
+      bool         ok { true };
+
+      quint64 readUnsigned() {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+          if (position == end) {
+            ok = false;
+            return 0;
+          }
+          uchar byte  = *position++;
+          value      |= quint64(byte & 0x7f) << shift;
+          if (!(byte & 0x80)) {
+            return value;
+          }
+        }
+        ok = false;
+        return 0;
+      }
+      qint64 readSigned() {
+        quint64 value = readUnsigned();
+        return qint64(value >> 1) ^ -qint64(value & 1);
+      }
+  };
+
+  quint64 priceBits(price_t price) {
+    quint64 bits;
+    std::memcpy(&bits, &price, sizeof(bits));
+    return bits;
+  }
+  price_t bitsPrice(quint64 bits) {
+    price_t price;
+    std::memcpy(&price, &bits, sizeof(price));
+    return price;
+  }
+}  // namespace
+
+price_t CompressedBarSeries::fromTicks(qint64 ticks) {
+#ifdef STOCKTRACKER_FIXED_POINT_PRICES
+  return FixedPrice::fromTicks(ticks);
+#else
+  return double(ticks) / PRICE_SCALE;
+#endif
+}
+
+bool CompressedBarSeries::toTicks(price_t price, qint64 &ticks) {
+#ifdef STOCKTRACKER_FIXED_POINT_PRICES
+  ticks = price.ticks();  // Already ticks of PRICE_SCALE
+  return true;
+#else
+  if (!std::isfinite(price) || std::abs(price) > 1e12) {
+    return false;
+  }
+  ticks = std::llround(price * PRICE_SCALE);
+  return double(ticks) / PRICE_SCALE == price;  // Only exact ticks, the codec never rounds
+#endif
+}
+
+CompressedBarSeries::Block CompressedBarSeries::encodeBlock(const BarSeries &bars, qsizetype begin, qsizetype count) {
+  const qsizetype end = begin + count;
+  Block           block;
+  block.count          = qint32(count);
+  block.firstTimestamp = bars.timestamp(begin);
+  block.fixedPoint     = true;
+  qint64 ticks;
+  for (qsizetype i = begin; i < end && block.fixedPoint; ++i) {
+    block.fixedPoint = toTicks(bars.opens().at(i), ticks) && toTicks(bars.highs().at(i), ticks) && toTicks(bars.lows().at(i), ticks)
+                       && toTicks(bars.closes().at(i), ticks);
+  }
+
+  QByteArray &out = block.data;
+  out.reserve(count * 12);
+  time_record_t previousTime  = 0;
+  qint64        previousDelta = 0;
+  qint64        previousClose = 0;
+  quint64       previousBits[4] {};
+  for (qsizetype i = begin; i < end; ++i) {
+    const time_record_t time = bars.timestamp(i);
+    if (i == begin) {
+      putSigned(out, time);
+    } else {
+      qint64 delta = wrappingSub(time, previousTime);
+      putSigned(out, wrappingSub(delta, previousDelta));
+      previousDelta = delta;
+    }
+    previousTime = time;
+
+    const HistoricalDataRecord bar = bars.record(i);
+    if (block.fixedPoint) {
+      qint64 open, high, low, close;
+      toTicks(bar.open, open);
+      toTicks(bar.high, high);
+      toTicks(bar.low, low);
+      toTicks(bar.close, close);
+      putSigned(out, open - previousClose);
+      putSigned(out, high - open);
+      putSigned(out, low - open);
+      putSigned(out, close - open);
+      previousClose = close;
+    } else {
+      // Neighbouring doubles share sign, exponent and leading mantissa bits, so their XOR has its zero bytes on top
+      // once byte-swapped, which the varint then drops
+      const price_t prices[4] { bar.open, bar.high, bar.low, bar.close };
+      for (int column = 0; column < 4; ++column) {
+        quint64 bits = priceBits(prices[column]);
+        putUnsigned(out, qbswap(bits ^ previousBits[column]));
+        previousBits[column] = bits;
+      }
+    }
+    putSigned(out, bar.volume);
+  }
+  block.lastTimestamp = previousTime;
+  out.squeeze();
+  return block;
+}
+
+bool CompressedBarSeries::decodeBlock(const Block &block, time_record_t from, time_record_t to, BarSeries &out) {
+  VarintReader reader { reinterpret_cast<const uchar *>(block.data.constData()),
+                        reinterpret_cast<const uchar *>(block.data.constData()) + block.data.size() };
+  time_record_t time          = 0;
+  qint64        previousDelta = 0;
+  qint64        previousClose = 0;
+  quint64       previousBits[4] {};
+  for (qint32 i = 0; i < block.count; ++i) {
+    if (i == 0) {
+      time = reader.readSigned();
+    } else {
+      previousDelta = wrappingAdd(previousDelta, reader.readSigned());
+      time          = wrappingAdd(time, previousDelta);
+    }
+
+    price_t prices[4];
+    if (block.fixedPoint) {
+      qint64 open   = previousClose + reader.readSigned();
+      qint64 high   = open + reader.readSigned();
+      qint64 low    = open + reader.readSigned();
+      qint64 close  = open + reader.readSigned();
+      previousClose = close;
+      prices[0]     = fromTicks(open);
+      prices[1]     = fromTicks(high);
+      prices[2]     = fromTicks(low);
+      prices[3]     = fromTicks(close);
+    } else {
+      for (int column = 0; column < 4; ++column) {
+        previousBits[column] ^= qbswap(reader.readUnsigned());
+        prices[column]        = bitsPrice(previousBits[column]);
+      }
+    }
+    volume_t volume = reader.readSigned();
+
+    if (!reader.ok) {
+      qWarning() << "Truncated bar block starting at" << block.firstTimestamp << ", decoded" << i << "of" << block.count << "bars.";
+      return false;
+    }
+    if (time > to) {
+      break;  // Bars are sorted, nothing after this one is wanted
+    }
+    if (time >= from) {
+      out.append(time, HistoricalDataRecord(prices[0], prices[1], prices[2], prices[3], volume));
+    }
+  }
+  return true;
+}
+
+qsizetype CompressedBarSeries::encodedBytes() const {
+  qsizetype bytes = blocks.capacity() * qsizetype(sizeof(Block));
+  for (const Block &block : blocks) {
+    bytes += block.data.capacity();
+  }
+  return bytes;
+}
+
+void CompressedBarSeries::clear() {
+  blocks.clear();
+  barCount = 0;
+}
+
+// Decodes the blocks from the first one the new bars reach (or the last, still open block) and encodes them again,
+// so appending newer bars only ever touches the tail
+void CompressedBarSeries::insert(const BarSeries &bars) {
+  if (bars.isEmpty()) {
+    return;
+  }
+  qsizetype firstAffected =
+    std::partition_point(blocks.cbegin(), blocks.cend(), [&](const Block &block) { return block.lastTimestamp < bars.firstTimestamp(); })
+    - blocks.cbegin();
+  if (firstAffected == blocks.size() && firstAffected > 0 && blocks.last().count < BLOCK_BARS) {
+    --firstAffected;  // Top up the partially filled last block
+  }
+
+  BarSeries merged;
+  for (qsizetype i = firstAffected; i < blocks.size(); ++i) {
+    decodeBlock(blocks.at(i), std::numeric_limits<time_record_t>::min(), std::numeric_limits<time_record_t>::max(), merged);
+    barCount -= blocks.at(i).count;
+  }
+  blocks.resize(firstAffected);
+  merged.merge(bars);
+  barCount += merged.size();
+
+  for (qsizetype begin = 0; begin < merged.size(); begin += BLOCK_BARS) {
+    blocks.append(encodeBlock(merged, begin, qMin(merged.size() - begin, qsizetype(BLOCK_BARS))));
+  }
+}
+
+BarSeries CompressedBarSeries::toSeries() const {
+  return range(std::numeric_limits<time_record_t>::min(), std::numeric_limits<time_record_t>::max());
+}
+
+BarSeries CompressedBarSeries::range(time_record_t from, time_record_t to) const {
+  BarSeries bars;
+  auto block = std::partition_point(blocks.cbegin(), blocks.cend(), [from](const Block &block) { return block.lastTimestamp < from; });
+  for (; block != blocks.cend() && block->firstTimestamp <= to; ++block) {
+    decodeBlock(*block, from, to, bars);
+  }
+  return bars;
+}
+
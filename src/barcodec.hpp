@@ -0,0 +1,52 @@
+#ifndef _BAR_CODEC_HEADER_
+#define _BAR_CODEC_HEADER_
+
+#include <QByteArray>
+#include <QList>
+
+#include "barseries.hpp"
+
+// Compressed, append-friendly history of one symbol. Bars are split into blocks of BLOCK_BARS, each encoded as:
+//   timestamps  first value, first delta, then delta-of-delta (regular 5min spacing costs one byte per bar)
+//   prices      fixed-point ticks of PRICE_SCALE as deltas (open from the previous close, high/low/close from the open),
+//               or, if a block has prices that are not exact ticks, each column XORed with its previous value
+//   volume      plain value
+// every integer being a zigzag varint. Decoding is lossless and only touches the blocks overlapping the requested range.
+// Extended-session 5min bars at cent prices take about 11 bytes instead of the 48 of the raw columns. In memory only: the
+// database and the bar store keep plain rows and columns, which SQL range scans and the mapped views read directly.
+class CompressedBarSeries {
+  public:
+    CompressedBarSeries() = default;
+
+    qsizetype     size() const { return barCount; }
+    bool          isEmpty() const { return barCount == 0; }
+    time_record_t firstTimestamp() const { return blocks.first().firstTimestamp; }
+    time_record_t lastTimestamp() const { return blocks.last().lastTimestamp; }
+    qsizetype     encodedBytes() const;  // Heap used by the encoded blocks
+    void          clear();
+
+    void      insert(const BarSeries &bars);  // Newer values win, like BarSeries::merge
+    BarSeries toSeries() const;
+    BarSeries range(time_record_t from, time_record_t to) const;  // from <= timestamp <= to
+
+  private:
+    struct Block {
+        time_record_t firstTimestamp {};
+        time_record_t lastTimestamp {};
+        qint32        count {};
+        bool          fixedPoint {};  // Prices stored as ticks, otherwise XORed doubles
+        QByteArray    data;
+    };
+    QList<Block> blocks;  // Sorted, non-overlapping
+    qsizetype    barCount {};
+
+    const static qsizetype BLOCK_BARS { 1024 };
+    const static qint64    PRICE_SCALE { PRICE_TICKS_PER_UNIT };  // Alpha Vantage prices have at most 4 decimals
+
+    static Block   encodeBlock(const BarSeries &bars, qsizetype begin, qsizetype count);
+    static bool    decodeBlock(const Block &block, time_record_t from, time_record_t to, BarSeries &out);
+    static bool    toTicks(price_t price, qint64 &ticks);
+    static price_t fromTicks(qint64 ticks);
+};
+
+#endif
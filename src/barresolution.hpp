@@ -0,0 +1,61 @@
+#ifndef _BAR_RESOLUTION_HEADER_
+#define _BAR_RESOLUTION_HEADER_
+
+#include <QtGlobal>
+
+#include "global.hpp"
+#include "timestampparser.hpp"  // utcDayStart, what daily and weekly bars are stamped with
+
+// Bar sizes the history is stored in, finest first. Each one has its own table (see DatabaseManager): 5min bars are
+// fetched, hourly ones only come from compaction, daily ones from compaction or the daily adjusted series, weekly ones
+// from the weekly adjusted series.
+enum class BarResolution { FiveMinutes, Hourly, Daily, Weekly };
+
+constexpr qint64 resolutionSeconds(BarResolution resolution) {
+  switch (resolution) {
+    case BarResolution::FiveMinutes: return 5 * 60;
+    case BarResolution::Hourly:      return 60 * 60;
+    case BarResolution::Daily:       return 24 * 60 * 60;
+    case BarResolution::Weekly:      return 7 * 24 * 60 * 60;
+  }
+  return 0;
+}
+
+// Where the buckets of a resolution start: UTC hours and days, weeks on Monday (1970-01-05, the epoch was a Thursday)
+constexpr qint64 resolutionOrigin(BarResolution resolution) {
+  return resolution == BarResolution::Weekly ? 4 * 24 * 60 * 60 : 0;
+}
+
+// Start of the bucket holding time, rounded down before 1970 too
+constexpr time_record_t resolutionBucket(BarResolution resolution, time_record_t time) {
+  const qint64 secs   = resolutionSeconds(resolution);
+  const qint64 offset = (time - resolutionOrigin(resolution)) % secs;
+  return time - offset - (offset < 0 ? secs : 0);
+}
+
+// Rough number of bars a resolution has over [from, to]: 252 sessions a year of 6.5 hours, so 78 5min bars and 7 hourly
+// ones (the half hour after the open gets its own) per session
+constexpr double expectedBars(BarResolution resolution, time_record_t from, time_record_t to) {
+  const double sessions = double(to - from) / (24 * 60 * 60) * 252.0 / 365.0;
+  switch (resolution) {
+    case BarResolution::FiveMinutes: return sessions * 78;
+    case BarResolution::Hourly:      return sessions * 7;
+    case BarResolution::Daily:       return sessions;
+    case BarResolution::Weekly:      return sessions / 5;
+  }
+  return sessions;
+}
+
+// The resolution to draw [from, to] in when there is room for maxBars bars (e.g. the chart's width in pixels): the finest
+// one that fits, so the coarser the longer the range. Five years on a 1,500 pixel chart are the ~1,260 daily bars, not
+// ~100k 5min ones. Falls back to weekly bars when even those do not fit.
+constexpr BarResolution resolutionFor(time_record_t from, time_record_t to, qsizetype maxBars) {
+  for (BarResolution resolution : { BarResolution::FiveMinutes, BarResolution::Hourly, BarResolution::Daily }) {
+    if (expectedBars(resolution, from, to) <= double(maxBars)) {
+      return resolution;
+    }
+  }
+  return BarResolution::Weekly;
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include "barseries.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace {
+  template <typename T> void appendSlice(QList<T> &column, const QList<T> &source, qsizetype position, qsizetype length) {
+    std::copy(source.cbegin() + position, source.cbegin() + position + length, std::back_inserter(column));
+  }
+}  // namespace
+
+void BarSeries::reserve(qsizetype bars) {
+  times.reserve(bars);
+  openPrices.reserve(bars);
+  highPrices.reserve(bars);
+  lowPrices.reserve(bars);
+  closePrices.reserve(bars);
+  volumeValues.reserve(bars);
+}
+
+void BarSeries::clear() {
+  times.clear();
+  openPrices.clear();
+  highPrices.clear();
+  lowPrices.clear();
+  closePrices.clear();
+  volumeValues.clear();
+}
+
+void BarSeries::setBar(qsizetype i, const HistoricalDataRecord &bar) {
+  openPrices[i]   = bar.open;
+  highPrices[i]   = bar.high;
+  lowPrices[i]    = bar.low;
+  closePrices[i]  = bar.close;
+  volumeValues[i] = bar.volume;
+}
+
+void BarSeries::append(time_record_t time, const HistoricalDataRecord &bar) {
+  if (!times.isEmpty() && time <= times.last()) {
+    insert(time, bar);
+    return;
+  }
+  times.append(time);
+  openPrices.append(bar.open);
+  highPrices.append(bar.high);
+  lowPrices.append(bar.low);
+  closePrices.append(bar.close);
+  volumeValues.append(bar.volume);
+}
+
+void BarSeries::insert(time_record_t time, const HistoricalDataRecord &bar) {
+  qsizetype i = lowerBound(time);
+  if (i < times.size() && times.at(i) == time) {
+    setBar(i, bar);
+    return;
+  }
+  if (i == times.size()) {
+    append(time, bar);
+    return;
+  }
+  times.insert(i, time);
+  openPrices.insert(i, bar.open);
+  highPrices.insert(i, bar.high);
+  lowPrices.insert(i, bar.low);
+  closePrices.insert(i, bar.close);
+  volumeValues.insert(i, bar.volume);
+}
+
+void BarSeries::appendColumns(const BarSeries &bars, qsizetype position, qsizetype length) {
+  appendSlice(times, bars.times, position, length);
+  appendSlice(openPrices, bars.openPrices, position, length);
+  appendSlice(highPrices, bars.highPrices, position, length);
+  appendSlice(lowPrices, bars.lowPrices, position, length);
+  appendSlice(closePrices, bars.closePrices, position, length);
+  appendSlice(volumeValues, bars.volumeValues, position, length);
+}
+
+void BarSeries::merge(const BarSeries &bars) {
+  if (bars.isEmpty()) {
+    return;
+  }
+  if (isEmpty()) {
+    *this = bars;  // Shares the columns
+    return;
+  }
+  // A refresh overlaps the newest stored bars and adds a few after them: if every overlapping timestamp is already
+  // stored, those bars are overwritten in place and the rest is appended, nothing is moved
+  const qsizetype overlap = bars.lowerBound(lastTimestamp() + 1);  // Their bars up to our last one
+  const qsizetype start   = lowerBound(bars.firstTimestamp());
+  if (start + overlap <= size() && std::equal(bars.times.cbegin(), bars.times.cbegin() + overlap, times.cbegin() + start)) {
+    for (qsizetype i = 0; i < overlap; ++i) {
+      setBar(start + i, bars.record(i));
+    }
+    appendColumns(bars, overlap, bars.size() - overlap);
+    return;
+  }
+  // Interleaved: both sides are sorted, merge them into new columns in one pass
+  BarSeries merged;
+  merged.reserve(size() + bars.size());
+  qsizetype ours = 0, theirs = 0;
+  while (ours < size() || theirs < bars.size()) {
+    if (theirs == bars.size() || (ours < size() && times.at(ours) < bars.times.at(theirs))) {
+      qsizetype end = theirs == bars.size() ? size() : lowerBound(bars.times.at(theirs));
+      merged.appendColumns(*this, ours, end - ours);
+      ours = end;
+    } else {
+      qsizetype end = ours == size() ? bars.size() : bars.lowerBound(times.at(ours) + 1);
+      if (ours < size() && end > theirs && bars.times.at(end - 1) == times.at(ours)) {
+        ++ours;  // Same timestamp on both sides, theirs replaces ours
+      }
+      merged.appendColumns(bars, theirs, end - theirs);
+      theirs = end;
+    }
+  }
+  *this = merged;
+}
+
+void BarSeries::scale(qsizetype begin, qsizetype end, double priceFactor, double volumeFactor) {
+  if (begin >= end) {
+    return;
+  }
+  for (QList<price_t> *column : { &openPrices, &highPrices, &lowPrices, &closePrices }) {
+    price_t *prices = column->data();  // Detaches once per column, not per bar
+    for (qsizetype i = begin; i < end; ++i) {
+      prices[i] = prices[i] * priceFactor;
+    }
+  }
+  if (volumeFactor != 1.0) {
+    volume_t *volumes = volumeValues.data();
+    for (qsizetype i = begin; i < end; ++i) {
+      volumes[i] = volume_t(std::llround(double(volumes[i]) * volumeFactor));
+    }
+  }
+}
+
+qsizetype BarSeries::lowerBound(time_record_t time) const {
+  return std::lower_bound(times.cbegin(), times.cend(), time) - times.cbegin();
+}
+
+qsizetype BarSeries::indexOf(time_record_t time) const {
+  qsizetype i = lowerBound(time);
+  return (i < times.size() && times.at(i) == time) ? i : -1;
+}
+
+BarSeries BarSeries::range(time_record_t from, time_record_t to) const {
+  if (isEmpty() || from > to) {
+    return BarSeries();
+  }
+  qsizetype begin = lowerBound(from);
+  qsizetype end   = std::upper_bound(times.cbegin() + begin, times.cend(), to) - times.cbegin();
+  return mid(begin, end - begin);
+}
+
+BarSeries BarSeries::mid(qsizetype position, qsizetype length) const {
+  position = qBound(qsizetype(0), position, size());
+  length   = (length < 0) ? size() - position : qMin(length, size() - position);
+  if (position == 0 && length == size()) {
+    return *this;
+  }
+  BarSeries sub;
+  sub.reserve(length);
+  sub.appendColumns(*this, position, length);
+  return sub;
+}
@@ -0,0 +1,70 @@
+#ifndef _BAR_SERIES_HEADER_
+#define _BAR_SERIES_HEADER_
+
+#include <QList>
+
+#include "global.hpp"
+
+struct HistoricalDataRecord {
+    price_t  high {};
+    price_t  low {};
+    price_t  open {};
+    price_t  close {};
+    volume_t volume {};
+    HistoricalDataRecord(price_t open, price_t high, price_t low, price_t close, volume_t volume):
+        high(high), low(low), open(open), close(close), volume(volume) { }
+};
+
+// Sorted bars of one symbol, one contiguous column per field (structure of arrays).
+// Lookups are binary searches over the timestamp column, scans over one field (chart ranges, min/max, rollups) only
+// touch that column, and bars arriving in order, which is nearly always the case, are plain appends.
+// The columns are implicitly shared, copies are cheap until one side is modified.
+class BarSeries {
+  public:
+    BarSeries() = default;
+
+    qsizetype            size() const { return times.size(); }
+    bool                 isEmpty() const { return times.isEmpty(); }
+    void                 reserve(qsizetype bars);
+    void                 clear();
+    time_record_t        timestamp(qsizetype i) const { return times.at(i); }
+    HistoricalDataRecord record(qsizetype i) const {
+      return { openPrices.at(i), highPrices.at(i), lowPrices.at(i), closePrices.at(i), volumeValues.at(i) };
+    }
+    time_record_t        firstTimestamp() const { return times.first(); }
+    time_record_t        lastTimestamp() const { return times.last(); }
+
+    // Columns, each holds size() values sorted by timestamp
+    const QList<time_record_t> &timestamps() const { return times; }
+    const QList<price_t>       &opens() const { return openPrices; }
+    const QList<price_t>       &highs() const { return highPrices; }
+    const QList<price_t>       &lows() const { return lowPrices; }
+    const QList<price_t>       &closes() const { return closePrices; }
+    const QList<volume_t>      &volumes() const { return volumeValues; }
+
+    void append(time_record_t time, const HistoricalDataRecord &bar);  // Cheap when time is past the last bar, inserts otherwise
+    void insert(time_record_t time, const HistoricalDataRecord &bar);  // Replaces the bar stored at time, like QMap::insert
+    void merge(const BarSeries &bars);                                 // Newer values win, one sorted merge pass
+    // Multiplies the prices and volumes of the bars [begin, end), used for split and dividend adjustment
+    void scale(qsizetype begin, qsizetype end, double priceFactor, double volumeFactor);
+
+    qsizetype lowerBound(time_record_t time) const;  // Index of the first bar at or after time
+    qsizetype indexOf(time_record_t time) const;     // -1 if not stored
+    bool      contains(time_record_t time) const { return indexOf(time) >= 0; }
+
+    BarSeries range(time_record_t from, time_record_t to) const;  // Bars with from <= timestamp <= to
+    BarSeries mid(qsizetype position, qsizetype length = -1) const;
+
+  private:
+    QList<time_record_t> times;
+    QList<price_t>       openPrices;
+    QList<price_t>       highPrices;
+    QList<price_t>       lowPrices;
+    QList<price_t>       closePrices;
+    QList<volume_t>      volumeValues;
+
+    void appendColumns(const BarSeries &bars, qsizetype position, qsizetype length);
+    void setBar(qsizetype i, const HistoricalDataRecord &bar);
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "barvalidator.hpp"
+#include <cmath>
+
+namespace {
+  constexpr time_record_t SESSION_BREAK_SECS { 4 * 60 * 60 };  // Longer spacings are nights, weekends and holidays
+
+  bool isUsable(const HistoricalDataRecord &bar) {
+    const price_t prices[4] { bar.open, bar.high, bar.low, bar.close };
+    for (price_t price : prices) {
+      if (!std::isfinite(double(price)) || price <= 0) {
+        return false;
+      }
+    }
+    return bar.volume >= 0;
+  }
+
+  bool isConsistent(const HistoricalDataRecord &bar) {
+    return bar.high >= bar.open && bar.high >= bar.close && bar.low <= bar.open && bar.low <= bar.close;
+  }
+
+  time_record_t alignDown(time_record_t time, time_record_t interval) {
+    time_record_t aligned = time - time % interval;
+    return (time % interval < 0) ? aligned - interval : aligned;  // Round down before 1970 too
+  }
+}  // namespace
+
+BarQualityReport normalizeBars(BarSeries &bars, time_record_t interval) {
+  BarQualityReport report;
+  bool             rebuild = false;
+  for (qsizetype i = 0; i < bars.size() && !rebuild; ++i) {
+    const HistoricalDataRecord bar = bars.record(i);
+    rebuild = !isUsable(bar) || !isConsistent(bar) || (interval > 0 && bars.timestamp(i) % interval != 0);
+  }
+
+  if (rebuild) {
+    BarSeries normalized;
+    normalized.reserve(bars.size());
+    for (qsizetype i = 0; i < bars.size(); ++i) {
+      HistoricalDataRecord bar = bars.record(i);
+      if (!isUsable(bar)) {
+        report.dropped++;
+        continue;
+      }
+      if (!isConsistent(bar)) {
+        bar.high = qMax(bar.high, qMax(bar.open, bar.close));
+        bar.low  = qMin(bar.low, qMin(bar.open, bar.close));
+        report.repaired++;
+      }
+      time_record_t time = bars.timestamp(i);
+      if (interval > 0 && time % interval != 0) {
+        time = alignDown(time, interval);
+        report.realigned++;
+      }
+      if (!normalized.isEmpty() && normalized.lastTimestamp() == time) {
+        report.duplicates++;  // Sorted input stays sorted after rounding down, so a collision is always with the last bar
+      }
+      normalized.append(time, bar);
+    }
+    bars = normalized;
+  }
+
+  if (interval > 0) {
+    for (qsizetype i = 1; i < bars.size(); ++i) {
+      const time_record_t spacing = bars.timestamp(i) - bars.timestamp(i - 1);
+      report.gaps += spacing > interval && spacing < SESSION_BREAK_SECS;
+    }
+  }
+  report.flags |= report.dropped ? BarQualityReport::DroppedBars : 0;
+  report.flags |= report.repaired ? BarQualityReport::RepairedOhlc : 0;
+  report.flags |= report.realigned ? BarQualityReport::Realigned : 0;
+  report.flags |= report.duplicates ? BarQualityReport::Duplicates : 0;
+  report.flags |= report.gaps ? BarQualityReport::Gaps : 0;
+  return report;
+}
@@ -0,0 +1,35 @@
+#ifndef _BAR_VALIDATOR_HEADER_
+#define _BAR_VALIDATOR_HEADER_
+
+#include <QtGlobal>
+
+#include "barseries.hpp"
+
+// What normalizeBars found and fixed in a series. Flags of successive batches are OR-ed into the stock's quality.
+struct BarQualityReport {
+    enum Flag : quint32 {
+      Clean        = 0,
+      DroppedBars  = 1 << 0,  // Non-positive or non-finite prices, or a negative volume
+      RepairedOhlc = 1 << 1,  // High/low widened to contain open and close
+      Realigned    = 1 << 2,  // Timestamps snapped down to the bar interval
+      Duplicates   = 1 << 3,  // Several bars in one interval, the last one was kept
+      Gaps         = 1 << 4,  // Missing intervals inside a trading session
+    };
+    quint32   flags { Clean };
+    qsizetype dropped {};
+    qsizetype repaired {};
+    qsizetype realigned {};
+    qsizetype duplicates {};
+    qsizetype gaps {};
+
+    bool isClean() const { return flags == Clean; }
+};
+
+// Ingest-time validation, so renderers and analytics can trust stored and charted bars without checking them again.
+// Drops unusable bars and repairs OHLC inconsistencies. With an interval (seconds) it also snaps timestamps down to it,
+// keeps the last bar of each interval and counts the gaps shorter than a session break. An interval of 0 skips those,
+// for mixed resolutions like the stitched raw/hourly/daily pages read from the database.
+// Clean input, the usual case, is only scanned and not copied.
+BarQualityReport normalizeBars(BarSeries &bars, time_record_t interval = 0);
+
+#endif
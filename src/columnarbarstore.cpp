@@ -0,0 +1,309 @@
+#include "columnarbarstore.hpp"
+#include <QDir>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+namespace {
+  static_assert(sizeof(time_record_t) == 8 && sizeof(price_t) == 8 && sizeof(volume_t) == 8, "Segment columns are 8 bytes wide");
+
+  constexpr char    SEGMENT_MAGIC[8] { 'S', 'T', 'K', 'B', 'A', 'R', 'S', '1' };
+  constexpr char    FOOTER_MAGIC[8] { 'S', 'T', 'K', 'B', 'E', 'N', 'D', '1' };
+#ifdef STOCKTRACKER_FIXED_POINT_PRICES
+  constexpr quint32 SEGMENT_VERSION { 2 };  // Price columns hold FixedPrice ticks, a double build must not map them
+#else
+  constexpr quint32 SEGMENT_VERSION { 1 };  // Price columns hold doubles
+#endif
+  constexpr quint32 COLUMN_COUNT { 6 };
+  constexpr qint64  VALUE_SIZE { 8 };
+
+  struct SegmentHeader {
+      char    magic[8];
+      quint32 version;
+      quint32 columnCount;
+      quint64 capacity;
+      quint64 rowCount;
+      quint64 reserved[4];
+  };
+  static_assert(sizeof(SegmentHeader) == 64, "Header is 64 bytes");
+
+  struct SegmentFooter {
+      quint64       rowCount;
+      time_record_t firstTimestamp;
+      time_record_t lastTimestamp;
+      char          magic[8];
+  };
+  static_assert(sizeof(SegmentFooter) == 32, "Footer is 32 bytes");
+
+  qint64 columnOffset(qint64 capacity, int column) {
+    return qint64(sizeof(SegmentHeader)) + column * capacity * VALUE_SIZE;
+  }
+  qint64 footerOffset(qint64 capacity) {
+    return columnOffset(capacity, COLUMN_COUNT);
+  }
+
+  // Raw bytes of one column of a series, written with one call per column
+  const char *columnData(const BarSeries &bars, int index) {
+    switch (index) {
+      case 0: return reinterpret_cast<const char *>(bars.timestamps().constData());
+      case 1: return reinterpret_cast<const char *>(bars.opens().constData());
+      case 2: return reinterpret_cast<const char *>(bars.highs().constData());
+      case 3: return reinterpret_cast<const char *>(bars.lows().constData());
+      case 4: return reinterpret_cast<const char *>(bars.closes().constData());
+      default: return reinterpret_cast<const char *>(bars.volumes().constData());
+    }
+  }
+
+  bool sameRecord(const HistoricalDataRecord &a, const HistoricalDataRecord &b) {
+    return a.open == b.open && a.high == b.high && a.low == b.low && a.close == b.close && a.volume == b.volume;
+  }
+}  // namespace
+
+BarColumnsView BarColumnsView::range(time_record_t from, time_record_t to) const {
+  if (count == 0 || from > to) {
+    return BarColumnsView();
+  }
+  const time_record_t *begin = std::lower_bound(timestamps, timestamps + count, from);
+  const time_record_t *end   = std::upper_bound(begin, timestamps + count, to);
+  return mid(begin - timestamps, end - begin);
+}
+
+BarColumnsView BarColumnsView::mid(qsizetype position, qsizetype length) const {
+  BarColumnsView sub;
+  position = qBound(qsizetype(0), position, count);
+  length   = qBound(qsizetype(0), length, count - position);
+  if (length == 0) {
+    return sub;
+  }
+  sub            = *this;
+  sub.timestamps = timestamps + position;
+  sub.open       = open + position;
+  sub.high       = high + position;
+  sub.low        = low + position;
+  sub.close      = close + position;
+  sub.volume     = volume + position;
+  sub.count      = length;
+  return sub;
+}
+
+qsizetype BarColumnsView::indexOf(time_record_t time) const {
+  const time_record_t *found = std::lower_bound(timestamps, timestamps + count, time);
+  return (found != timestamps + count && *found == time) ? found - timestamps : -1;
+}
+
+BarSeries BarColumnsView::toSeries() const {
+  BarSeries bars;
+  bars.reserve(count);
+  for (qsizetype i = 0; i < count; ++i) {
+    bars.append(timestamps[i], record(i));  // Sorted input, always the append fast path
+  }
+  return bars;
+}
+
+ColumnarBarStore::ColumnarBarStore(const QString &directory): directory(directory) { }
+
+bool ColumnarBarStore::open() {
+  if (!QDir().mkpath(directory)) {
+    qCritical() << "Error creating bar store directory:" << directory;
+    return false;
+  }
+  qDebug() << "Columnar bar store opened at:" << directory;
+  return true;
+}
+
+QString ColumnarBarStore::segmentPath(const QString &symbol) const {
+  return QDir(directory).filePath(symbol + ".bars");
+}
+
+bool ColumnarBarStore::contains(const QString &symbol) const {
+  return views.contains(symbol) || QFile::exists(segmentPath(symbol));
+}
+
+BarColumnsView ColumnarBarStore::view(const QString &symbol) {
+  auto cached = views.constFind(symbol);
+  if (cached != views.constEnd()) {
+    return cached.value();
+  }
+  BarColumnsView mapped;
+  if (mapSegment(symbol, mapped)) {
+    views.insert(symbol, mapped);
+  }
+  return mapped;
+}
+
+// Maps a segment file and checks header and footer agree before handing out pointers into it
+bool ColumnarBarStore::mapSegment(const QString &symbol, BarColumnsView &view) const {
+  QSharedPointer<QFile> file(new QFile(segmentPath(symbol)));
+  if (!file->exists()) {
+    return false;
+  }
+  if (!file->open(QIODevice::ReadOnly) || file->size() < qint64(sizeof(SegmentHeader) + sizeof(SegmentFooter))) {
+    qWarning() << "Cannot open bar segment" << file->fileName();
+    return false;
+  }
+  const uchar *data = file->map(0, file->size());
+  if (!data) {
+    qWarning() << "Cannot map bar segment" << file->fileName() << ":" << file->errorString();
+    return false;
+  }
+  SegmentHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0 || header.version != SEGMENT_VERSION ||
+      header.columnCount != COLUMN_COUNT || header.rowCount > header.capacity ||
+      file->size() < footerOffset(header.capacity) + qint64(sizeof(SegmentFooter))) {
+    qWarning() << "Bar segment" << file->fileName() << "has an invalid header.";
+    return false;
+  }
+  SegmentFooter footer;
+  std::memcpy(&footer, data + footerOffset(header.capacity), sizeof(footer));
+  if (std::memcmp(footer.magic, FOOTER_MAGIC, sizeof(FOOTER_MAGIC)) != 0) {
+    qWarning() << "Bar segment" << file->fileName() << "has an invalid footer.";
+    return false;
+  }
+  if (footer.rowCount != header.rowCount) {
+    // An append was interrupted before its header commit, the rows counted by the header are still intact
+    qWarning() << "Bar segment" << file->fileName() << "has an uncommitted append, using" << header.rowCount << "rows.";
+  }
+
+  const qint64 capacity = qint64(header.capacity);
+  view.mapping          = file;
+  view.timestamps       = reinterpret_cast<const time_record_t *>(data + columnOffset(capacity, 0));
+  view.open             = reinterpret_cast<const price_t *>(data + columnOffset(capacity, 1));
+  view.high             = reinterpret_cast<const price_t *>(data + columnOffset(capacity, 2));
+  view.low              = reinterpret_cast<const price_t *>(data + columnOffset(capacity, 3));
+  view.close            = reinterpret_cast<const price_t *>(data + columnOffset(capacity, 4));
+  view.volume           = reinterpret_cast<const volume_t *>(data + columnOffset(capacity, 5));
+  view.count            = qsizetype(header.rowCount);
+  view.capacity         = qsizetype(capacity);
+  return true;
+}
+
+bool ColumnarBarStore::merge(const QString &symbol, const BarSeries &bars, qsizetype &inserted, qsizetype &updated) {
+  inserted = 0;
+  updated  = 0;
+  if (bars.isEmpty()) {
+    return true;
+  }
+  BarColumnsView current = view(symbol);
+  if (current.isEmpty()) {
+    inserted = bars.size();
+    return writeSegment(symbol, bars);
+  }
+
+  // Split the batch at the last stored bar: the overlap is only checked, the tail is appended
+  const qsizetype tailStart      = bars.lowerBound(current.lastTimestamp() + 1);
+  bool            overlapChanged = false;
+  for (qsizetype i = 0; i < tailStart; ++i) {
+    qsizetype index = current.indexOf(bars.timestamp(i));
+    if (index < 0) {
+      inserted++;
+      overlapChanged = true;
+    } else if (!sameRecord(current.record(index), bars.record(i))) {
+      updated++;
+      overlapChanged = true;
+    }
+  }
+  const BarSeries tail  = bars.mid(tailStart);
+  inserted             += tail.size();
+
+  if (overlapChanged) {
+    // Rare (vendor corrections or back-filled gaps), rewrite the segment in order
+    BarSeries merged = current.toSeries();
+    merged.merge(bars);
+    return writeSegment(symbol, merged);
+  }
+  if (tail.isEmpty()) {
+    return true;
+  }
+  if (current.size() + tail.size() > current.capacity) {
+    BarSeries merged = current.toSeries();
+    merged.merge(tail);
+    return writeSegment(symbol, merged);
+  }
+  return appendInPlace(symbol, current, tail);
+}
+
+// Writes the tail into the free capacity, then the footer, then the header row count (the commit point)
+bool ColumnarBarStore::appendInPlace(const QString &symbol, const BarColumnsView &current, const BarSeries &tail) {
+  QFile file(segmentPath(symbol));
+  if (!file.open(QIODevice::ReadWrite)) {
+    qWarning() << "Cannot open bar segment for append" << file.fileName() << ":" << file.errorString();
+    return false;
+  }
+  const qint64 capacity = current.capacity;
+  const qint64 rowCount = current.size() + tail.size();
+  for (int column = 0; column < int(COLUMN_COUNT); ++column) {
+    if (!file.seek(columnOffset(capacity, column) + current.size() * VALUE_SIZE) ||
+        file.write(columnData(tail, column), tail.size() * VALUE_SIZE) != tail.size() * VALUE_SIZE) {
+      qWarning() << "Error appending to bar segment" << file.fileName() << ":" << file.errorString();
+      return false;
+    }
+  }
+  SegmentFooter footer { quint64(rowCount), current.firstTimestamp(), tail.lastTimestamp(), {} };
+  std::memcpy(footer.magic, FOOTER_MAGIC, sizeof(FOOTER_MAGIC));
+  const quint64 newRowCount = quint64(rowCount);
+  if (!file.seek(footerOffset(capacity)) || file.write(reinterpret_cast<const char *>(&footer), sizeof(footer)) != sizeof(footer) ||
+      !file.seek(offsetof(SegmentHeader, rowCount)) ||
+      file.write(reinterpret_cast<const char *>(&newRowCount), sizeof(newRowCount)) != sizeof(newRowCount)) {
+    qWarning() << "Error committing bar segment" << file.fileName() << ":" << file.errorString();
+    return false;
+  }
+  file.close();
+  views.remove(symbol);  // Remapped with the new row count on next access
+  return true;
+}
+
+// Writes a complete segment to a temporary file and swaps it in atomically
+bool ColumnarBarStore::writeSegment(const QString &symbol, const BarSeries &bars) {
+  const qint64 capacity = qMax<qint64>(INITIAL_CAPACITY, bars.size() * 2);  // Room to append in place for a while
+  views.remove(symbol);  // Release our mapping before the file is replaced
+
+  QSaveFile file(segmentPath(symbol));
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning() << "Cannot create bar segment" << file.fileName() << ":" << file.errorString();
+    return false;
+  }
+  SegmentHeader header {};
+  std::memcpy(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+  header.version     = SEGMENT_VERSION;
+  header.columnCount = COLUMN_COUNT;
+  header.capacity    = quint64(capacity);
+  header.rowCount    = quint64(bars.size());
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  const QByteArray padding((capacity - bars.size()) * VALUE_SIZE, '\0');
+  for (int column = 0; column < int(COLUMN_COUNT); ++column) {
+    file.write(columnData(bars, column), bars.size() * VALUE_SIZE);
+    file.write(padding);
+  }
+  SegmentFooter footer { quint64(bars.size()), bars.isEmpty() ? 0 : bars.firstTimestamp(), bars.isEmpty() ? 0 : bars.lastTimestamp(), {} };
+  std::memcpy(footer.magic, FOOTER_MAGIC, sizeof(FOOTER_MAGIC));
+  file.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+
+  if (!file.commit()) {
+    qWarning() << "Error writing bar segment" << file.fileName() << ":" << file.errorString();
+    return false;
+  }
+  return true;
+}
+
+bool ColumnarBarStore::removeBefore(const QString &symbol, time_record_t cutoff) {
+  BarColumnsView current = view(symbol);
+  if (current.isEmpty() || current.firstTimestamp() >= cutoff) {
+    return true;
+  }
+  // An empty segment is kept, it still tells the DatabaseManager the symbol was moved over
+  return writeSegment(symbol, current.range(cutoff, std::numeric_limits<time_record_t>::max()).toSeries());
+}
+
+bool ColumnarBarStore::replace(const QString &symbol, const BarSeries &bars) {
+  return writeSegment(symbol, bars);  // Swapped in by QSaveFile, only a complete file replaces the old one
+}
+
+bool ColumnarBarStore::remove(const QString &symbol) {
+  views.remove(symbol);
+  QFile file(segmentPath(symbol));
+  return !file.exists() || file.remove();
+}
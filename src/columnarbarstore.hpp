@@ -0,0 +1,88 @@
+#ifndef _COLUMNAR_BAR_STORE_HEADER_
+#define _COLUMNAR_BAR_STORE_HEADER_
+
+#include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+
+#include "barseries.hpp"
+
+// Read-only view of a symbol's bars straight out of a memory-mapped segment file (nothing is copied).
+// The view keeps the mapping alive, so it stays valid even after the store rewrites or deletes the segment.
+class BarColumnsView {
+  public:
+    BarColumnsView() = default;
+
+    qsizetype            size() const { return count; }
+    bool                 isEmpty() const { return count == 0; }
+    time_record_t        timestamp(qsizetype i) const { return timestamps[i]; }
+    HistoricalDataRecord record(qsizetype i) const { return { open[i], high[i], low[i], close[i], volume[i] }; }
+    time_record_t        firstTimestamp() const { return timestamps[0]; }
+    time_record_t        lastTimestamp() const { return timestamps[count - 1]; }
+
+    // Raw columns, each holds size() contiguous values sorted by timestamp
+    const time_record_t *timestampColumn() const { return timestamps; }
+    const price_t       *openColumn() const { return open; }
+    const price_t       *highColumn() const { return high; }
+    const price_t       *lowColumn() const { return low; }
+    const price_t       *closeColumn() const { return close; }
+    const volume_t      *volumeColumn() const { return volume; }
+
+    BarColumnsView range(time_record_t from, time_record_t to) const;  // Bars with from <= timestamp <= to (binary search)
+    BarColumnsView mid(qsizetype position, qsizetype length) const;
+    qsizetype      indexOf(time_record_t time) const;  // -1 if not stored
+
+    BarSeries toSeries() const;  // Copies the view out, for callers that keep or modify the bars
+
+  private:
+    friend class ColumnarBarStore;
+
+    QSharedPointer<QFile> mapping;  // Owns the mapped file
+    const time_record_t  *timestamps {};
+    const price_t        *open {};
+    const price_t        *high {};
+    const price_t        *low {};
+    const price_t        *close {};
+    const volume_t       *volume {};
+    qsizetype             count {};
+    qsizetype             capacity {};  // Rows the segment can hold before it has to be rewritten
+};
+
+// Append-only columnar store with one segment file per symbol (<directory>/<SYMBOL>.bars), opened with mmap.
+// Layout, native byte order:
+//   header  (64 bytes)       magic "STKBARS1", version, column count, capacity, row count
+//   columns (6 * capacity)   timestamp, open, high, low, close, volume, 8 bytes per value, only the first row count are valid
+//   footer  (32 bytes)       row count, first timestamp, last timestamp, magic "STKBEND1"
+// Capacity is preallocated so new bars are written in place; the header row count is written last and acts as the commit.
+// Not thread-safe, it is owned by the DatabaseManager in the storage thread.
+class ColumnarBarStore {
+  public:
+    explicit ColumnarBarStore(const QString &directory);
+
+    bool open();  // Creates the directory if needed
+    const QString &getDirectory() const { return directory; }
+
+    bool           contains(const QString &symbol) const;
+    BarColumnsView view(const QString &symbol);  // Empty view if the symbol has no segment
+    // Merges bars into the symbol's segment, new trailing bars are appended in place, changed older bars force a rewrite
+    bool merge(const QString &symbol, const BarSeries &bars, qsizetype &inserted, qsizetype &updated);
+    bool replace(const QString &symbol, const BarSeries &bars);  // Rewrites the whole segment, the old one stays if that fails
+    bool remove(const QString &symbol);
+    bool removeBefore(const QString &symbol, time_record_t cutoff);  // Drops bars older than cutoff (rewrites the segment)
+
+  private:
+    QString                        directory;
+    QHash<QString, BarColumnsView> views;  // Open mappings, dropped whenever a segment changes
+
+    const static qsizetype INITIAL_CAPACITY { 4096 };
+
+    QString segmentPath(const QString &symbol) const;
+    bool    mapSegment(const QString &symbol, BarColumnsView &view) const;
+    bool    appendInPlace(const QString &symbol, const BarColumnsView &current, const BarSeries &tail);
+    bool    writeSegment(const QString &symbol, const BarSeries &bars);  // The series' columns are written as they are
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "corporateactions.hpp"
+#include <algorithm>
+
+CorporateAction CorporateAction::split(time_record_t effectiveTime, double ratio) {
+  CorporateAction action;
+  action.kind          = Split;
+  action.effectiveTime = effectiveTime;
+  action.value         = ratio;
+  if (ratio > 0) {
+    action.priceFactor  = 1.0 / ratio;
+    action.volumeFactor = ratio;
+  }
+  return action;
+}
+
+CorporateAction CorporateAction::dividend(time_record_t effectiveTime, double amount, double previousClose) {
+  CorporateAction action;
+  action.kind          = Dividend;
+  action.effectiveTime = effectiveTime;
+  action.value         = amount;
+  if (previousClose > amount && amount > 0) {
+    action.priceFactor = (previousClose - amount) / previousClose;
+  }
+  return action;
+}
+
+AdjustmentSchedule::AdjustmentSchedule(QList<CorporateAction> actions) {
+  std::sort(actions.begin(), actions.end(),
+            [](const CorporateAction &a, const CorporateAction &b) { return a.effectiveTime < b.effectiveTime; });
+  times.reserve(actions.size());
+  priceFactors.resize(actions.size() + 1, 1.0);
+  volumeFactors.resize(actions.size() + 1, 1.0);
+  for (const CorporateAction &action : actions) {
+    times.append(action.effectiveTime);
+  }
+  for (qsizetype i = actions.size() - 1; i >= 0; --i) {
+    priceFactors[i]  = priceFactors.at(i + 1) * actions.at(i).priceFactor;
+    volumeFactors[i] = volumeFactors.at(i + 1) * actions.at(i).volumeFactor;
+  }
+}
+
+qsizetype AdjustmentSchedule::firstAfter(time_record_t time) const {
+  return std::upper_bound(times.cbegin(), times.cend(), time) - times.cbegin();
+}
+
+BarSeries AdjustmentSchedule::apply(const BarSeries &bars) const {
+  if (bars.isEmpty() || times.isEmpty() || bars.firstTimestamp() >= times.last()) {
+    return bars;  // Everything is at or after the last action, the common case for recent pages
+  }
+  BarSeries adjusted = bars;
+  // Between two actions the factor is constant, each slice is found by binary search and scaled in one go
+  qsizetype begin = 0;
+  for (qsizetype action = firstAfter(bars.firstTimestamp()); action < times.size() && begin < bars.size(); ++action) {
+    const qsizetype end = bars.lowerBound(times.at(action));
+    adjusted.scale(begin, end, priceFactors.at(action), volumeFactors.at(action));
+    begin = end;
+  }
+  return adjusted;
+}
@@ -0,0 +1,48 @@
+#ifndef _CORPORATE_ACTIONS_HEADER_
+#define _CORPORATE_ACTIONS_HEADER_
+
+#include <QList>
+
+#include "barseries.hpp"
+
+// A split or cash dividend taking effect at effectiveTime (the start of the ex-date). Bars before it are adjusted by
+// priceFactor and volumeFactor, bars from it on are left as they are.
+struct CorporateAction {
+    enum Kind {
+      Split,    // value = new shares per old share (4 for a 4-for-1 split)
+      Dividend  // value = cash amount per share
+    };
+    Kind          kind { Split };
+    time_record_t effectiveTime {};
+    double        value {};
+    double        priceFactor { 1.0 };   // Split: 1 / value. Dividend: (previous close - value) / previous close
+    double        volumeFactor { 1.0 };  // Split: value. Dividend: 1
+
+    static CorporateAction split(time_record_t effectiveTime, double ratio);
+    static CorporateAction dividend(time_record_t effectiveTime, double amount, double previousClose);  // previousClose <= 0: unknown
+};
+
+// The cumulative adjustment of one symbol's stored (raw) bars, applied at read time instead of rewriting them.
+// The factor of a bar is the product of the factors of every action after it; the products are precomputed per action, so
+// the factor of a timestamp is one binary search and adjusting a series scales whole slices between two actions.
+class AdjustmentSchedule {
+  public:
+    AdjustmentSchedule() = default;
+    explicit AdjustmentSchedule(QList<CorporateAction> actions);
+
+    bool   isEmpty() const { return times.isEmpty(); }
+    double priceFactor(time_record_t time) const { return priceFactors.at(firstAfter(time)); }
+    double volumeFactor(time_record_t time) const { return volumeFactors.at(firstAfter(time)); }
+
+    // Adjusted copy of the bars, or the bars themselves (shared, nothing copied) when no action comes after the first bar
+    BarSeries apply(const BarSeries &bars) const;
+
+  private:
+    QList<time_record_t> times;          // Effective times, sorted
+    QList<double>        priceFactors;   // [i]: product over the actions i..end, one extra 1.0 at the end
+    QList<double>        volumeFactors;  // Same for volumes
+
+    qsizetype firstAfter(time_record_t time) const;  // Index of the first action with effectiveTime > time
+};
+
+#endif
@@ -1,45 +1,196 @@
 #include "datamanager.hpp"
 #include <QCoreApplication>  // For applicationDirPath()
+#include <QThread>
+#include <utility>
 
-// Constructor: Sets up the database connection
-DatabaseManager::DatabaseManager(const QString &databasePath, QObject *parent): QObject(parent), databasePath(databasePath) {
-  database = QSqlDatabase::addDatabase("QSQLITE");  // Specify SQLite driver
-  database.setDatabaseName(databasePath);           // Set the database file path
-}
+#include "timestampparser.hpp"
+
+// Constructor: Only stores the configuration, the connection is created by openDatabase() in the storage thread
+DatabaseManager::DatabaseManager(const QString &databasePath, const QString &barStorePath, QObject *parent):
+    QObject(parent), databasePath(databasePath), connectionName("stocktracker_storage"), barStorePath(barStorePath), commitTimer(nullptr),
+    compactionTimer(nullptr) { }
 
 // Destructor: Closes the database connection
 DatabaseManager::~DatabaseManager() {
   closeDatabase();
-  // QSqlDatabase::removeDatabase(m_db.connectionName()); // Important for proper cleanup if multiple connections
   qDebug() << "Database connection closed and removed.";
 }
 
 // Opens the database connection and creates tables if necessary
 bool DatabaseManager::openDatabase() {
+  database = QSqlDatabase::addDatabase("QSQLITE", connectionName);  // Connection owned by the storage thread
+  database.setDatabaseName(databasePath);                            // Set the database file path
   if (!database.open()) {
     qCritical() << "Error: Failed to open database connection:" << database.lastError().text();
     return false;
   }
-  qDebug() << "Database opened successfully at:" << databasePath;
-  return createTables();  // Create tables after opening
+  qDebug() << "Database opened successfully at:" << databasePath << "in thread" << QThread::currentThread();
+
+  // WAL lets readers proceed while a commit is in progress, NORMAL sync only fsyncs on checkpoints
+  QSqlQuery pragma(database);
+  if (!pragma.exec("PRAGMA journal_mode=WAL") || !pragma.exec("PRAGMA synchronous=NORMAL")) {
+    qWarning() << "Could not enable WAL journaling:" << pragma.lastError().text();
+  }
+
+  if (!createTables() || !prepareStatements()) {  // Create tables after opening
+    return false;
+  }
+  if (!barStorePath.isEmpty()) {
+    barStore.reset(new ColumnarBarStore(barStorePath));
+    if (!barStore->open()) {
+      qWarning() << "Falling back to SQLite for historical prices.";
+      barStore.reset();
+    }
+  }
+  if (migratedToV7) {
+    finishMigrationToV7();
+  }
+
+  commitTimer = new QTimer(this);
+  commitTimer->setSingleShot(true);
+  connect(commitTimer, &QTimer::timeout, this, &DatabaseManager::flushPendingWrites);
+  compactionTimer = new QTimer(this);
+  connect(compactionTimer, &QTimer::timeout, this, &DatabaseManager::compactHistory);
+  compactionTimer->start(COMPACTION_INTERVAL_MS);
+  return true;
+}
+
+void DatabaseManager::requestOpenDatabase() {
+  const bool opened = openDatabase();
+  emit databaseOpened(opened, hasColumnarStore(), opened ? loadAllStocks() : QList<Stock>());
 }
 
 // Closes the database connection
 void DatabaseManager::closeDatabase() {
   if (database.isOpen()) {
+    flushPendingWrites();  // Do not lose anything still waiting for the commit window
+    compactionQueue.clear();
+    upsertStockQuery      = QSqlQuery();  // Release the prepared statements before closing
+    upsertHistoricalQuery = QSqlQuery();
     database.close();
+    barStore.reset();
     qDebug() << "Database connection closed.";
   }
+  if (database.isValid()) {
+    database = QSqlDatabase();  // Drop our handle before removing the connection
+    QSqlDatabase::removeDatabase(connectionName);
+  }
+}
+
+// Queues a stock row, later updates of the same symbol overwrite the queued one
+void DatabaseManager::queueStockUpdate(const Stock &stock) {
+  pendingStocks.insert(stock.getSymbol(), stock);
+  scheduleCommit();
+}
+
+// Queues historical prices, batches for the same symbol are merged (newer values win)
+void DatabaseManager::queueHistoricalPrices(const QString &symbol, const BarSeries &historicalData) {
+  pendingHistoricalPrices[symbol].merge(historicalData);
+  scheduleCommit();
+}
+
+void DatabaseManager::scheduleCommit() {
+  // The window starts with the first queued write, so a steady stream of writes still commits every COMMIT_WINDOW_MS
+  if (commitTimer && !commitTimer->isActive()) {
+    commitTimer->start(COMMIT_WINDOW_MS);
+  }
+}
+
+// Puts the batches of a failed group commit back in front of whatever was queued since, which is newer and wins
+void DatabaseManager::requeueWrites(const QHash<QString, Stock> &stocks, const QHash<QString, BarSeries> &historical) {
+  for (auto it = stocks.constBegin(); it != stocks.constEnd(); ++it) {
+    if (!pendingStocks.contains(it.key())) {
+      pendingStocks.insert(it.key(), it.value());
+    }
+  }
+  for (auto it = historical.constBegin(); it != historical.constEnd(); ++it) {
+    BarSeries bars = it.value();
+    bars.merge(pendingHistoricalPrices.value(it.key()));
+    pendingHistoricalPrices.insert(it.key(), bars);
+  }
+}
+
+// Group commit: writes every queued stock and historical batch in one transaction. When the transaction cannot be started
+// or committed (a locked or full database) the batches are queued again and go with the next commit; a row that cannot
+// be written drops the whole window, it would fail every later commit too
+bool DatabaseManager::flushPendingWrites() {
+  if (commitTimer) {
+    commitTimer->stop();
+  }
+  if (pendingStocks.isEmpty() && pendingHistoricalPrices.isEmpty()) {
+    return true;
+  }
+  QHash<QString, Stock>     stocks     = std::exchange(pendingStocks, {});
+  QHash<QString, BarSeries> historical = std::exchange(pendingHistoricalPrices, {});
+
+  if (!database.transaction()) {
+    qCritical() << "Error starting group commit:" << database.lastError().text();
+    requeueWrites(stocks, historical);
+    emit writeFailed(QString("%1, the queued writes are retried with the next ones.").arg(database.lastError().text()));
+    return false;
+  }
+  const QString dropped =
+    QString("%1 stocks and the bars of %2 symbols queued with it were not saved").arg(stocks.size()).arg(historical.size());
+  // Stocks first, historical rows reference them
+  for (const Stock &stock : stocks) {
+    if (!writeStock(stock)) {
+      database.rollback();
+      symbolIds.clear();  // Ids created in the rolled back transaction are gone
+      emit writeFailed(QString("Could not save stock %1, %2.").arg(stock.getSymbol(), dropped));
+      return false;
+    }
+  }
+  qsizetype bars = 0;
+  for (auto it = historical.constBegin(); it != historical.constEnd(); ++it) {
+    HistoricalMergeResult result;
+    if (!mergeHistoricalPrices(it.key(), it.value(), result)) {
+      database.rollback();
+      symbolIds.clear();   // Ids created in the rolled back transaction are gone
+      statistics.clear();  // Updated for bars that were rolled back, reloaded from the rows
+      emit writeFailed(QString("Could not save historical prices for %1, %2.").arg(it.key(), dropped));
+      return false;
+    }
+    bars += it.value().size();
+  }
+  if (!database.commit()) {
+    qCritical() << "Error committing queued writes:" << database.lastError().text();
+    const QString error = database.lastError().text();
+    database.rollback();
+    symbolIds.clear();
+    statistics.clear();
+    requeueWrites(stocks, historical);
+    emit writeFailed(QString("%1, the queued writes are retried with the next ones.").arg(error));
+    return false;
+  }
+  qDebug() << "Group commit:" << stocks.size() << "stocks and" << bars << "historical prices for" << historical.size() << "symbols.";
+  return true;
 }
 
-// Creates the necessary tables if they don't exist
+// Creates the necessary tables if they don't exist, or migrates an older schema in place
 bool DatabaseManager::createTables() {
   QSqlQuery query(database);  // Associate query with our specific database connection
 
-  // Create 'stocks' table
+  int version = 0;
+  if (query.exec("PRAGMA user_version") && query.next()) {
+    version = query.value(0).toInt();
+  }
+  // Databases created before versioning have user_version 0 but already contain the v1 tables
+  if (version == 0 && query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'stocks'") && query.next()) {
+    version = 1;
+  }
+  if (version == 1 && !migrateSchemaV1ToV2()) {
+    return false;
+  }
+  if (version > SCHEMA_VERSION) {
+    qCritical() << "Database schema version" << version << "is newer than supported version" << SCHEMA_VERSION;
+    return false;
+  }
+
+  // Create 'stocks' table, symbol_id is an alias of the rowid and is what historical rows reference
   QString createStocksTableSql = R"(
         CREATE TABLE IF NOT EXISTS stocks (
-            symbol TEXT PRIMARY KEY,
+            symbol_id INTEGER PRIMARY KEY,
+            symbol TEXT NOT NULL UNIQUE,
             name TEXT,
             current_price REAL,
             price_change REAL,
@@ -48,73 +199,339 @@ bool DatabaseManager::createTables() {
             day_open REAL,
             day_close REAL,
             last_quote_fetch_time BIGINT,
-            last_historical_fetch_time BIGINT
+            last_historical_fetch_time BIGINT,
+            statistics BLOB
         )
     )";
   if (!query.exec(createStocksTableSql)) {
     qCritical() << "Error creating stocks table:" << query.lastError().text();
     return false;
   }
+  // Schema version 5 keeps the summary statistics (StockStatistics::toByteArray) in the stocks row, rebuilt on the next merge
+  if (version >= 1 && version < 5 && !query.exec("ALTER TABLE stocks ADD COLUMN statistics BLOB")) {
+    qCritical() << "Error adding the statistics column:" << query.lastError().text();
+    return false;
+  }
 
-  // Create 'historical_prices' table
+  // Create 'historical_prices' table, clustered on (symbol_id, timestamp) so a symbol's bars are one contiguous range
   QString createHistoricalPricesTableSql = R"(
         CREATE TABLE IF NOT EXISTS historical_prices (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            stock_symbol TEXT NOT NULL,
-            timestamp BIGINT NOT NULL,
+            symbol_id INTEGER NOT NULL,
+            timestamp INTEGER NOT NULL,
             day_high REAL,
             day_low REAL,
             day_open REAL,
             day_close REAL,
-            volume BIGINT,
-            UNIQUE(stock_symbol, timestamp),
-            FOREIGN KEY (stock_symbol) REFERENCES stocks(symbol) ON DELETE CASCADE
-        )
+            volume INTEGER,
+            PRIMARY KEY (symbol_id, timestamp),
+            FOREIGN KEY (symbol_id) REFERENCES stocks(symbol_id) ON DELETE CASCADE
+        ) WITHOUT ROWID
     )";
   if (!query.exec(createHistoricalPricesTableSql)) {
     qCritical() << "Error creating historical_prices table:" << query.lastError().text();
     return false;
   }
+  // Rollups of compacted bars (schema version 3), same layout, timestamp is the start of the hour or 00:00 UTC of the date.
+  // Fetched daily bars go to the daily table too, and fetched weekly bars (schema version 6) start on the Monday
+  for (BarResolution resolution : { BarResolution::Hourly, BarResolution::Daily, BarResolution::Weekly }) {
+    const QString table                = resolutionTable(resolution);
+    QString       createRollupTableSql = QString(R"(
+        CREATE TABLE IF NOT EXISTS %1 (
+            symbol_id INTEGER NOT NULL,
+            timestamp INTEGER NOT NULL,
+            day_high REAL,
+            day_low REAL,
+            day_open REAL,
+            day_close REAL,
+            volume INTEGER,
+            PRIMARY KEY (symbol_id, timestamp),
+            FOREIGN KEY (symbol_id) REFERENCES stocks(symbol_id) ON DELETE CASCADE
+        ) WITHOUT ROWID
+    )").arg(table);
+    if (!query.exec(createRollupTableSql)) {
+      qCritical() << "Error creating" << table << "table:" << query.lastError().text();
+      return false;
+    }
+  }
+  // Splits and dividends (schema version 4). price_factor stays NULL for a dividend until the close before it is stored
+  QString createCorporateActionsTableSql = R"(
+        CREATE TABLE IF NOT EXISTS corporate_actions (
+            symbol_id INTEGER NOT NULL,
+            effective_time INTEGER NOT NULL,
+            kind INTEGER NOT NULL,
+            value REAL NOT NULL,
+            price_factor REAL,
+            volume_factor REAL NOT NULL DEFAULT 1,
+            PRIMARY KEY (symbol_id, effective_time, kind),
+            FOREIGN KEY (symbol_id) REFERENCES stocks(symbol_id) ON DELETE CASCADE
+        ) WITHOUT ROWID
+    )";
+  if (!query.exec(createCorporateActionsTableSql)) {
+    qCritical() << "Error creating corporate_actions table:" << query.lastError().text();
+    return false;
+  }
+  // Schema version 7 keys intraday bars by their US/Eastern time, older versions read the vendor's keys in the local zone
+  if (version >= 1 && version < 7 && !migrateSchemaToV7()) {
+    return false;
+  }
+  if (!query.exec(QString("PRAGMA user_version = %1").arg(SCHEMA_VERSION))) {
+    qCritical() << "Error setting schema version:" << query.lastError().text();
+    return false;
+  }
+  // Foreign keys are off by default in SQLite, without this ON DELETE CASCADE does nothing
+  if (!query.exec("PRAGMA foreign_keys = ON")) {
+    qWarning() << "Could not enable foreign keys:" << query.lastError().text();
+  }
+
+  qDebug() << "Database tables created or already exist (schema version" << SCHEMA_VERSION << ").";
+  return true;
+}
+
+// Rewrites the v1 schema (TEXT symbol on every bar, AUTOINCREMENT id, separate UNIQUE index) into the v2 layout
+bool DatabaseManager::migrateSchemaV1ToV2() {
+  qDebug() << "Migrating database schema from version 1 to 2...";
+  QSqlQuery query(database);
+  // Tables are dropped and renamed below, foreign key enforcement has to be off (cannot change inside a transaction)
+  query.exec("PRAGMA foreign_keys = OFF");
+  if (!database.transaction()) {
+    qCritical() << "Error starting schema migration:" << database.lastError().text();
+    return false;
+  }
+  const QStringList steps {
+    R"(CREATE TABLE stocks_v2 (
+           symbol_id INTEGER PRIMARY KEY,
+           symbol TEXT NOT NULL UNIQUE,
+           name TEXT,
+           current_price REAL,
+           price_change REAL,
+           day_high REAL,
+           day_low REAL,
+           day_open REAL,
+           day_close REAL,
+           last_quote_fetch_time BIGINT,
+           last_historical_fetch_time BIGINT
+       ))",
+    R"(INSERT INTO stocks_v2 (symbol, name, current_price, price_change, day_high, day_low, day_open, day_close,
+                              last_quote_fetch_time, last_historical_fetch_time)
+       SELECT symbol, name, current_price, price_change, day_high, day_low, day_open, day_close,
+              last_quote_fetch_time, last_historical_fetch_time
+       FROM stocks ORDER BY symbol)",
+    R"(CREATE TABLE historical_prices_v2 (
+           symbol_id INTEGER NOT NULL,
+           timestamp INTEGER NOT NULL,
+           day_high REAL,
+           day_low REAL,
+           day_open REAL,
+           day_close REAL,
+           volume INTEGER,
+           PRIMARY KEY (symbol_id, timestamp),
+           FOREIGN KEY (symbol_id) REFERENCES stocks(symbol_id) ON DELETE CASCADE
+       ) WITHOUT ROWID)",
+    // Bars of stocks that were deleted (the v1 cascade never fired) are dropped by the join
+    R"(INSERT INTO historical_prices_v2 (symbol_id, timestamp, day_high, day_low, day_open, day_close, volume)
+       SELECT s.symbol_id, h.timestamp, h.day_high, h.day_low, h.day_open, h.day_close, h.volume
+       FROM historical_prices h JOIN stocks_v2 s ON s.symbol = h.stock_symbol
+       ORDER BY s.symbol_id, h.timestamp)",
+    "DROP TABLE historical_prices",
+    "DROP TABLE stocks",
+    "ALTER TABLE stocks_v2 RENAME TO stocks",
+    "ALTER TABLE historical_prices_v2 RENAME TO historical_prices",
+    "PRAGMA user_version = 2",
+  };
+  for (const QString &step : steps) {
+    if (!query.exec(step)) {
+      qCritical() << "Error migrating schema:" << query.lastError().text();
+      database.rollback();
+      return false;
+    }
+  }
+  if (!database.commit()) {
+    qCritical() << "Error committing schema migration:" << database.lastError().text();
+    return false;
+  }
+  // Give the pages of the old row layout and index back to the file system
+  if (!query.exec("VACUUM")) {
+    qWarning() << "Could not vacuum database after migration:" << query.lastError().text();
+  }
+  symbolIds.clear();
+  qDebug() << "Database schema migrated to version 2.";
+  return true;
+}
 
-  qDebug() << "Database tables created or already exist.";
+// Up to version 6 the vendor's US/Eastern intraday keys were read in the machine's zone, so the stored 5min bars and their
+// hourly rollups are off by the difference between the two (nothing moves on a machine set to Eastern time). They are moved
+// to the UTC time of their Eastern key and the statistics, which bucket them by day, are dropped. The daily table is left as
+// it is: fetched daily bars were always keyed by their date, and rolled-up days cannot be told apart from them
+bool DatabaseManager::migrateSchemaToV7() {
+  qDebug() << "Migrating database schema to version 7...";
+  if (!database.transaction()) {
+    qCritical() << "Error starting schema migration:" << database.lastError().text();
+    return false;
+  }
+  QSqlQuery query(database);
+  if (!rekeyIntradayTable("historical_prices", 0) || !rekeyIntradayTable(resolutionTable(BarResolution::Hourly), SECONDS_PER_HOUR) ||
+      !query.exec("UPDATE stocks SET statistics = NULL")) {
+    qCritical() << "Error migrating schema:" << query.lastError().text();
+    database.rollback();
+    return false;
+  }
+  if (!database.commit()) {
+    qCritical() << "Error committing schema migration:" << database.lastError().text();
+    return false;
+  }
+  migratedToV7 = true;
+  qDebug() << "Database schema migrated to version 7.";
   return true;
 }
 
-// Helper to check if a stock already exists in the database
-bool DatabaseManager::stockExists(const QString &symbol) {
+// Rewrites the bars of every symbol with a moved key, the caller owns the transaction
+bool DatabaseManager::rekeyIntradayTable(const QString &table, qint64 bucketSecs) {
   QSqlQuery query(database);
-  query.prepare("SELECT COUNT(*) FROM stocks WHERE symbol = :symbol");
+  if (!query.exec(QString("SELECT DISTINCT symbol_id FROM %1").arg(table))) {
+    qCritical() << "Error listing the symbols of" << table << ":" << query.lastError().text();
+    return false;
+  }
+  QList<qint64> symbolIdList;
+  while (query.next()) {
+    symbolIdList.append(query.value(0).toLongLong());
+  }
+  qsizetype rekeyed = 0;
+  for (const qint64 symbolId : symbolIdList) {
+    HistoricalPriceCursor cursor;
+    cursor.pageSize  = -1;
+    cursor.direction = HistoricalPriceCursor::Forward;
+    bool            moved = false;
+    const BarSeries bars  = rekeyLocalToEastern(readTablePage(database, table, symbolId, cursor), bucketSecs, moved);
+    if (!moved) {
+      continue;  // Stored on a machine set to Eastern time
+    }
+    query.prepare(QString("DELETE FROM %1 WHERE symbol_id = :symbol_id").arg(table));
+    query.bindValue(":symbol_id", symbolId);
+    if (!query.exec()) {
+      qCritical() << "Error clearing" << table << "for the migration:" << query.lastError().text();
+      return false;
+    }
+    if (!prepareBarInsert(query, table, BarConflict::Replace)) {
+      qCritical() << "Error preparing the re-keyed" << table << ":" << query.lastError().text();
+      return false;
+    }
+    for (qsizetype i = 0; i < bars.size(); ++i) {
+      if (!insertBar(query, symbolId, bars, i)) {
+        qCritical() << "Error re-keying" << table << ":" << query.lastError().text();
+        return false;
+      }
+    }
+    rekeyed += bars.size();
+  }
+  qDebug() << "Re-keyed" << rekeyed << "rows of" << table << "to US/Eastern time.";
+  return true;
+}
+
+// The bar store is not versioned, its segments follow the tables they were moved from. Then the statistics are rebuilt
+void DatabaseManager::finishMigrationToV7() {
+  migratedToV7 = false;
+  QSqlQuery query(database);
+  if (!query.exec("SELECT symbol_id, symbol FROM stocks")) {
+    qWarning() << "Error listing the stocks after the migration:" << query.lastError().text();
+    return;
+  }
+  QList<QPair<qint64, QString>> stocks;
+  while (query.next()) {
+    stocks.append({ query.value(0).toLongLong(), query.value(1).toString() });
+  }
+  database.transaction();
+  for (const auto &[symbolId, symbol] : std::as_const(stocks)) {
+    if (barStore && barStore->contains(symbol)) {
+      bool            moved = false;
+      const BarSeries bars  = rekeyLocalToEastern(barStore->view(symbol).toSeries(), 0, moved);
+      if (moved && !barStore->replace(symbol, bars)) {
+        // Bars merged since the segment was created are only in it, the old keys are better than losing them
+        qWarning() << "Could not re-key the bar store segment of" << symbol << ", it keeps its local time keys";
+      }
+    }
+    updateStatistics(symbolId, symbol, true);
+  }
+  if (!database.commit()) {
+    qWarning() << "Error committing the rebuilt statistics:" << database.lastError().text();
+  }
+}
+
+// Bars keyed by reading an Eastern wall-clock key as local time, keyed by the same wall clock read as Eastern time. Moving
+// keys can meet where the two zones change their clocks on different days, the later bar is kept then
+BarSeries DatabaseManager::rekeyLocalToEastern(const BarSeries &bars, qint64 bucketSecs, bool &moved) {
+  BarSeries rekeyed;
+  rekeyed.reserve(bars.size());
+  moved = false;
+  for (qsizetype i = 0; i < bars.size(); ++i) {
+    const time_record_t stored    = bars.timestamp(i);
+    const time_record_t wallClock = stored + QDateTime::fromSecsSinceEpoch(stored).offsetFromUtc();
+    time_record_t       time      = wallClock + easternUtcOffset(wallClock);
+    if (bucketSecs > 0) {
+      time -= time % bucketSecs;  // Rollups stay on their bucket boundaries in zones off by a fraction of an hour
+    }
+    moved = moved || time != stored;
+    rekeyed.insert(time, bars.record(i));
+  }
+  return moved ? rekeyed : bars;
+}
+
+// Maps a symbol to its integer id, creating a bare stocks row when requested, -1 if unknown or on error
+qint64 DatabaseManager::lookupSymbolId(const QString &symbol, bool create) {
+  auto cached = symbolIds.constFind(symbol);
+  if (cached != symbolIds.constEnd()) {
+    return cached.value();
+  }
+  QSqlQuery query(database);
+  if (create) {
+    query.prepare("INSERT INTO stocks (symbol) VALUES (:symbol) ON CONFLICT(symbol) DO NOTHING");
+    query.bindValue(":symbol", symbol);
+    if (!query.exec()) {
+      qWarning() << "Error creating symbol id for" << symbol << ":" << query.lastError().text();
+      return -1;
+    }
+  }
+  query.prepare("SELECT symbol_id FROM stocks WHERE symbol = :symbol");
   query.bindValue(":symbol", symbol);
   if (query.exec() && query.next()) {
-    return query.value(0).toInt() > 0;
+    qint64 id = query.value(0).toLongLong();
+    symbolIds.insert(symbol, id);
+    return id;
   }
-  qWarning() << "Error checking stock existence:" << query.lastError().text();
-  return false;  // Assume not exists on error
+  return -1;
 }
 
 // Adds a new stock or updates an existing one
 bool DatabaseManager::addOrUpdateStock(const Stock &stock) {
-  QSqlQuery query(database);
+  return addOrUpdateStocks({ stock });
+}
 
-  if (stockExists(stock.getSymbol())) {
-    // Update existing stock
-    query.prepare(R"(
-            UPDATE stocks SET
-                name = :name,
-                current_price = :current_price,
-                price_change = :price_change,
-                day_high = :day_high,
-                day_low = :day_low,
-                day_open = :day_open,
-                day_close = :day_close,
-                last_quote_fetch_time = :last_quote_fetch_time,
-                last_historical_fetch_time = :last_historical_fetch_time
-            WHERE symbol = :symbol
-        )");
-    query.bindValue(":symbol", stock.getSymbol());
-  } else {
-    // Insert new stock
-    query.prepare(R"(
+// Adds or updates a batch of stocks in a single transaction with one prepared statement
+bool DatabaseManager::addOrUpdateStocks(const QList<Stock> &stocks) {
+  for (const Stock &stock : stocks) {
+    pendingStocks.remove(stock.getSymbol());  // Superseded by this write
+  }
+  if (!database.transaction()) {
+    qCritical() << "Error starting stock batch:" << database.lastError().text();
+    return false;
+  }
+  for (const Stock &stock : stocks) {
+    if (!writeStock(stock)) {
+      database.rollback();
+      return false;
+    }
+  }
+  if (!database.commit()) {
+    qCritical() << "Error committing stock batch:" << database.lastError().text();
+    return false;
+  }
+  qDebug() << stocks.size() << "stocks added/updated successfully.";
+  return true;
+}
+
+// Prepares the statements reused on every write, they stay valid while the connection is open
+bool DatabaseManager::prepareStatements() {
+  upsertStockQuery = QSqlQuery(database);
+  if (!upsertStockQuery.prepare(R"(
             INSERT INTO stocks (
                 symbol, name, current_price, price_change, day_high, day_low, day_open, day_close,
                 last_quote_fetch_time, last_historical_fetch_time
@@ -122,39 +539,68 @@ bool DatabaseManager::addOrUpdateStock(const Stock &stock) {
                 :symbol, :name, :current_price, :price_change, :day_high, :day_low, :day_open, :day_close,
                 :last_quote_fetch_time, :last_historical_fetch_time
             )
-        )");
-    query.bindValue(":symbol", stock.getSymbol());
+            ON CONFLICT(symbol) DO UPDATE SET
+                name = excluded.name,
+                current_price = excluded.current_price,
+                price_change = excluded.price_change,
+                day_high = excluded.day_high,
+                day_low = excluded.day_low,
+                day_open = excluded.day_open,
+                day_close = excluded.day_close,
+                last_quote_fetch_time = excluded.last_quote_fetch_time,
+                last_historical_fetch_time = excluded.last_historical_fetch_time
+        )")) {
+    qCritical() << "Error preparing stock upsert:" << upsertStockQuery.lastError().text();
+    return false;
   }
 
-  query.bindValue(":name", stock.getName());
-  query.bindValue(":current_price", stock.getCurrentPrice());
-  query.bindValue(":price_change", stock.getPriceChange());
-  query.bindValue(":day_high", stock.getDayHigh());
-  query.bindValue(":day_low", stock.getDayLow());
-  query.bindValue(":day_open", stock.getDayOpen());
-  query.bindValue(":day_close", stock.getDayClose());
-  query.bindValue(":last_quote_fetch_time", stock.getLastQuoteFetchTime());
-  query.bindValue(":last_historical_fetch_time", stock.getLastHistoricalFetchTime());
+  // Rows whose values did not change are not rewritten
+  upsertHistoricalQuery = QSqlQuery(database);
+  if (!prepareBarInsert(upsertHistoricalQuery, "historical_prices", BarConflict::Replace)) {
+    qCritical() << "Error preparing historical price upsert:" << upsertHistoricalQuery.lastError().text();
+    return false;
+  }
+  return true;
+}
 
-  if (!query.exec()) {
-    qCritical() << "Error add/updating stock:" << stock.getSymbol() << ":" << query.lastError().text();
+// Helper that writes one stock row with the prepared upsert, the caller owns the transaction
+bool DatabaseManager::writeStock(const Stock &stock) {
+  upsertStockQuery.bindValue(":symbol", stock.getSymbol());
+  upsertStockQuery.bindValue(":name", stock.getName());
+  upsertStockQuery.bindValue(":current_price", stock.getCurrentPrice());
+  upsertStockQuery.bindValue(":price_change", stock.getPriceChange());
+  upsertStockQuery.bindValue(":day_high", stock.getDayHigh());
+  upsertStockQuery.bindValue(":day_low", stock.getDayLow());
+  upsertStockQuery.bindValue(":day_open", stock.getDayOpen());
+  upsertStockQuery.bindValue(":day_close", stock.getDayClose());
+  upsertStockQuery.bindValue(":last_quote_fetch_time", stock.getLastQuoteFetchTime());
+  upsertStockQuery.bindValue(":last_historical_fetch_time", stock.getLastHistoricalFetchTime());
+
+  if (!upsertStockQuery.exec()) {
+    qCritical() << "Error add/updating stock:" << stock.getSymbol() << ":" << upsertStockQuery.lastError().text();
     return false;
   }
-  qDebug() << "Stock" << stock.getSymbol() << (stockExists(stock.getSymbol()) ? "updated" : "added") << "successfully.";
   return true;
 }
 
 // Loads all stock basic info from the database
 QList<Stock> DatabaseManager::loadAllStocks() {
+  flushPendingWrites();  // Reads must see our own queued writes
   QList<Stock> stocks;
   QSqlQuery    query(database);
-  if (query.exec("SELECT symbol, name, current_price, price_change, day_high, day_low, day_open, day_close, last_quote_fetch_time, "
-                 "last_historical_fetch_time FROM stocks")) {
+  if (query.exec("SELECT symbol_id, symbol, name, current_price, price_change, day_high, day_low, day_open, day_close, "
+                 "last_quote_fetch_time, last_historical_fetch_time, statistics FROM stocks")) {
     while (query.next()) {
+      symbolIds.insert(query.value("symbol").toString(), query.value("symbol_id").toLongLong());
       Stock stock(query.value("symbol").toString(), query.value("name").toString(), query.value("current_price").toDouble(),
                   query.value("price_change").toDouble(), query.value("day_high").toDouble(), query.value("day_low").toDouble(),
                   query.value("day_open").toDouble(), query.value("day_close").toDouble(),
                   query.value("last_quote_fetch_time").toLongLong(), query.value("last_historical_fetch_time").toLongLong());
+      StockStatistics stored;
+      if (!query.value("statistics").isNull() && StockStatistics::fromByteArray(query.value("statistics").toByteArray(), stored)) {
+        stock.setStatistics(stored);
+        statistics.insert(query.value("symbol_id").toLongLong(), stored);
+      }
       stocks.append(stock);
     }
     qDebug() << "Loaded" << stocks.size() << "stocks from database.";
@@ -166,10 +612,11 @@ QList<Stock> DatabaseManager::loadAllStocks() {
 
 // Loads a single stock (used for initial selection if not in memory)
 Stock DatabaseManager::loadStock(const QString &symbol) {
+  flushPendingWrites();  // Reads must see our own queued writes
   QSqlQuery query(database);
   query.prepare(
     "SELECT symbol, name, current_price, price_change, day_high, day_low, day_open, day_close, last_quote_fetch_time, "
-    "last_historical_fetch_time FROM stocks WHERE symbol = "
+    "last_historical_fetch_time, statistics FROM stocks WHERE symbol = "
     ":symbol");
   query.bindValue(":symbol", symbol);
   if (query.exec() && query.next()) {
@@ -177,6 +624,10 @@ Stock DatabaseManager::loadStock(const QString &symbol) {
                 query.value("price_change").toDouble(), query.value("day_high").toDouble(), query.value("day_low").toDouble(),
                 query.value("day_open").toDouble(), query.value("day_close").toDouble(), query.value("last_quote_fetch_time").toLongLong(),
                 query.value("last_historical_fetch_time").toLongLong());
+    StockStatistics stored;
+    if (!query.value("statistics").isNull() && StockStatistics::fromByteArray(query.value("statistics").toByteArray(), stored)) {
+      stock.setStatistics(stored);
+    }
     qDebug() << "Loaded stock:" << symbol << "from database.";
     return stock;
   } else {
@@ -187,6 +638,13 @@ Stock DatabaseManager::loadStock(const QString &symbol) {
 
 // Deletes a stock and its historical prices (due to ON DELETE CASCADE)
 bool DatabaseManager::deleteStock(const QString &symbol) {
+  pendingStocks.remove(symbol);  // Queued writes would resurrect the stock
+  pendingHistoricalPrices.remove(symbol);
+  statistics.remove(symbolIds.value(symbol, -1));
+  symbolIds.remove(symbol);
+  if (barStore && !barStore->remove(symbol)) {
+    qWarning() << "Could not delete the bar segment of" << symbol;
+  }
   QSqlQuery query(database);
   query.prepare("DELETE FROM stocks WHERE symbol = :symbol");
   query.bindValue(":symbol", symbol);
@@ -198,66 +656,914 @@ bool DatabaseManager::deleteStock(const QString &symbol) {
   return true;
 }
 
-// Updates/Inserts historical prices for a stock
-bool DatabaseManager::updateHistoricalPrices(const QString &symbol, const QMap<time_record_t, HistoricalDataRecord> &historicalData) {
-  QSqlQuery query(database);
-  database.transaction();  // Start a transaction for bulk inserts
+void DatabaseManager::requestDeleteStock(const QString &symbol) {
+  const bool deleted = deleteStock(symbol);
+  emit stockDeleted(symbol, deleted);
+}
 
-  // Delete existing historical data for this stock (simpler than selective update/insert for daily data)
-  // For large historical data, you might check if entry exists and update, or only insert new dates.
-  query.prepare("DELETE FROM historical_prices WHERE stock_symbol = :symbol");
-  query.bindValue(":symbol", symbol);
-  if (!query.exec()) {
+// Merges historical prices for a stock: only new or changed timestamps are written, older history is kept
+bool DatabaseManager::updateHistoricalPrices(const QString &symbol, const BarSeries &historicalData, HistoricalMergeResult *result) {
+  flushPendingWrites();  // Keep the queued batches of this symbol ordered before this one
+  database.transaction();  // Start a transaction for bulk upserts
+  HistoricalMergeResult merge;
+  if (!mergeHistoricalPrices(symbol, historicalData, merge)) {
     database.rollback();
-    qCritical() << "Error deleting old historical prices for" << symbol << ":" << query.lastError().text();
+    symbolIds.clear();  // Ids created in the rolled back transaction are gone
+    statistics.clear();
     return false;
   }
+  if (!database.commit()) {  // Commit the transaction
+    qCritical() << "Error committing historical price update:" << database.lastError().text();
+    database.rollback();
+    symbolIds.clear();
+    statistics.clear();
+    return false;
+  }
+  if (result) {
+    *result = merge;
+  }
+  return true;
+}
 
-  // Insert new historical data
-  query.prepare(
-    "INSERT INTO historical_prices (stock_symbol, timestamp, day_high, day_low, day_open, day_close, volume) VALUES(:symbol, :timestamp, "
-    ":day_high, :day_low, :day_open, :day_close, :volume)");
+bool DatabaseManager::importHistoricalPrices(const QHash<QString, BarSeries> &historicalData, HistoricalMergeResult *result) {
+  flushPendingWrites();
+  if (!database.transaction()) {
+    qCritical() << "Error starting import transaction:" << database.lastError().text();
+    return false;
+  }
+  HistoricalMergeResult total;
   for (auto it = historicalData.constBegin(); it != historicalData.constEnd(); ++it) {
-    query.bindValue(":symbol", symbol);
-    query.bindValue(":timestamp", it.key());
-    query.bindValue(":day_high", it.value().high);
-    query.bindValue(":day_low", it.value().low);
-    query.bindValue(":day_open", it.value().open);
-    query.bindValue(":day_close", it.value().close);
-    query.bindValue(":volume", it.value().volume);
-    if (!query.exec()) {
+    HistoricalMergeResult merge;
+    if (lookupSymbolId(it.key(), true) < 0 || !mergeHistoricalPrices(it.key(), it.value(), merge)) {
       database.rollback();
-      qCritical() << "Error inserting historical price for" << symbol << "on" << QDateTime::fromSecsSinceEpoch(it.key()) << ":"
-                  << query.lastError().text();
+      symbolIds.clear();  // Ids created in the rolled back transaction are gone
+      statistics.clear();
       return false;
     }
+    total.inserted  += merge.inserted;
+    total.updated   += merge.updated;
+    total.unchanged += merge.unchanged;
+  }
+  if (!database.commit()) {
+    qCritical() << "Error committing historical price import:" << database.lastError().text();
+    database.rollback();
+    symbolIds.clear();
+    statistics.clear();
+    return false;
   }
+  if (result) {
+    *result = total;
+  }
+  return true;
+}
 
-  if (!database.commit()) {  // Commit the transaction
-    qCritical() << "Error committing historical price update:" << database.lastError().text();
+// Helper that upserts a batch of historical prices, the caller owns the transaction
+bool DatabaseManager::mergeHistoricalPrices(const QString &symbol, const BarSeries &historicalData, HistoricalMergeResult &result) {
+  if (barStore) {
+    columnarView(symbol);  // Make sure older SQLite rows were moved over before merging on top of them
+    if (!barStore->merge(symbol, historicalData, result.inserted, result.updated)) {
+      qCritical() << "Error merging historical prices for" << symbol << "into the bar store.";
+      return false;
+    }
+    result.unchanged = historicalData.size() - result.inserted - result.updated;
+    qDebug() << "Historical prices for" << symbol << "merged into the bar store (inserted" << result.inserted << ", updated"
+             << result.updated << ", unchanged" << result.unchanged << "entries).";
+  } else if (!mergeHistoricalPricesSql(symbol, historicalData, result)) {
     return false;
   }
-  qDebug() << "Historical prices for" << symbol << "updated successfully (inserted" << historicalData.size() << "entries).";
+
+  // Only bars from the open day on can be folded into the statistics. When the counts say that an older bar was inserted or
+  // changed (a backfill, a corrected bar), the statistics are replayed from the whole history instead
+  const qint64    symbolId = lookupSymbolId(symbol, true);
+  const qsizetype written  = result.inserted + result.updated;
+  if (symbolId >= 0 && written > 0) {
+    const qsizetype recent = historicalData.size() - historicalData.lowerBound(statisticsOf(symbolId).openDayStart());
+    updateStatistics(symbolId, symbol, written > recent);  // A failure is logged, the bars are merged all the same
+  }
   return true;
 }
 
+// The SQLite half of mergeHistoricalPrices
+bool DatabaseManager::mergeHistoricalPricesSql(const QString &symbol, const BarSeries &historicalData, HistoricalMergeResult &result) {
+  qint64 symbolId = lookupSymbolId(symbol, true);
+  if (symbolId < 0) {
+    return false;
+  }
+  if (historicalData.isEmpty()) {
+    result = HistoricalMergeResult();
+    return true;
+  }
+  // Only the rows in the batch's time range can change, counting them keeps a merge O(batch) instead of O(history)
+  const time_record_t first      = historicalData.firstTimestamp();
+  const time_record_t last       = historicalData.lastTimestamp();
+  qsizetype           rowsBefore = countHistoricalPrices(symbolId, "historical_prices", first, last);
+  if (rowsBefore < 0) {
+    return false;
+  }
+
+  qsizetype rowsWritten = 0;
+  for (qsizetype i = 0; i < historicalData.size(); ++i) {
+    if (!insertBar(upsertHistoricalQuery, symbolId, historicalData, i)) {
+      qCritical() << "Error merging historical price for" << symbol << "on" << QDateTime::fromSecsSinceEpoch(historicalData.timestamp(i))
+                  << ":" << upsertHistoricalQuery.lastError().text();
+      return false;
+    }
+    rowsWritten += upsertHistoricalQuery.numRowsAffected();  // 1 if inserted or changed, 0 if identical
+  }
+
+  qsizetype rowsAfter = countHistoricalPrices(symbolId, "historical_prices", first, last);
+  if (rowsAfter < 0) {
+    return false;
+  }
+  result.inserted  = rowsAfter - rowsBefore;
+  result.updated   = rowsWritten - result.inserted;
+  result.unchanged = historicalData.size() - rowsWritten;
+  qDebug() << "Historical prices for" << symbol << "merged successfully (inserted" << result.inserted << ", updated" << result.updated
+           << ", unchanged" << result.unchanged << "entries).";
+  return true;
+}
+
+// Helper to count the stored historical prices of a stock in [from, to], -1 on error. A range scan of the primary key
+qsizetype DatabaseManager::countHistoricalPrices(qint64 symbolId, const QString &table, time_record_t from, time_record_t to) {
+  QSqlQuery query(database);
+  query.prepare(QString("SELECT COUNT(*) FROM %1 WHERE symbol_id = :symbol_id AND timestamp BETWEEN :from AND :to").arg(table));
+  query.bindValue(":symbol_id", symbolId);
+  query.bindValue(":from", from);
+  query.bindValue(":to", to);
+  if (query.exec() && query.next()) {
+    return query.value(0).toLongLong();
+  }
+  qWarning() << "Error counting historical prices for symbol id" << symbolId << ":" << query.lastError().text();
+  return -1;
+}
+
 // Loads historical prices for a given stock
-QMap<time_record_t, HistoricalDataRecord> DatabaseManager::loadHistoricalPrices(const QString &symbol) {
-  QMap<time_record_t, HistoricalDataRecord> historicalData;
-  QSqlQuery                                 query(database);
-  query.prepare(
-    "SELECT timestamp, day_high, day_low, day_open, day_close, volume FROM historical_prices WHERE stock_symbol = :symbol ORDER BY "
-    "timestamp ASC");
-  query.bindValue(":symbol", symbol);
-  if (query.exec()) {
-    while (query.next()) {
-      historicalData.insert(query.value("timestamp").toLongLong(),
-                            { query.value("day_open").toDouble(), query.value("day_high").toDouble(), query.value("day_low").toDouble(),
-                              query.value("day_close").toDouble(), query.value("volume").toLongLong() });
+BarSeries DatabaseManager::loadHistoricalPrices(const QString &symbol) {
+  return loadHistoricalPrices(symbol, std::numeric_limits<time_record_t>::min(), std::numeric_limits<time_record_t>::max());
+}
+
+// Loads the historical prices of a stock within [from, to]
+BarSeries DatabaseManager::loadHistoricalPrices(const QString &symbol, time_record_t from, time_record_t to, qsizetype maxRows) {
+  HistoricalPriceCursor cursor;
+  cursor.symbol    = symbol;
+  cursor.from      = from;
+  cursor.to        = to;
+  cursor.pageSize  = maxRows;
+  cursor.direction = maxRows < 0 ? HistoricalPriceCursor::Forward : HistoricalPriceCursor::Backward;  // A cap keeps the newest rows
+  return fetchHistoricalPage(cursor);
+}
+
+// Loads one page of a cursor from whichever backend holds the historical prices
+BarSeries DatabaseManager::fetchHistoricalPage(HistoricalPriceCursor &cursor) {
+  flushPendingWrites();  // Reads must see our own queued writes
+  return barStore ? fetchHistoricalPageColumnar(cursor) : fetchHistoricalPageSql(cursor);
+}
+
+// The cursor travels with the page, the caller keeps no state about the request
+void DatabaseManager::requestHistoricalPage(const HistoricalPriceCursor &cursor) {
+  HistoricalPriceCursor next = cursor;
+  const BarSeries       page = fetchHistoricalPage(next);
+  emit historicalPageLoaded(next, page);
+}
+
+// Returns the mapped bars in [from, to] without copying them
+BarColumnsView DatabaseManager::loadHistoricalView(const QString &symbol, time_record_t from, time_record_t to) {
+  flushPendingWrites();
+  if (!barStore) {
+    return BarColumnsView();
+  }
+  return columnarView(symbol).range(from, to);
+}
+
+// Fetched daily and weekly bars are kept as they come, compaction never overwrites them (its rollups DO NOTHING on conflict)
+bool DatabaseManager::storeHistoricalPrices(const QString &symbol, const BarSeries &historicalData, BarResolution resolution,
+                                            HistoricalMergeResult *result) {
+  if (resolution == BarResolution::FiveMinutes) {
+    return updateHistoricalPrices(symbol, historicalData, result);
+  }
+  if (historicalData.isEmpty()) {
+    if (result) {
+      *result = HistoricalMergeResult();
+    }
+    return true;
+  }
+  flushPendingWrites();
+  if (!database.transaction()) {
+    qCritical() << "Error starting historical price transaction:" << database.lastError().text();
+    return false;
+  }
+  // Counted within the batch's time range only, the rest of the table is not touched
+  const QString       table      = resolutionTable(resolution);
+  const time_record_t first      = historicalData.firstTimestamp();
+  const time_record_t last       = historicalData.lastTimestamp();
+  qint64              symbolId   = lookupSymbolId(symbol, true);
+  qsizetype           rowsBefore = symbolId < 0 ? -1 : countHistoricalPrices(symbolId, table, first, last);
+  if (rowsBefore < 0) {
+    database.rollback();
+    symbolIds.clear();
+    return false;
+  }
+  QSqlQuery query(database);
+  if (!prepareBarInsert(query, table, BarConflict::Replace)) {
+    qCritical() << "Error preparing" << table << "upsert:" << query.lastError().text();
+    database.rollback();
+    symbolIds.clear();
+    return false;
+  }
+  qsizetype rowsWritten = 0;
+  for (qsizetype i = 0; i < historicalData.size(); ++i) {
+    if (!insertBar(query, symbolId, historicalData, i)) {
+      qCritical() << "Error storing" << table << "bar for" << symbol << "on" << QDateTime::fromSecsSinceEpoch(historicalData.timestamp(i))
+                  << ":" << query.lastError().text();
+      database.rollback();
+      symbolIds.clear();
+      return false;
+    }
+    rowsWritten += query.numRowsAffected();
+  }
+  const qsizetype rowsAfter = countHistoricalPrices(symbolId, table, first, last);
+  if (rowsAfter < 0) {
+    database.rollback();
+    symbolIds.clear();
+    return false;
+  }
+  HistoricalMergeResult merge;
+  merge.inserted  = rowsAfter - rowsBefore;
+  merge.updated   = rowsWritten - merge.inserted;
+  merge.unchanged = historicalData.size() - rowsWritten;
+  if (rowsWritten > 0) {
+    updateStatistics(symbolId, symbol, true);  // Daily bars reach back a year and more, the whole window changes
+  }
+  if (!database.commit()) {
+    qCritical() << "Error committing" << table << "for" << symbol << ":" << database.lastError().text();
+    database.rollback();
+    symbolIds.clear();
+    statistics.clear();
+    return false;
+  }
+  qDebug() << "Stored" << historicalData.size() << "bars of" << table << "for" << symbol << "(inserted" << merge.inserted << ", updated"
+           << merge.updated << ", unchanged" << merge.unchanged << "entries).";
+  if (result) {
+    *result = merge;
+  }
+  return true;
+}
+
+// The resolution's own table is read first. Finer tables only fill the part of the range before and after it (rolled up),
+// coarser ones what is left; each source is read with one range scan. A bar is only taken when its whole bucket lies
+// outside what is covered already, so nothing is counted twice. Gaps inside a source are not filled from the others.
+BarSeries DatabaseManager::loadHistoricalPrices(const QString &symbol, time_record_t from, time_record_t to, BarResolution resolution) {
+  flushPendingWrites();
+  BarSeries    historicalData;
+  const qint64 symbolId = lookupSymbolId(symbol, false);
+  if (symbolId < 0 || from > to) {
+    return historicalData;
+  }
+  QList<BarResolution> sources;  // In order of preference
+  for (int level = int(resolution); level >= int(BarResolution::FiveMinutes); --level) {
+    sources.append(BarResolution(level));
+  }
+  for (int level = int(resolution) + 1; level <= int(BarResolution::Weekly); ++level) {
+    sources.append(BarResolution(level));
+  }
+  const qint64  bucketSecs  = resolutionSeconds(resolution);
+  bool          covered     = false;
+  time_record_t coveredFrom = from, coveredTo = to;  // Start of the first and end of the last bucket read so far
+  for (BarResolution source : sources) {
+    const qint64                               sourceSecs = resolutionSeconds(source);
+    QList<QPair<time_record_t, time_record_t>> parts;
+    if (!covered) {
+      parts.append({ from, to });
+    } else {
+      if (from <= coveredFrom - sourceSecs) {
+        parts.append({ from, coveredFrom - sourceSecs });  // The last bar must end before the covered part starts
+      }
+      if (coveredTo < to) {
+        parts.append({ coveredTo + 1, to });
+      }
+    }
+    for (const auto &[partFrom, partTo] : std::as_const(parts)) {
+      HistoricalPriceCursor cursor;
+      cursor.symbol    = symbol;
+      cursor.from      = partFrom;
+      cursor.to        = partTo;
+      cursor.pageSize  = -1;
+      cursor.direction = HistoricalPriceCursor::Forward;
+      const bool fromBarStore = source == BarResolution::FiveMinutes && barStore;  // Raw bars live in the segment then
+      BarSeries  bars         = fromBarStore ? readHistoricalPage(columnarView(symbol), cursor)
+                                             : readTablePage(database, resolutionTable(source), symbolId, cursor);
+      if (bars.isEmpty()) {
+        continue;
+      }
+      if (source < resolution) {
+        const time_record_t intradayFrom = source < BarResolution::Daily ? std::numeric_limits<time_record_t>::min()
+                                                                          : std::numeric_limits<time_record_t>::max();
+        bars                             = rollUp(bars, bucketSecs, resolutionOrigin(resolution), intradayFrom);
+      }
+      const time_record_t barsTo = bars.lastTimestamp() + qMax(bucketSecs, sourceSecs) - 1;
+      coveredFrom                = covered ? qMin(coveredFrom, bars.firstTimestamp()) : bars.firstTimestamp();
+      coveredTo                  = covered ? qMax(coveredTo, barsTo) : barsTo;
+      covered                    = true;
+      historicalData.merge(bars);
+    }
+  }
+  normalizeBars(historicalData);  // Rollups of validated bars, this only catches what was stored before validation existed
+  if (!historicalData.isEmpty()) {
+    historicalData = readAdjustmentSchedule(database, symbolId).apply(historicalData);
+  }
+  qDebug() << "Loaded" << historicalData.size() << "bars of" << resolutionSeconds(resolution) << "seconds for" << symbol;
+  return historicalData;
+}
+
+BarSeries DatabaseManager::loadHistoricalRange(const QString &symbol, time_record_t from, time_record_t to, qsizetype maxBars,
+                                               BarResolution *resolution) {
+  const BarResolution picked = resolutionFor(from, to, maxBars);
+  if (resolution) {
+    *resolution = picked;
+  }
+  return loadHistoricalPrices(symbol, from, to, picked);
+}
+
+void DatabaseManager::requestHistoricalRange(const QString &symbol, time_record_t from, time_record_t to, qsizetype maxBars) {
+  BarResolution   resolution = BarResolution::FiveMinutes;
+  const BarSeries bars       = loadHistoricalRange(symbol, from, to, maxBars, &resolution);
+  emit historicalRangeLoaded(symbol, from, to, maxBars, resolution, bars);
+}
+
+// Pages through the mapped columns, the page is a slice of the range found by binary search
+BarSeries DatabaseManager::fetchHistoricalPageColumnar(HistoricalPriceCursor &cursor) {
+  if (cursor.exhausted || cursor.from > cursor.to) {
+    cursor.exhausted = true;
+    return {};
+  }
+  BarColumnsView rawBars = columnarView(cursor.symbol);
+  return readHistoricalPage(database, lookupSymbolId(cursor.symbol, false), cursor, &rawBars);
+}
+
+// Slices the next page of the cursor out of a symbol's mapped columns, binary search only
+BarSeries DatabaseManager::readHistoricalPage(const BarColumnsView &bars, HistoricalPriceCursor &cursor) {
+  if (cursor.exhausted || cursor.from > cursor.to) {
+    cursor.exhausted = true;
+    return {};
+  }
+  BarColumnsView range = bars.range(cursor.from, cursor.to);
+  BarColumnsView page  = range;
+  if (cursor.pageSize < 0 || range.size() <= cursor.pageSize) {
+    cursor.exhausted = true;
+  } else if (cursor.direction == HistoricalPriceCursor::Backward) {
+    page      = range.mid(range.size() - cursor.pageSize, cursor.pageSize);
+    cursor.to = page.firstTimestamp() - 1;
+  } else {
+    page        = range.mid(0, cursor.pageSize);
+    cursor.from = page.lastTimestamp() + 1;
+  }
+  qDebug() << "Loaded" << page.size() << "historical prices for" << cursor.symbol << "from the bar store";
+  return page.toSeries();
+}
+
+// The bar store is filled lazily: the first access of a symbol moves its SQLite rows into a segment
+BarColumnsView DatabaseManager::columnarView(const QString &symbol) {
+  if (!barStore->contains(symbol)) {
+    HistoricalPriceCursor cursor;
+    cursor.symbol    = symbol;
+    cursor.pageSize  = -1;
+    cursor.direction = HistoricalPriceCursor::Forward;
+    BarSeries stored = readTablePage(database, "historical_prices", lookupSymbolId(symbol, false), cursor);
+    qsizetype inserted, updated;
+    if (!stored.isEmpty() && barStore->merge(symbol, stored, inserted, updated)) {
+      qDebug() << "Moved" << inserted << "historical prices for" << symbol << "from SQLite to the bar store.";
+    }
+  }
+  return barStore->view(symbol);
+}
+
+BarSeries DatabaseManager::fetchHistoricalPageSql(HistoricalPriceCursor &cursor) {
+  if (cursor.exhausted || cursor.from > cursor.to) {
+    cursor.exhausted = true;
+    return {};
+  }
+  return readHistoricalPage(database, lookupSymbolId(cursor.symbol, false), cursor);
+}
+
+// Runs one page of the cursor on the given connection, which may belong to another thread than the storage one.
+// Compaction leaves the raw, hourly and daily bars of a symbol in disjoint time ranges, so each source is paged with its
+// own copy of the cursor and the merged result is cut back to one page on the side the cursor moves away from.
+// Fetched daily and weekly bars overlap the finer ones, so every source is cut off before the bucket the finer ones start in.
+BarSeries DatabaseManager::readHistoricalPage(QSqlDatabase &connection, qint64 symbolId, HistoricalPriceCursor &cursor,
+                                              const BarColumnsView *rawBars) {
+  BarSeries historicalData;
+  if (cursor.exhausted || cursor.from > cursor.to) {
+    cursor.exhausted = true;
+    return historicalData;
+  }
+  bool                  exhausted  = true;
+  time_record_t         finerStart = std::numeric_limits<time_record_t>::max();  // First bar of the finer sources
+  HistoricalPriceCursor source     = cursor;
+  if (rawBars) {
+    historicalData = readHistoricalPage(*rawBars, source);
+    exhausted      = source.exhausted;
+    if (!rawBars->isEmpty()) {
+      finerStart = rawBars->firstTimestamp();
     }
-    qDebug() << "Loaded" << historicalData.size() << "historical prices for" << symbol;
+  }
+  QList<BarResolution> resolutions { BarResolution::Hourly, BarResolution::Daily, BarResolution::Weekly };
+  if (!rawBars) {
+    resolutions.prepend(BarResolution::FiveMinutes);  // Otherwise the raw bars came from the mapped segment
+  }
+  if (!cursor.layoutRead) {
+    cursor.firstStored.fill(std::numeric_limits<time_record_t>::max(), int(BarResolution::Weekly) + 1);
+    for (BarResolution resolution : resolutions) {
+      cursor.firstStored[int(resolution)] = firstStoredTimestamp(connection, resolutionTable(resolution), symbolId);
+    }
+    if (cursor.adjusted) {
+      cursor.adjustments = readAdjustmentSchedule(connection, symbolId);
+    }
+    cursor.layoutRead = true;
+  }
+  for (BarResolution resolution : resolutions) {
+    const QString table = resolutionTable(resolution);
+    source              = cursor;
+    if (finerStart != std::numeric_limits<time_record_t>::max()) {
+      source.to = qMin(source.to, resolutionBucket(resolution, finerStart) - 1);
+    }
+    historicalData.merge(readTablePage(connection, table, symbolId, source));
+    exhausted  = exhausted && source.exhausted;
+    finerStart = qMin(finerStart, cursor.firstStored.at(int(resolution)));
+  }
+
+  const bool backward = cursor.direction == HistoricalPriceCursor::Backward;
+  if (cursor.pageSize >= 0 && historicalData.size() > cursor.pageSize) {
+    historicalData = historicalData.mid(backward ? historicalData.size() - cursor.pageSize : 0, cursor.pageSize);
+    exhausted      = false;
+  }
+  if (exhausted || historicalData.isEmpty()) {
+    cursor.exhausted = true;
+  } else if (backward) {
+    cursor.to = historicalData.firstTimestamp() - 1;
   } else {
-    qWarning() << "Error loading historical prices for" << symbol << ":" << query.lastError().text();
+    cursor.from = historicalData.lastTimestamp() + 1;
+  }
+  // After the boundary moved, a dropped bar must not be read again. No interval: pages mix raw, hourly and daily bars
+  cursor.quality |= normalizeBars(historicalData).flags;
+  if (cursor.adjusted && !historicalData.isEmpty()) {
+    historicalData = cursor.adjustments.apply(historicalData);
   }
   return historicalData;
-}
\ No newline at end of file
+}
+
+// The actions of a symbol are few (a handful of splits, a few dividends a year), a cursor reads them once for all its pages
+AdjustmentSchedule DatabaseManager::readAdjustmentSchedule(QSqlDatabase &connection, qint64 symbolId) {
+  QSqlQuery query(connection);
+  query.setForwardOnly(true);
+  query.prepare("SELECT kind, effective_time, value, price_factor, volume_factor FROM corporate_actions WHERE symbol_id = :symbol_id");
+  query.bindValue(":symbol_id", symbolId);
+  if (!query.exec()) {
+    qWarning() << "Error reading corporate actions for symbol id" << symbolId << ":" << query.lastError().text();
+    return AdjustmentSchedule();
+  }
+  QList<CorporateAction> actions;
+  while (query.next()) {
+    CorporateAction action;
+    action.kind          = CorporateAction::Kind(query.value(0).toInt());
+    action.effectiveTime = query.value(1).toLongLong();
+    action.value         = query.value(2).toDouble();
+    action.priceFactor   = query.value(3).isNull() ? 1.0 : query.value(3).toDouble();  // Unresolved dividend, no adjustment yet
+    action.volumeFactor  = query.value(4).toDouble();
+    actions.append(action);
+  }
+  return AdjustmentSchedule(actions);
+}
+
+BarSeries DatabaseManager::adjustHistoricalPrices(const QString &symbol, const BarSeries &historicalData) {
+  qint64 symbolId = lookupSymbolId(symbol, false);
+  if (symbolId < 0 || historicalData.isEmpty()) {
+    return historicalData;
+  }
+  return readAdjustmentSchedule(database, symbolId).apply(historicalData);
+}
+
+void DatabaseManager::requestAdjustedPrices(const QString &symbol, const BarSeries &historicalData) {
+  emit adjustedPricesReady(symbol, adjustHistoricalPrices(symbol, historicalData));
+}
+
+bool DatabaseManager::importCorporateActions(const QHash<QString, QList<CorporateAction>> &actions) {
+  flushPendingWrites();  // Dividend factors are computed from the stored closes, including the queued ones
+  if (!database.transaction()) {
+    qCritical() << "Error starting corporate action import transaction:" << database.lastError().text();
+    return false;
+  }
+  qsizetype written = 0;
+  for (auto it = actions.constBegin(); it != actions.constEnd(); ++it) {
+    qint64 symbolId = lookupSymbolId(it.key(), true);
+    if (symbolId < 0) {
+      database.rollback();
+      symbolIds.clear();  // Ids created in the rolled back transaction are gone
+      return false;
+    }
+    for (const CorporateAction &action : it.value()) {
+      if (!writeCorporateAction(symbolId, it.key(), action)) {
+        database.rollback();
+        symbolIds.clear();
+        statistics.clear();
+        return false;
+      }
+      ++written;
+    }
+    updateStatistics(symbolId, it.key(), true);  // The adjustment of the bars before the actions changed
+  }
+  if (!database.commit()) {
+    qCritical() << "Error committing corporate action import:" << database.lastError().text();
+    database.rollback();
+    symbolIds.clear();
+    statistics.clear();
+    return false;
+  }
+  qDebug() << "Imported" << written << "corporate actions for" << actions.size() << "symbols.";
+  return true;
+}
+
+// Dividends imported before the bars they follow have no factor yet, this retries them against the bars stored now
+bool DatabaseManager::resolveDividendFactors() {
+  flushPendingWrites();
+  QSqlQuery query(database);
+  query.setForwardOnly(true);
+  if (!query.exec(QString(R"(
+        SELECT s.symbol_id, s.symbol, a.effective_time, a.value
+        FROM corporate_actions a JOIN stocks s ON s.symbol_id = a.symbol_id
+        WHERE a.kind = %1 AND a.price_factor IS NULL
+    )").arg(int(CorporateAction::Dividend)))) {
+    qWarning() << "Error reading unresolved dividends:" << query.lastError().text();
+    return false;
+  }
+  struct Unresolved {
+      qint64          symbolId;
+      QString         symbol;
+      CorporateAction action;
+  };
+  QList<Unresolved> unresolved;
+  while (query.next()) {
+    unresolved.append({ query.value(0).toLongLong(), query.value(1).toString(),
+                        CorporateAction::dividend(query.value(2).toLongLong(), query.value(3).toDouble(), 0.0) });
+  }
+  query.finish();
+  if (unresolved.isEmpty()) {
+    return true;
+  }
+  database.transaction();
+  QHash<qint64, QString> adjusted;
+  for (const Unresolved &dividend : std::as_const(unresolved)) {
+    if (!writeCorporateAction(dividend.symbolId, dividend.symbol, dividend.action)) {
+      database.rollback();
+      statistics.clear();
+      return false;
+    }
+    adjusted.insert(dividend.symbolId, dividend.symbol);
+  }
+  for (auto it = adjusted.constBegin(); it != adjusted.constEnd(); ++it) {
+    updateStatistics(it.key(), it.value(), true);
+  }
+  if (!database.commit()) {
+    qCritical() << "Error committing dividend factors:" << database.lastError().text();
+    database.rollback();
+    statistics.clear();
+    return false;
+  }
+  return true;
+}
+
+// Helper that upserts one action, the caller owns the transaction
+bool DatabaseManager::writeCorporateAction(qint64 symbolId, const QString &symbol, CorporateAction action) {
+  QVariant priceFactor = action.priceFactor;
+  if (action.kind == CorporateAction::Dividend && action.priceFactor == 1.0 && action.value > 0) {
+    const double close = previousClose(symbol, action.effectiveTime);
+    if (close > 0) {
+      priceFactor = CorporateAction::dividend(action.effectiveTime, action.value, close).priceFactor;
+    } else {
+      priceFactor = QVariant(QMetaType::fromType<double>());  // NULL, left for resolveDividendFactors()
+    }
+  }
+  QSqlQuery query(database);
+  query.prepare(R"(
+        INSERT INTO corporate_actions (symbol_id, effective_time, kind, value, price_factor, volume_factor)
+        VALUES (:symbol_id, :effective_time, :kind, :value, :price_factor, :volume_factor)
+        ON CONFLICT(symbol_id, effective_time, kind) DO UPDATE SET
+            value = excluded.value,
+            price_factor = excluded.price_factor,
+            volume_factor = excluded.volume_factor
+    )");
+  query.bindValue(":symbol_id", symbolId);
+  query.bindValue(":effective_time", action.effectiveTime);
+  query.bindValue(":kind", int(action.kind));
+  query.bindValue(":value", action.value);
+  query.bindValue(":price_factor", priceFactor);
+  query.bindValue(":volume_factor", action.volumeFactor);
+  if (!query.exec()) {
+    qCritical() << "Error writing corporate action for" << symbol << "on" << QDateTime::fromSecsSinceEpoch(action.effectiveTime) << ":"
+                << query.lastError().text();
+    return false;
+  }
+  return true;
+}
+
+double DatabaseManager::previousClose(const QString &symbol, time_record_t time) {
+  HistoricalPriceCursor cursor;
+  cursor.symbol   = symbol;
+  cursor.to       = time - 1;
+  cursor.pageSize = 1;
+  cursor.adjusted = false;  // Factors are defined on the prices as traded
+  // Not fetchHistoricalPage(), this runs inside the caller's transaction and must not start a group commit
+  const BarSeries bars = barStore ? fetchHistoricalPageColumnar(cursor) : fetchHistoricalPageSql(cursor);
+  return bars.isEmpty() ? 0.0 : double(bars.closes().last());
+}
+
+StockStatistics &DatabaseManager::statisticsOf(qint64 symbolId) {
+  auto cached = statistics.find(symbolId);
+  if (cached != statistics.end()) {
+    return cached.value();
+  }
+  StockStatistics stored;
+  QSqlQuery       query(database);
+  query.prepare("SELECT statistics FROM stocks WHERE symbol_id = :symbol_id");
+  query.bindValue(":symbol_id", symbolId);
+  if (query.exec() && query.next() && !query.value(0).isNull()) {
+    StockStatistics::fromByteArray(query.value(0).toByteArray(), stored);  // Left empty when corrupt, the next update rebuilds it
+  }
+  return statistics.insert(symbolId, stored).value();
+}
+
+// Runs inside the caller's transaction, the bars it reads include the ones just merged. An update reads a day or two of
+// bars (the open day and whatever came after it), a rebuild the whole history; both read adjusted prices
+bool DatabaseManager::updateStatistics(qint64 symbolId, const QString &symbol, bool rebuild) {
+  StockStatistics &symbolStatistics = statisticsOf(symbolId);
+  if (rebuild) {
+    symbolStatistics.clear();
+  }
+  HistoricalPriceCursor cursor;
+  cursor.symbol    = symbol;
+  cursor.from      = symbolStatistics.openDayStart();
+  cursor.pageSize  = -1;
+  cursor.direction = HistoricalPriceCursor::Forward;
+  const BarSeries bars = barStore ? fetchHistoricalPageColumnar(cursor) : fetchHistoricalPageSql(cursor);
+  // The page stitches daily rows before the first hourly or raw bar, those are on their date already
+  time_record_t intradayFrom = firstStoredTimestamp(database, resolutionTable(BarResolution::Hourly), symbolId);
+  if (!barStore) {
+    intradayFrom = qMin(intradayFrom, firstStoredTimestamp(database, "historical_prices", symbolId));
+  } else if (const BarColumnsView rawBars = columnarView(symbol); !rawBars.isEmpty()) {
+    intradayFrom = qMin(intradayFrom, rawBars.firstTimestamp());
+  }
+  symbolStatistics.update(rollUp(bars, SECONDS_PER_DAY, 0, intradayFrom));
+
+  QSqlQuery query(database);
+  query.prepare("UPDATE stocks SET statistics = :statistics WHERE symbol_id = :symbol_id");
+  query.bindValue(":statistics", symbolStatistics.toByteArray());
+  query.bindValue(":symbol_id", symbolId);
+  if (!query.exec()) {
+    qWarning() << "Error storing the statistics of" << symbol << ":" << query.lastError().text();
+    statistics.remove(symbolId);  // Reloaded from the row next time, updating from its open day picks these bars up again
+    return false;
+  }
+  emit statisticsUpdated(symbol, symbolStatistics);
+  return true;
+}
+
+// One page of a single table, a range scan over its clustered (symbol_id, timestamp) key
+BarSeries DatabaseManager::readTablePage(QSqlDatabase &connection, const QString &table, qint64 symbolId, HistoricalPriceCursor &cursor) {
+  BarSeries historicalData;
+  if (cursor.exhausted || cursor.from > cursor.to) {
+    cursor.exhausted = true;
+    return historicalData;
+  }
+  if (symbolId < 0) {
+    qDebug() << "No stored historical prices for" << cursor.symbol;
+    cursor.exhausted = true;
+    return historicalData;
+  }
+  const bool backward = cursor.direction == HistoricalPriceCursor::Backward;
+  QSqlQuery  query(connection);
+  query.setForwardOnly(true);
+  // The page is taken from the end the cursor moves away from, and read back in ascending order so every row is an append
+  query.prepare(QString("SELECT * FROM (SELECT timestamp, day_high, day_low, day_open, day_close, volume FROM %1 WHERE symbol_id = "
+                        ":symbol_id AND timestamp BETWEEN :from AND :to ORDER BY timestamp %2 LIMIT :limit) ORDER BY timestamp ASC")
+                  .arg(table, backward ? "DESC" : "ASC"));
+  query.bindValue(":symbol_id", symbolId);
+  query.bindValue(":from", cursor.from);
+  query.bindValue(":to", cursor.to);
+  query.bindValue(":limit", cursor.pageSize);  // Negative means no limit in SQLite
+  if (!query.exec()) {
+    qWarning() << "Error loading" << table << "for" << cursor.symbol << ":" << query.lastError().text();
+    return historicalData;
+  }
+  if (cursor.pageSize > 0) {
+    historicalData.reserve(cursor.pageSize);
+  }
+  while (query.next()) {
+    historicalData.append(query.value("timestamp").toLongLong(),
+                          { query.value("day_open").toDouble(), query.value("day_high").toDouble(), query.value("day_low").toDouble(),
+                            query.value("day_close").toDouble(), query.value("volume").toLongLong() });
+  }
+  // Move the boundary past the last row read, a short page means the range is done
+  if (cursor.pageSize < 0 || historicalData.size() < cursor.pageSize) {
+    cursor.exhausted = true;
+  } else if (backward) {
+    cursor.to = historicalData.firstTimestamp() - 1;
+  } else {
+    cursor.from = historicalData.lastTimestamp() + 1;
+  }
+  qDebug() << "Loaded" << historicalData.size() << "rows of" << table << "for" << cursor.symbol;
+  return historicalData;
+}
+
+// A MIN() over the clustered key is a single seek
+time_record_t DatabaseManager::firstStoredTimestamp(QSqlDatabase &connection, const QString &table, qint64 symbolId) {
+  QSqlQuery query(connection);
+  query.prepare(QString("SELECT MIN(timestamp) FROM %1 WHERE symbol_id = :symbol_id").arg(table));
+  query.bindValue(":symbol_id", symbolId);
+  if (!query.exec() || !query.next() || query.value(0).isNull()) {
+    return std::numeric_limits<time_record_t>::max();
+  }
+  return query.value(0).toLongLong();
+}
+
+QString DatabaseManager::resolutionTable(BarResolution resolution) {
+  switch (resolution) {
+    case BarResolution::FiveMinutes: return "historical_prices";
+    case BarResolution::Hourly:      return "historical_prices_hourly";
+    case BarResolution::Daily:       return "historical_prices_daily";
+    case BarResolution::Weekly:      return "historical_prices_weekly";
+  }
+  return "historical_prices";
+}
+
+// Keep leaves the stored row alone, Replace updates it only where a value changed so identical bars are not rewritten
+bool DatabaseManager::prepareBarInsert(QSqlQuery &query, const QString &table, BarConflict onConflict) {
+  const QString conflict = onConflict == BarConflict::Keep ? QString("DO NOTHING") : QString(R"(DO UPDATE SET
+            day_high = excluded.day_high,
+            day_low = excluded.day_low,
+            day_open = excluded.day_open,
+            day_close = excluded.day_close,
+            volume = excluded.volume
+        WHERE day_high IS NOT excluded.day_high OR day_low IS NOT excluded.day_low OR day_open IS NOT excluded.day_open
+            OR day_close IS NOT excluded.day_close OR volume IS NOT excluded.volume)");
+  return query.prepare(QString(R"(
+        INSERT INTO %1 (symbol_id, timestamp, day_high, day_low, day_open, day_close, volume)
+        VALUES (:symbol_id, :timestamp, :day_high, :day_low, :day_open, :day_close, :volume)
+        ON CONFLICT(symbol_id, timestamp) %2
+    )").arg(table, conflict));
+}
+
+bool DatabaseManager::insertBar(QSqlQuery &query, qint64 symbolId, const BarSeries &bars, qsizetype i) {
+  query.bindValue(":symbol_id", symbolId);
+  query.bindValue(":timestamp", bars.timestamp(i));
+  query.bindValue(":day_high", bars.highs().at(i));
+  query.bindValue(":day_low", bars.lows().at(i));
+  query.bindValue(":day_open", bars.opens().at(i));
+  query.bindValue(":day_close", bars.closes().at(i));
+  query.bindValue(":volume", bars.volumes().at(i));
+  return query.exec();
+}
+
+// Takes effect from the next pass, which is started right away
+void DatabaseManager::setRetentionPolicy(int rawDays, int hourlyDays) {
+  retention.rawDays    = qMax(0, rawDays);
+  retention.hourlyDays = qMax(0, hourlyDays);
+  qDebug() << "Retention: 5min bars for" << retention.rawDays << "days, hourly bars for" << retention.hourlyDays << "days (0 = forever)";
+  compactHistory();
+}
+
+// Queues every stock for compaction, the symbols are then done one per event loop pass so the storage thread keeps
+// answering reads and commits in between
+void DatabaseManager::compactHistory() {
+  if (!database.isOpen() || !compactionQueue.isEmpty() || (retention.rawDays == 0 && retention.hourlyDays == 0)) {
+    return;
+  }
+  QSqlQuery query(database);
+  if (!query.exec("SELECT symbol_id, symbol FROM stocks")) {
+    qWarning() << "Error listing stocks for compaction:" << query.lastError().text();
+    return;
+  }
+  while (query.next()) {
+    compactionQueue.append({ query.value(0).toLongLong(), query.value(1).toString() });
+  }
+  QTimer::singleShot(0, this, &DatabaseManager::compactNextSymbol);
+}
+
+void DatabaseManager::compactNextSymbol() {
+  if (compactionQueue.isEmpty() || !database.isOpen()) {
+    return;
+  }
+  auto [symbolId, symbol] = compactionQueue.takeFirst();
+  if (!compactSymbol(symbolId, symbol)) {
+    emit writeFailed(QString("Compaction of %1 failed").arg(symbol));
+  }
+  if (!compactionQueue.isEmpty()) {
+    QTimer::singleShot(0, this, &DatabaseManager::compactNextSymbol);
+  }
+}
+
+// Rolls 5min bars past their retention into hourly bars, and hourly bars past theirs into daily bars.
+// Cutoffs are aligned to the bucket so only complete hours and (Eastern) days are rolled up.
+bool DatabaseManager::compactSymbol(qint64 symbolId, const QString &symbol) {
+  flushPendingWrites();  // Queued bars of this symbol must be in place before older ones are pruned
+  const time_record_t now = QDateTime::currentSecsSinceEpoch();
+  if (retention.rawDays > 0) {
+    time_record_t cutoff = now - qint64(retention.rawDays) * SECONDS_PER_DAY;
+    cutoff              -= cutoff % SECONDS_PER_HOUR;
+    if (!rollUpTable(symbolId, symbol, "historical_prices", "historical_prices_hourly", cutoff, SECONDS_PER_HOUR)) {
+      return false;
+    }
+  }
+  if (retention.hourlyDays > 0) {
+    // Hourly bars only exist past the raw retention, a shorter hourly retention would skip a level. The cutoff is at 00:00
+    // Eastern, so a session is never split between the hourly and the daily table
+    time_record_t cutoff = easternWallClock(now - qint64(qMax(retention.hourlyDays, retention.rawDays)) * SECONDS_PER_DAY);
+    cutoff              -= cutoff % SECONDS_PER_DAY;
+    cutoff              += easternUtcOffset(cutoff);
+    if (!rollUpTable(symbolId, symbol, "historical_prices_hourly", "historical_prices_daily", cutoff, SECONDS_PER_DAY)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Moves the bars of source older than cutoff into target as bucketSecs rollups. A bucket already in target is kept
+// as it is (ON CONFLICT DO NOTHING): bars re-fetched after their bucket was rolled up are pruned, never counted twice.
+bool DatabaseManager::rollUpTable(qint64 symbolId, const QString &symbol, const QString &source, const QString &target,
+                                  time_record_t cutoff, qint64 bucketSecs) {
+  const bool fromBarStore = barStore && source == "historical_prices";  // Raw bars live in the segment then
+  HistoricalPriceCursor cursor;
+  cursor.symbol    = symbol;
+  cursor.to        = cutoff - 1;
+  cursor.pageSize  = -1;
+  cursor.direction = HistoricalPriceCursor::Forward;
+  BarSeries expired = fromBarStore ? readHistoricalPage(columnarView(symbol), cursor) : readTablePage(database, source, symbolId, cursor);
+  if (expired.isEmpty()) {
+    return true;
+  }
+  BarSeries rollups = rollUp(expired, bucketSecs);
+
+  if (!database.transaction()) {
+    qCritical() << "Error starting compaction transaction:" << database.lastError().text();
+    return false;
+  }
+  QSqlQuery query(database);
+  bool ok = prepareBarInsert(query, target, BarConflict::Keep);
+  for (qsizetype i = 0; ok && i < rollups.size(); ++i) {
+    ok = insertBar(query, symbolId, rollups, i);
+  }
+  if (ok && !fromBarStore) {
+    query.prepare(QString("DELETE FROM %1 WHERE symbol_id = :symbol_id AND timestamp < :cutoff").arg(source));
+    query.bindValue(":symbol_id", symbolId);
+    query.bindValue(":cutoff", cutoff);
+    ok = query.exec();
+  }
+  if (!ok) {
+    qCritical() << "Error compacting" << source << "of" << symbol << ":" << query.lastError().text();
+    database.rollback();
+    return false;
+  }
+  if (!database.commit()) {
+    qCritical() << "Error committing compaction of" << symbol << ":" << database.lastError().text();
+    database.rollback();
+    return false;
+  }
+  // The segment is pruned after the commit, if that fails the next pass rolls the same bars up again (and keeps the rollups)
+  if (fromBarStore && !barStore->removeBefore(symbol, cutoff)) {
+    return false;
+  }
+  qDebug() << "Rolled" << expired.size() << "bars of" << symbol << "from" << source << "into" << rollups.size() << "rows of" << target;
+  return true;
+}
+
+BarSeries DatabaseManager::rollUp(const BarSeries &bars, qint64 bucketSecs, qint64 originSecs, time_record_t intradayFrom) {
+  BarSeries rollups;
+  if (bars.isEmpty()) {
+    return rollups;
+  }
+  // One pass over the columns, a bucket is appended once its last bar was seen (bars are sorted)
+  const bool           easternDays = bucketSecs >= SECONDS_PER_DAY;
+  time_record_t        bucket      = 0;
+  HistoricalDataRecord rollup(0, 0, 0, 0, 0);
+  for (qsizetype i = 0; i < bars.size(); ++i) {
+    const time_record_t stamp     = bars.timestamp(i);
+    const time_record_t time      = easternDays && stamp >= intradayFrom ? easternWallClock(stamp) : stamp;
+    const qint64        offset    = (time - originSecs) % bucketSecs;
+    time_record_t       barBucket = time - offset;
+    if (offset < 0) {
+      barBucket -= bucketSecs;  // Round down before 1970 too
+    }
+    if (i == 0 || barBucket != bucket) {
+      if (i > 0) {
+        rollups.append(bucket, rollup);
+      }
+      bucket = barBucket;
+      rollup = bars.record(i);  // The first bar of a bucket has its open
+      continue;
+    }
+    rollup.high    = qMax(rollup.high, bars.highs().at(i));
+    rollup.low     = qMin(rollup.low, bars.lows().at(i));
+    rollup.close   = bars.closes().at(i);
+    rollup.volume += bars.volumes().at(i);
+  }
+  rollups.append(bucket, rollup);
+  return rollups;
+}
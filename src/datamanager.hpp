@@ -4,41 +4,228 @@
 #include <QDate>
 #include <QDateTime>
 #include <QDebug>
+#include <QHash>
 #include <QList>
-#include <QMap>
 #include <QObject>
+#include <QScopedPointer>
 #include <QSqlDatabase>  // Core SQL functionality
 #include <QSqlError>     // For database error handling
 #include <QSqlQuery>     // For executing SQL statements
+#include <QTimer>
+#include <limits>
 
-#include "stock.hpp"  // Our Stock data model
+#include "barresolution.hpp"     // Bar sizes of the stored history
+#include "columnarbarstore.hpp"  // Optional memory-mapped backend for historical prices
+#include "corporateactions.hpp"  // Split and dividend adjustment of stored bars
+#include "stock.hpp"             // Our Stock data model
 
+// Outcome of merging a batch of historical prices into the database
+struct HistoricalMergeResult {
+    qsizetype inserted {};   // Timestamps that were not stored yet
+    qsizetype updated {};    // Timestamps whose values changed
+    qsizetype unchanged {};  // Timestamps already stored with identical values
+};
+
+// Keyset cursor over the stored bars of one symbol, advanced by DatabaseManager::fetchHistoricalPage.
+// It holds the next boundary timestamp and a few values read once (implicitly shared), it keeps no SQL state between pages.
+struct HistoricalPriceCursor {
+    enum Direction {
+      Forward,  // Oldest bars first
+      Backward  // Newest bars first, what the chart wants when it opens
+    };
+    QString       symbol;
+    time_record_t from { std::numeric_limits<time_record_t>::min() };  // Inclusive, moves up when going Forward
+    time_record_t to { std::numeric_limits<time_record_t>::max() };    // Inclusive, moves down when going Backward
+    qsizetype     pageSize { 2000 };
+    Direction     direction { Backward };
+    bool          exhausted { false };  // No more rows in [from, to]
+    quint32       quality {};           // BarQualityReport flags of the pages read so far
+    bool          adjusted { true };    // Adjust the pages for the stored splits and dividends
+    // Read by the first page and reused by the later ones, which would otherwise seek every table and re-read the actions
+    // each time. All pages of a cursor are adjusted alike; bars and actions stored since (compaction, imports) are seen by the
+    // next cursor, which the chart starts whenever it reloads a stock
+    bool                 layoutRead { false };
+    QList<time_record_t> firstStored;  // First stored bar of each table, by BarResolution, max() if none
+    AdjustmentSchedule   adjustments;  // Splits and dividends of the symbol, if adjusted
+};
+
+// How long each resolution is kept before the compaction job rolls it up into the next coarser one
+struct RetentionPolicy {
+    int rawDays {};     // 5min bars older than this become hourly bars, 0 keeps them forever
+    int hourlyDays {};  // Hourly bars older than this become daily bars, 0 keeps them forever
+};
+
+// Lives in its own storage thread (see MainWindow). All methods must be invoked through the event loop
+// (QMetaObject::invokeMethod), never called directly from another thread.
+// Writes are queued and group-committed: everything queued within COMMIT_WINDOW_MS goes into one transaction.
+// Historical prices live in SQLite unless a bar store path is given, then they go to a ColumnarBarStore (stocks stay in SQLite).
+// Bars past the retention policy are rolled up into historical_prices_hourly and _daily, reads stitch all three together.
+// Daily and weekly bars can also be fetched (historical_prices_daily, _weekly); they reach back much further than the finer
+// ones, which win where both exist. loadHistoricalRange() reads a range in the resolution that fits the chart instead.
 class DatabaseManager : public QObject {
     Q_OBJECT
 
   public:
-    explicit DatabaseManager(const QString &databasePath, QObject *parent = nullptr);
+    explicit DatabaseManager(const QString &databasePath, const QString &barStorePath = QString(), QObject *parent = nullptr);
     ~DatabaseManager();
 
-    bool openDatabase();
+  public slots:
+    bool openDatabase();  // Must run in the storage thread, it creates the thread's own connection
     void closeDatabase();
+    // openDatabase and loadAllStocks for the GUI thread, which must not wait on a migration: the result comes by databaseOpened
+    void requestOpenDatabase();
+
+    // Write queue (non-blocking for the caller, coalesced per symbol until the next group commit)
+    void queueStockUpdate(const Stock &stock);
+    void queueHistoricalPrices(const QString &symbol, const BarSeries &historicalData);
+    bool flushPendingWrites();  // Commits everything queued so far in a single transaction
+
+    // Retention (compaction runs in the background every COMPACTION_INTERVAL_MS, one symbol per event loop pass)
+    void setRetentionPolicy(int rawDays, int hourlyDays);
+    void compactHistory();  // Starts a compaction pass over all stocks now
 
     // CRUD operations for stocks
-    bool         addOrUpdateStock(const Stock &stock);  // Adds or updates stock info
-    QList<Stock> loadAllStocks();                       // Loads all stock info (without historical prices)
-    Stock        loadStock(const QString &symbol);      // Loads a single stock
+    bool         addOrUpdateStock(const Stock &stock);          // Adds or updates stock info
+    bool         addOrUpdateStocks(const QList<Stock> &stocks);  // Same for a batch, one transaction
+    QList<Stock> loadAllStocks();                               // Loads all stock info (without historical prices)
+    Stock        loadStock(const QString &symbol);              // Loads a single stock
     bool         deleteStock(const QString &symbol);
+    // deleteStock for the GUI thread, the result comes by stockDeleted
+    void requestDeleteStock(const QString &symbol);
 
     // Operations for historical prices
-    bool updateHistoricalPrices(const QString &symbol, const QMap<time_record_t, HistoricalDataRecord> &historicalData);
-    QMap<time_record_t, HistoricalDataRecord> loadHistoricalPrices(const QString &symbol);
+    // Merges the given prices into the stored history (upsert per timestamp, older rows are kept)
+    bool updateHistoricalPrices(const QString &symbol, const BarSeries &historicalData, HistoricalMergeResult *result = nullptr);
+    // Bulk import of many symbols in one transaction, stock rows are created for symbols not stored yet
+    bool      importHistoricalPrices(const QHash<QString, BarSeries> &historicalData, HistoricalMergeResult *result = nullptr);
+    BarSeries loadHistoricalPrices(const QString &symbol);
+    // Bars with from <= timestamp <= to, capped to the newest maxRows if maxRows >= 0
+    BarSeries loadHistoricalPrices(const QString &symbol, time_record_t from, time_record_t to, qsizetype maxRows = -1);
+    // Next page of the cursor (empty once exhausted), the cursor is advanced past the returned bars
+    BarSeries fetchHistoricalPage(HistoricalPriceCursor &cursor);
+    // Same for the GUI thread, which must not wait on the storage thread: the page comes by historicalPageLoaded
+    void      requestHistoricalPage(const HistoricalPriceCursor &cursor);
+    // Zero-copy view of [from, to] when the columnar store is enabled (empty otherwise), valid in any thread
+    BarColumnsView loadHistoricalView(const QString &symbol, time_record_t from, time_record_t to);
+    bool           hasColumnarStore() const { return !barStore.isNull(); }
+
+    // Resolution-aware history. Bars of another resolution than 5min go to their own table (upsert per timestamp)
+    bool storeHistoricalPrices(const QString &symbol, const BarSeries &historicalData, BarResolution resolution,
+                               HistoricalMergeResult *result = nullptr);
+    // [from, to] in the given resolution: its own table first, finer bars rolled up where it has none, coarser bars
+    // where nothing finer is stored. Adjusted, sorted, one bar per bucket
+    BarSeries loadHistoricalPrices(const QString &symbol, time_record_t from, time_record_t to, BarResolution resolution);
+    // Same in the resolution resolutionFor() picks for maxBars (the chart's width in pixels), which is stored in resolution
+    BarSeries loadHistoricalRange(const QString &symbol, time_record_t from, time_record_t to, qsizetype maxBars,
+                                  BarResolution *resolution = nullptr);
+    // Same for the GUI thread, the bars come by historicalRangeLoaded
+    void      requestHistoricalRange(const QString &symbol, time_record_t from, time_record_t to, qsizetype maxBars);
+
+    // Splits and dividends (corporate_actions). Stored bars stay as traded, pages are adjusted when they are read
+    bool importCorporateActions(const QHash<QString, QList<CorporateAction>> &actions);  // One transaction, upsert per action
+    bool resolveDividendFactors();  // Fills in dividend factors whose previous close was not stored yet at import
+    // Adjusts bars that did not come from a page (e.g. freshly fetched ones) the same way pages are
+    BarSeries adjustHistoricalPrices(const QString &symbol, const BarSeries &historicalData);
+    // Same for the GUI thread, the adjusted bars come by adjustedPricesReady
+    void      requestAdjustedPrices(const QString &symbol, const BarSeries &historicalData);
+
+    // Page readers shared with the bulk loader, they only touch the given connection or view.
+    // The first stitches raw bars (from rawBars if given, else the table) with the hourly and daily rollups.
+    static BarSeries readHistoricalPage(QSqlDatabase &connection, qint64 symbolId, HistoricalPriceCursor &cursor,
+                                        const BarColumnsView *rawBars = nullptr);
+    static BarSeries readHistoricalPage(const BarColumnsView &bars, HistoricalPriceCursor &cursor);
+    static AdjustmentSchedule readAdjustmentSchedule(QSqlDatabase &connection, qint64 symbolId);  // Identity on error
+    // Aggregates sorted bars into buckets of bucketSecs starting at originSecs: first open, max high, min low, last close,
+    // summed volume
+    // Buckets of a day and longer go by the US/Eastern date of the intraday bars and are stamped at 00:00 UTC of it, like
+    // fetched daily and weekly bars: the extended session runs until 20:00 Eastern, past midnight UTC in the winter. Bars
+    // before intradayFrom are daily or weekly rows, which are stamped with their date already
+    static BarSeries rollUp(const BarSeries &bars, qint64 bucketSecs, qint64 originSecs = 0,
+                            time_record_t intradayFrom = std::numeric_limits<time_record_t>::min());
+
+  signals:
+    void databaseOpened(bool opened, bool columnarStore, const QList<Stock> &stocks);
+    void writeFailed(const QString &error);  // A queued write could not be committed
+    void statisticsUpdated(const QString &symbol, const StockStatistics &statistics);  // After new bars were merged
+    void historicalPageLoaded(const HistoricalPriceCursor &cursor, const BarSeries &historicalData);  // Cursor past the page
+    void stockDeleted(const QString &symbol, bool deleted);
+    void adjustedPricesReady(const QString &symbol, const BarSeries &adjusted);
+    void historicalRangeLoaded(const QString &symbol, time_record_t from, time_record_t to, qsizetype maxBars, BarResolution resolution,
+                               const BarSeries &historicalData);
 
   private:
     QSqlDatabase database;
     QString      databasePath;
+    QString      connectionName;
+    QString      barStorePath;
+
+    QScopedPointer<ColumnarBarStore> barStore;               // Set when the columnar backend is enabled
+    QSqlQuery                        upsertStockQuery;       // Prepared once in prepareStatements(), rebound per row
+    QSqlQuery                        upsertHistoricalQuery;  // Same, for historical prices
+
+    QHash<QString, qint64>         symbolIds;   // Cache of stocks.symbol_id, the key of historical_prices
+    QHash<qint64, StockStatistics> statistics;  // Cache of stocks.statistics, by symbol_id, loaded on first use
+    const static int               SCHEMA_VERSION { 7 };
+    bool                           migratedToV7 { false };  // Set by migrateSchemaToV7(), finishMigrationToV7() runs once all is open
+
+    QTimer                   *commitTimer;
+    QHash<QString, Stock>     pendingStocks;            // Latest queued state per symbol
+    QHash<QString, BarSeries> pendingHistoricalPrices;  // Queued bars per symbol
+    const static int          COMMIT_WINDOW_MS { 250 };
+
+    RetentionPolicy               retention;
+    QTimer                       *compactionTimer;
+    QList<QPair<qint64, QString>> compactionQueue;  // (symbol_id, symbol) still to compact in this pass
+    const static int              COMPACTION_INTERVAL_MS { 60 * 60 * 1000 };
+    const static qint64           SECONDS_PER_HOUR { 60 * 60 };
+    const static qint64           SECONDS_PER_DAY { 24 * 60 * 60 };  // Buckets are US/Eastern trading dates, see rollUp
+
+    bool      createTables();                                      // Helper to create tables if they don't exist
+    bool      migrateSchemaV1ToV2();                               // Moves v1 databases to integer symbol ids
+    bool      migrateSchemaToV7();                                 // Re-keys intraday bars stored in local time to US/Eastern
+    bool      prepareStatements();                                 // Helper to prepare the reused write statements
+    qint64    lookupSymbolId(const QString &symbol, bool create);  // Helper to map a symbol to stocks.symbol_id
+    // Helper to count the stored bars of a stock in one of the historical price tables, within [from, to]
+    qsizetype countHistoricalPrices(qint64 symbolId, const QString &table = "historical_prices",
+                                    time_record_t from = std::numeric_limits<time_record_t>::min(),
+                                    time_record_t to   = std::numeric_limits<time_record_t>::max());
+    void      scheduleCommit();
+    void      requeueWrites(const QHash<QString, Stock> &stocks, const QHash<QString, BarSeries> &historical);
+
+    // Schema version 7 helpers: the tables in the migration's transaction, the bar store and the statistics once it is open
+    bool             rekeyIntradayTable(const QString &table, qint64 bucketSecs);
+    void             finishMigrationToV7();
+    static BarSeries rekeyLocalToEastern(const BarSeries &bars, qint64 bucketSecs, bool &moved);
+
+    // Statement-level helpers, the caller owns the transaction
+    bool   writeStock(const Stock &stock);
+    bool   mergeHistoricalPrices(const QString &symbol, const BarSeries &historicalData, HistoricalMergeResult &result);
+    bool   mergeHistoricalPricesSql(const QString &symbol, const BarSeries &historicalData, HistoricalMergeResult &result);
+    bool   writeCorporateAction(qint64 symbolId, const QString &symbol, CorporateAction action);  // Resolves a dividend factor if it can
+    double previousClose(const QString &symbol, time_record_t time);  // Unadjusted close of the last bar before time, 0 if none
+
+    // Folds the stored bars from the open day on into the symbol's statistics, or replays all of them when rebuild is set
+    bool             updateStatistics(qint64 symbolId, const QString &symbol, bool rebuild);
+    StockStatistics &statisticsOf(qint64 symbolId);  // From the cache, or the stocks row on first use
+
+    BarSeries            fetchHistoricalPageSql(HistoricalPriceCursor &cursor);
+    BarSeries            fetchHistoricalPageColumnar(HistoricalPriceCursor &cursor);
+    BarColumnsView       columnarView(const QString &symbol);  // Moves SQLite rows over on first use
+    static BarSeries     readTablePage(QSqlDatabase &connection, const QString &table, qint64 symbolId, HistoricalPriceCursor &cursor);
+    static time_record_t firstStoredTimestamp(QSqlDatabase &connection, const QString &table, qint64 symbolId);  // max() if none
+    static QString       resolutionTable(BarResolution resolution);
+
+    // The one bar INSERT of all the historical price tables. A row already stored at the bar's (symbol_id, timestamp) is
+    // kept as it is, or overwritten where its values differ (numRowsAffected() is 0 then if they do not)
+    enum class BarConflict { Keep, Replace };
+    static bool prepareBarInsert(QSqlQuery &query, const QString &table, BarConflict onConflict);
+    static bool insertBar(QSqlQuery &query, qint64 symbolId, const BarSeries &bars, qsizetype i);  // Binds bar i and runs it
 
-    bool createTables();                      // Helper to create tables if they don't exist
-    bool stockExists(const QString &symbol);  // Helper to check if a stock is already in DB
+    // Compaction helpers
+    void compactNextSymbol();
+    bool compactSymbol(qint64 symbolId, const QString &symbol);
+    bool rollUpTable(qint64 symbolId, const QString &symbol, const QString &source, const QString &target, time_record_t cutoff,
+                     qint64 bucketSecs);
 };
 
-#endif
\ No newline at end of file
+#endif
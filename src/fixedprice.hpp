@@ -0,0 +1,79 @@
+#ifndef _FIXED_PRICE_HEADER_
+#define _FIXED_PRICE_HEADER_
+
+#include <QVariant>
+#include <QtGlobal>
+#include <cmath>
+#include <type_traits>
+
+constexpr qint64 PRICE_TICKS_PER_UNIT { 10000 };  // 1e-4, Alpha Vantage and most vendors quote at most 4 decimals
+
+// Price stored as an integer count of ticks. Used as price_t when STOCKTRACKER_FIXED_POINT_PRICES is defined.
+// It converts implicitly to and from double so the UI and chart code reads it like before; converting from a double
+// rounds to the nearest tick. Between two FixedPrices, equality and ordering compare the ticks exactly.
+// Bound to SQL as a REAL, so the database format does not depend on the build option.
+class FixedPrice {
+  public:
+    constexpr FixedPrice() = default;
+    FixedPrice(double value): tickCount(std::llround(value * PRICE_TICKS_PER_UNIT)) { }
+
+    static constexpr FixedPrice fromTicks(qint64 ticks) {
+      FixedPrice price;
+      price.tickCount = ticks;
+      return price;
+    }
+    constexpr qint64 ticks() const { return tickCount; }
+    constexpr double toDouble() const { return double(tickCount) / PRICE_TICKS_PER_UNIT; }
+    constexpr operator double() const { return toDouble(); }
+    operator QVariant() const { return QVariant(toDouble()); }
+
+    friend constexpr bool operator==(FixedPrice a, FixedPrice b) { return a.tickCount == b.tickCount; }
+    friend constexpr bool operator!=(FixedPrice a, FixedPrice b) { return a.tickCount != b.tickCount; }
+    friend constexpr bool operator<(FixedPrice a, FixedPrice b) { return a.tickCount < b.tickCount; }
+    friend constexpr bool operator<=(FixedPrice a, FixedPrice b) { return a.tickCount <= b.tickCount; }
+    friend constexpr bool operator>(FixedPrice a, FixedPrice b) { return a.tickCount > b.tickCount; }
+    friend constexpr bool operator>=(FixedPrice a, FixedPrice b) { return a.tickCount >= b.tickCount; }
+    // Against plain numbers the comparison is done in double. Templates, so "price > 0" matches them exactly instead of
+    // being ambiguous with the built-in double comparison
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator==(FixedPrice a, T b) {
+      return a.toDouble() == double(b);
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator!=(FixedPrice a, T b) {
+      return a.toDouble() != double(b);
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator<(FixedPrice a, T b) {
+      return a.toDouble() < double(b);
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator<=(FixedPrice a, T b) {
+      return a.toDouble() <= double(b);
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator>(FixedPrice a, T b) {
+      return a.toDouble() > double(b);
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator>=(FixedPrice a, T b) {
+      return a.toDouble() >= double(b);
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator==(T a, FixedPrice b) {
+      return b == a;
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator!=(T a, FixedPrice b) {
+      return b != a;
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator<(T a, FixedPrice b) {
+      return b > a;
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator<=(T a, FixedPrice b) {
+      return b >= a;
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator>(T a, FixedPrice b) {
+      return b < a;
+    }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>> friend constexpr bool operator>=(T a, FixedPrice b) {
+      return b <= a;
+    }
+
+  private:
+    qint64 tickCount {};
+};
+
+#endif
@@ -1,9 +1,15 @@
 #ifndef _GLOBAL_HEADER_STOCKTRACKER_
 #define _GLOBAL_HEADER_STOCKTRACKER_
 
+#include "fixedprice.hpp"
+
 using time_record_t = qint64;
+#ifdef STOCKTRACKER_FIXED_POINT_PRICES
+using price_t       = FixedPrice;  // Integer ticks, see fixedprice.hpp
+#else
 using price_t       = double;
+#endif
 using percentage_t  = double;
 using volume_t      = long long;
 
-#endif
\ No newline at end of file
+#endif
@@ -12,8 +12,8 @@ HeatmapPainter::~HeatmapPainter() {
   qDebug() << "HeatmapPainter destroyed.";
 }
 
-void HeatmapPainter::setStocks(const QList<Stock> &stocks) {
-  stocklist_copy = stocks;
+void HeatmapPainter::setStocks(const QList<HeatmapEntry> &stocks) {
+  entries = stocks;
   update();
 }
 void HeatmapPainter::resizeEvent(QResizeEvent *event) {
@@ -31,22 +31,22 @@ void HeatmapPainter::paintEvent(QPaintEvent *event) {
   QRectF bounds = rect();  // rect() gives the widget's internal rectangle
   qreal  area { bounds.height() * bounds.width() };
 
-  if (stocklist_copy.isEmpty()) {
+  if (entries.isEmpty()) {
     painter.drawText(bounds, Qt::AlignCenter, "No stocks to display in heatmap.");
     return;
-  } else if (area < stocklist_copy.size() * min_area) {
+  } else if (area < entries.size() * min_area) {
     painter.drawText(bounds, Qt::AlignCenter, "Not enough space for heatmap.");
     return;
   }
 
   // Prepare data for tiling: calculate 'value' and sort
   QList<HeatmapRectData> heatmapData;
-  price_t                totalValue = 0;
-  for (const Stock &stock : stocklist_copy) {
+  qreal                  totalValue = 0;
+  for (const HeatmapEntry &stock : entries) {
     HeatmapRectData data;
     data.stock = &stock;
     // Calculate total price as currentPrice * volume
-    data.ordinal = stock.getCurrentPrice();
+    data.ordinal = stock.price;
     if (data.ordinal < 0) {
       data.ordinal = 0;  // Ensure non-negative size
     }
@@ -259,7 +259,7 @@ QRectF HeatmapPainter::makeSplit(const QRectF &remaining, const HeatmapRectData
 
 void HeatmapPainter::drawStrip(QPainter *painter, const QList<HeatmapRectData> &strip) {
   for (const HeatmapRectData &square : strip) {
-    QColor fillColor = getColorForChange(square.stock->getPriceChange());
+    QColor fillColor = getColorForChange(square.stock->change);
     painter->fillRect(square.rect, fillColor);
     painter->setPen(Qt::black);
     painter->drawRect(square.rect);  // Draw border
@@ -271,7 +271,7 @@ void HeatmapPainter::drawStrip(QPainter *painter, const QList<HeatmapRectData> &
     painter->setFont(font);
 
     // Draw symbol and price
-    QString text = square.stock->getSymbol() + "\n" + QString("$%1").arg(square.stock->getCurrentPrice(), 0, 'f', 2);
+    QString text = square.stock->symbol + "\n" + QString("$%1").arg(double(square.stock->price), 0, 'f', 2);
     // qDebug() << text;
     painter->drawText(square.rect.adjusted(2, 2, -2, -2), Qt::AlignCenter | Qt::TextWordWrap, text);
   }
@@ -11,18 +11,26 @@
 #include <QRectF>       // For floating point rectangles
 #include <QWidget>
 
+// What a heatmap tile shows of a stock, a few values instead of a Stock copy
+struct HeatmapEntry {
+    SymbolId id { INVALID_SYMBOL_ID };
+    QString  symbol;
+    price_t  price {};
+    price_t  change {};
+};
+
 class HeatmapPainter : public QWidget {
     Q_OBJECT
 
   private:
-    const qreal  min_area { 2e1 };
-    QList<Stock> stocklist_copy;  // Data to display
+    const qreal         min_area { 2e1 };
+    QList<HeatmapEntry> entries;  // Data to display, sorted by symbol
     // Helper struct to hold stock data relevant for drawing a rectangle
 
     struct HeatmapRectData {
-        const Stock *stock;
-        price_t      ordinal;
-        QRectF       rect;  // The rectangle where this stock will be drawn
+        const HeatmapEntry *stock;
+        qreal               ordinal;  // Tile area, starts out as the price
+        QRectF              rect;     // The rectangle where this stock will be drawn
     };
 
     // Recursive function for simplified tiling
@@ -45,7 +53,7 @@ class HeatmapPainter : public QWidget {
 
   public slots:
     // Slot to update the data displayed on the heatmap
-    void setStocks(const QList<Stock> &stocks);
+    void setStocks(const QList<HeatmapEntry> &stocks);
 
   protected:
     // Override paintEvent for custom drawing
@@ -0,0 +1,103 @@
+#include "historybulkloader.hpp"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+
+HistoryBulkLoader::HistoryBulkLoader(const QString &databasePath, const QString &barStorePath, QObject *parent):
+    QObject(parent), databasePath(databasePath), barStorePath(barStorePath) {
+  pool.setMaxThreadCount(QThread::idealThreadCount());  // SQLite readers and page faults both scale with cores
+}
+
+HistoryBulkLoader::~HistoryBulkLoader() {
+  cancel();
+  pool.waitForDone();  // Running tasks still use this object
+}
+
+HistoryBulkLoader::ReaderConnection::~ReaderConnection() {
+  QSqlDatabase::removeDatabase(connectionName);  // Runs in the pool thread that owned it, as it exits
+}
+
+// Queues one task per symbol, each delivers its page as soon as it is read
+void HistoryBulkLoader::load(const QStringList &symbols, qsizetype pageSize) {
+  const int taskGeneration  = generation.loadRelaxed();
+  remaining                += symbols.size();
+  total                    += symbols.size();
+  for (const QString &symbol : symbols) {
+    pool.start([this, taskGeneration, symbol, pageSize]() {
+      if (generation.loadRelaxed() != taskGeneration) {
+        return;  // Cancelled while queued
+      }
+      HistoricalPriceCursor cursor;
+      cursor.symbol            = symbol;
+      cursor.pageSize          = pageSize;
+      BarSeries historicalData = readNewestPage(cursor);
+      // Back to the loader's thread, dropped by Qt if the loader is gone by then
+      QMetaObject::invokeMethod(
+        this, [this, taskGeneration, symbol, historicalData, cursor]() { deliver(taskGeneration, symbol, historicalData, cursor); },
+        Qt::QueuedConnection);
+    });
+  }
+  qDebug() << "Bulk loading stored history of" << symbols.size() << "symbols on" << pool.maxThreadCount() << "threads";
+}
+
+void HistoryBulkLoader::cancel() {
+  generation.fetchAndAddRelaxed(1);
+  pool.clear();
+  remaining = 0;
+  total     = 0;
+}
+
+// Each pool thread keeps one read-only connection for all the symbols it loads
+QSqlDatabase HistoryBulkLoader::readerConnection() {
+  if (readers.hasLocalData()) {
+    return QSqlDatabase::database(readers.localData()->connectionName);
+  }
+  ReaderConnection *reader = new ReaderConnection;
+  reader->connectionName   = QString("stocktracker_reader_%1").arg(quintptr(QThread::currentThread()), 0, 16);
+  readers.setLocalData(reader);
+  QSqlDatabase connection = QSqlDatabase::addDatabase("QSQLITE", reader->connectionName);
+  connection.setDatabaseName(databasePath);
+  connection.setConnectOptions("QSQLITE_OPEN_READONLY");
+  if (!connection.open()) {
+    qWarning() << "Error opening a history reader connection:" << connection.lastError().text();
+  }
+  return connection;
+}
+
+// Runs in a pool thread
+BarSeries HistoryBulkLoader::readNewestPage(HistoricalPriceCursor &cursor) {
+  QSqlDatabase connection = readerConnection();
+  QSqlQuery    query(connection);
+  query.prepare("SELECT symbol_id FROM stocks WHERE symbol = :symbol");
+  query.bindValue(":symbol", cursor.symbol);
+  qint64 symbolId = -1;
+  if (!query.exec()) {
+    qWarning() << "Error looking up" << cursor.symbol << ":" << query.lastError().text();
+  } else if (query.next()) {
+    symbolId = query.value(0).toLongLong();
+  }
+  if (!barStorePath.isEmpty()) {
+    ColumnarBarStore store(barStorePath);  // Only maps files, nothing is shared with the storage thread's store
+    if (store.contains(cursor.symbol)) {
+      BarColumnsView rawBars = store.view(cursor.symbol);
+      return DatabaseManager::readHistoricalPage(connection, symbolId, cursor, &rawBars);
+    }
+    // Segments are created on first access, until then the bars are still in SQLite
+  }
+  return DatabaseManager::readHistoricalPage(connection, symbolId, cursor);
+}
+
+void HistoryBulkLoader::deliver(int taskGeneration, const QString &symbol, const BarSeries &historicalData,
+                                const HistoricalPriceCursor &cursor) {
+  if (taskGeneration != generation.loadRelaxed()) {
+    return;  // Loaded before a cancel()
+  }
+  --remaining;
+  emit historyLoaded(symbol, historicalData, cursor);
+  emit progress(total - remaining, total);
+  if (remaining == 0) {
+    total = 0;
+    emit finished();
+  }
+}
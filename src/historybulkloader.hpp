@@ -0,0 +1,56 @@
+#ifndef _HISTORY_BULK_LOADER_HEADER_
+#define _HISTORY_BULK_LOADER_HEADER_
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QThreadStorage>
+
+#include "datamanager.hpp"
+
+// Loads the newest page of stored history for many symbols at once, one symbol per task on a thread pool.
+// Every pool thread reads through its own read-only SQLite connection (WAL lets them run next to the storage
+// thread's writer), or maps the symbol's segment directly when the columnar store is used.
+// Results are delivered one symbol at a time in the loader's thread, in completion order.
+// Pending writes are not visible to the workers, flush the DatabaseManager before calling load().
+class HistoryBulkLoader : public QObject {
+    Q_OBJECT
+
+  public:
+    HistoryBulkLoader(const QString &databasePath, const QString &barStorePath, QObject *parent = nullptr);
+    ~HistoryBulkLoader();
+
+    void load(const QStringList &symbols, qsizetype pageSize);
+    void cancel();  // Drops the tasks that did not start yet, nothing more is delivered
+    bool isLoading() const { return remaining > 0; }
+
+  signals:
+    void historyLoaded(const QString &symbol, const BarSeries &historicalData,
+                       const HistoricalPriceCursor &cursor);  // cursor continues with the older pages
+    void progress(int loaded, int total);
+    void finished();
+
+  private:
+    // Closes the pool thread's connection when the thread exits
+    struct ReaderConnection {
+        QString connectionName;
+        ~ReaderConnection();
+    };
+
+    QString                            databasePath;
+    QString                            barStorePath;
+    QThreadStorage<ReaderConnection *> readers;     // Declared before the pool, its threads must exit first
+    QThreadPool                        pool;        // Own pool, cancelling and waiting leave the global one alone
+    QAtomicInt                         generation;  // Bumped by cancel(), tasks of an older generation return without reading
+    int                                remaining {};
+    int                                total {};
+
+    QSqlDatabase readerConnection();  // The calling pool thread's connection, opened on first use
+    BarSeries    readNewestPage(HistoricalPriceCursor &cursor);
+    void deliver(int taskGeneration, const QString &symbol, const BarSeries &historicalData, const HistoricalPriceCursor &cursor);
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "historycache.hpp"
+#include <QDebug>
+
+HistoryCache::HistoryCache(qint64 budgetBytes): budgetBytes(budgetBytes) { }
+
+qint64 HistoryCache::decodedBytes(qsizetype bars) {
+  return qint64(bars) * qint64(sizeof(time_record_t) + 4 * sizeof(price_t) + sizeof(volume_t));
+}
+
+void HistoryCache::setBudget(qint64 bytes) {
+  budgetBytes = qMax(qint64(0), bytes);
+  evict();
+}
+
+void HistoryCache::insert(SymbolId id, const BarSeries &bars) {
+  if (bars.isEmpty()) {
+    return;
+  }
+  auto entry = entries.find(id);
+  if (entry == entries.end()) {
+    entry         = entries.insert(id, Entry());
+    entry->recent = recency.insert(recency.end(), id);
+  } else {
+    recency.splice(recency.end(), recency, entry->recent);  // Most recent now, the iterator stays valid
+  }
+  evicted.remove(id);
+  entry->series.insert(bars);
+  encodedBytes -= entry->bytes;
+  entry->bytes  = entry->series.encodedBytes();
+  encodedBytes += entry->bytes;
+  evict();
+}
+
+void HistoryCache::remove(SymbolId id) {
+  auto entry = entries.find(id);
+  if (entry != entries.end()) {
+    encodedBytes -= entry->bytes;
+    recency.erase(entry->recent);
+    entries.erase(entry);
+  }
+  pinnedBytes -= pinned.take(id);
+  evicted.remove(id);
+}
+
+BarSeries HistoryCache::pin(SymbolId id) {
+  BarSeries bars;
+  auto      entry = entries.find(id);
+  if (entry != entries.end()) {
+    bars          = entry->series.toSeries();
+    encodedBytes -= entry->bytes;
+    recency.erase(entry->recent);
+    entries.erase(entry);
+  }
+  updatePinned(id, bars.size());
+  return bars;
+}
+
+void HistoryCache::updatePinned(SymbolId id, qsizetype bars) {
+  qint64 &bytes = pinned[id];
+  pinnedBytes  += decodedBytes(bars) - bytes;
+  bytes         = decodedBytes(bars);
+  evict();
+}
+
+void HistoryCache::unpin(SymbolId id, const BarSeries &bars) {
+  pinnedBytes -= pinned.take(id);
+  insert(id, bars);
+}
+
+// Drops least recently used entries until the budget holds again, or only pinned stocks are left
+void HistoryCache::evict() {
+  while (usedBytes() > budgetBytes && !recency.empty()) {
+    const SymbolId id    = recency.front();
+    auto           entry = entries.find(id);
+    qDebug() << "History cache over budget, dropping" << entry->series.size() << "bars of" << SymbolTable::instance().symbol(id);
+    encodedBytes -= entry->bytes;
+    recency.pop_front();
+    entries.erase(entry);
+    evicted.insert(id);
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef _HISTORY_CACHE_HEADER_
+#define _HISTORY_CACHE_HEADER_
+
+#include <QHash>
+#include <QSet>
+#include <list>
+
+#include "barcodec.hpp"
+#include "symboltable.hpp"
+
+// Loaded price histories of the tracked stocks, compressed and bounded by a memory budget.
+// When the encoded entries plus the decoded bars of the pinned stocks go over the budget, the least recently used
+// entries are dropped. Nothing is lost, every bar is in the database: wasEvicted() tells the owner to reload a dropped
+// history from storage the next time it is needed.
+// Pinned stocks (the one on the chart) have their bars decoded in their Stock instead, they count against the budget
+// but are never dropped. Not thread-safe, owned by the MainWindow.
+class HistoryCache {
+  public:
+    explicit HistoryCache(qint64 budgetBytes = DEFAULT_BUDGET_BYTES);
+
+    qint64 budget() const { return budgetBytes; }
+    qint64 usedBytes() const { return encodedBytes + pinnedBytes; }
+    void   setBudget(qint64 bytes);  // Evicts right away when shrinking
+
+    bool contains(SymbolId id) const { return entries.contains(id); }
+    bool wasEvicted(SymbolId id) const { return evicted.contains(id); }  // Dropped for the budget, reload it from storage
+    void insert(SymbolId id, const BarSeries &bars);                     // Merged into the entry, which becomes the most recent
+    void remove(SymbolId id);                                            // The stock is no longer tracked
+
+    BarSeries pin(SymbolId id);                           // Takes the entry out decoded, empty on a miss
+    void      updatePinned(SymbolId id, qsizetype bars);  // The pinned stock gained bars (newer fetch, older pages)
+    void      unpin(SymbolId id, const BarSeries &bars);  // Compresses them back in as the most recent entry
+    bool      isPinned(SymbolId id) const { return pinned.contains(id); }
+
+    static constexpr qint64 DEFAULT_BUDGET_BYTES { 256LL * 1024 * 1024 };
+
+  private:
+    struct Entry {
+        CompressedBarSeries           series;
+        qint64                        bytes {};
+        std::list<SymbolId>::iterator recent;  // Position in recency
+    };
+    QHash<SymbolId, Entry>  entries;
+    std::list<SymbolId>     recency;  // Least recently used first
+    QHash<SymbolId, qint64> pinned;   // Decoded bytes of each pinned stock
+    QSet<SymbolId>          evicted;
+    qint64                  budgetBytes;
+    qint64                  encodedBytes {};
+    qint64                  pinnedBytes {};
+
+    void          evict();
+    static qint64 decodedBytes(qsizetype bars);
+};
+
+#endif
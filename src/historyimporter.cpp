@@ -0,0 +1,515 @@
+#include "historyimporter.hpp"
+#include "priceparser.hpp"
+#include "timeseriesparser.hpp"
+#include "timestampparser.hpp"
+#include <QDebug>
+#include <QFileInfo>
+#include <QSemaphore>
+#include <QSet>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+  using BarRows = std::vector<std::pair<time_record_t, HistoricalDataRecord>>;
+
+  // Sorts rows by timestamp unless they already are (the usual case) and appends them, a later duplicate wins
+  void appendSorted(BarRows &rows, BarSeries &bars) {
+    auto byTime = [](const BarRows::value_type &a, const BarRows::value_type &b) { return a.first < b.first; };
+    if (!std::is_sorted(rows.cbegin(), rows.cend(), byTime)) {
+      std::stable_sort(rows.begin(), rows.end(), byTime);
+    }
+    bars.reserve(bars.size() + qsizetype(rows.size()));
+    for (const auto &[time, bar] : rows) {
+      bars.append(time, bar);
+    }
+  }
+
+  struct Field {
+      const char *begin;
+      const char *end;
+  };
+
+  Field trimmed(const char *begin, const char *end) {
+    while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '"')) {
+      ++begin;
+    }
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '"')) {
+      --end;
+    }
+    return { begin, end };
+  }
+
+  bool parsePriceField(Field field, price_t &price) { return parsePrice(field.begin, field.end, price); }
+
+  // Adds the split and dividend of one daily row, if it has any. Dividend factors are computed by the database, which
+  // knows the close before the ex-date even when it came from another file
+  void addCorporateActions(QList<CorporateAction> &actions, time_record_t time, double splitCoefficient, double dividendAmount) {
+    if (splitCoefficient > 0 && splitCoefficient != 1.0) {
+      actions.append(CorporateAction::split(time, splitCoefficient));
+    }
+    if (dividendAmount > 0) {
+      actions.append(CorporateAction::dividend(time, dividendAmount, 0.0));
+    }
+  }
+
+  // Empty means no action, like an explicit 1 or 0
+  bool parseOptionalDecimal(Field field, double fallback, double &value) {
+    value = fallback;
+    return field.begin == field.end || parseDecimal(field.begin, field.end, value);
+  }
+
+  bool parseInteger(Field field, qint64 &value) {
+    const char *p = field.begin;
+    value         = 0;
+    for (; p != field.end && *p >= '0' && *p <= '9' && p - field.begin < 18; ++p) {
+      value = value * 10 + (*p - '0');
+    }
+    if (p == field.end && p != field.begin) {
+      return true;
+    }
+    double decimal;  // "1234.0", "1.2e6" and the like
+    if (!parseDecimal(field.begin, field.end, decimal) || decimal < 0 || decimal > 9e18) {
+      return false;
+    }
+    value = qint64(std::llround(decimal));
+    return true;
+  }
+
+  int digitsAt(const char *p, int count) {
+    int value = 0;
+    for (int i = 0; i < count; ++i) {
+      if (p[i] < '0' || p[i] > '9') {
+        return -1;
+      }
+      value = value * 10 + (p[i] - '0');
+    }
+    return value;
+  }
+
+  // Epoch seconds (milliseconds if 13+ digits), or a US/Eastern yyyy-MM-dd[( |T)hh:mm[:ss]] with '-' or '/' in the date,
+  // the zone vendors export intraday bars in
+  bool parseTimestamp(Field field, time_record_t &time) {
+    const qsizetype length = field.end - field.begin;
+    qint64          epoch;
+    if (length >= 9 && digitsAt(field.begin, 4) >= 0 && field.begin[4] >= '0' && field.begin[4] <= '9' && parseInteger(field, epoch)) {
+      time = length >= 13 ? epoch / 1000 : epoch;
+      return true;
+    }
+    return parseEasternTimestamp(field.begin, field.end, time);
+  }
+}  // namespace
+
+HistoryImporter::HistoryImporter(DatabaseManager *dbManager, QObject *parent): QObject(parent), dbManager(dbManager) {
+  pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+HistoryImporter::~HistoryImporter() {
+  cancel();
+}
+
+void HistoryImporter::importFiles(const QStringList &paths) {
+  if (worker) {
+    qWarning() << "A history import is already running.";
+    return;
+  }
+  cancelled.storeRelaxed(0);
+  worker = QThread::create([this, paths]() { run(paths); });
+  worker->start();
+}
+
+void HistoryImporter::cancel() {
+  if (!worker) {
+    return;
+  }
+  cancelled.storeRelaxed(1);
+  worker->wait();
+  delete worker;
+  worker = nullptr;
+}
+
+// Parses window n+1 on the pool while window n is written, so parsing and the storage thread's commits overlap
+void HistoryImporter::run(const QStringList &paths) {
+  struct Window {
+      QList<Chunk>             chunks;
+      std::vector<ChunkResult> results;  // One slot per chunk, written by its parser only
+      QSemaphore               parsed;
+      qint64                   bytes {};
+  };
+  HistoryImportSummary summary;
+  QSet<QString>        symbols;
+  QList<Chunk>         queued;
+  qsizetype            nextFile   = 0;
+  qint64               bytesDone  = 0;
+  qint64               bytesTotal = 0;
+  for (const QString &path : paths) {
+    bytesTotal += QFileInfo(path).size();
+  }
+  const int windowChunks = qMax(2, pool.maxThreadCount());
+
+  auto startWindow = [&]() {
+    std::unique_ptr<Window> window(new Window);
+    while (window->chunks.size() < windowChunks && !cancelled.loadRelaxed()) {
+      if (!queued.isEmpty()) {
+        window->chunks.append(queued.takeFirst());
+      } else if (nextFile < paths.size()) {
+        openFile(paths.at(nextFile++), queued, summary);
+      } else {
+        break;
+      }
+    }
+    if (window->chunks.isEmpty()) {
+      return std::unique_ptr<Window>();
+    }
+    window->results.resize(window->chunks.size());
+    for (qsizetype i = 0; i < window->chunks.size(); ++i) {
+      Window *target  = window.get();
+      window->bytes  += window->chunks.at(i).end - window->chunks.at(i).begin;
+      pool.start([target, i]() {
+        const Chunk &chunk = target->chunks.at(i);
+        target->results[i] = chunk.json ? parseJsonChunk(chunk) : parseCsvChunk(chunk);
+        target->parsed.release();
+      });
+    }
+    return window;
+  };
+
+  std::unique_ptr<Window> current = startWindow();
+  while (current) {
+    std::unique_ptr<Window> next = startWindow();
+    current->parsed.acquire(int(current->chunks.size()));  // Parsers hold pointers into the window until they release
+
+    Batch                                  batch;
+    QHash<QString, QList<CorporateAction>> actions;
+    for (ChunkResult &result : current->results) {
+      summary.rejected += result.rejected;
+      if (!result.error.isEmpty()) {
+        summary.errors.append(result.error);
+      }
+      for (auto it = result.bars.constBegin(); it != result.bars.constEnd(); ++it) {
+        batch[result.resolution][it.key()].merge(it.value());  // Chunks follow each other in the file, usually an append
+        symbols.insert(it.key());
+      }
+      for (auto it = result.actions.constBegin(); it != result.actions.constEnd(); ++it) {
+        actions[it.key()].append(it.value());
+      }
+    }
+    if (!batch.isEmpty() && !cancelled.loadRelaxed() && !writeBatch(batch, actions, summary)) {
+      summary.errors.append("Writing to the database failed, the import was stopped.");
+      cancelled.storeRelaxed(1);
+    }
+    bytesDone += current->bytes;
+    QMetaObject::invokeMethod(this, [this, bytesDone, bytesTotal]() { emit progress(bytesDone, bytesTotal); }, Qt::QueuedConnection);
+    current = std::move(next);
+  }
+  if (summary.actions > 0 && !cancelled.loadRelaxed()) {
+    // A dividend read before the bar preceding it had no close to work from, now every window is stored
+    QMetaObject::invokeMethod(dbManager, [this]() { dbManager->resolveDividendFactors(); }, Qt::BlockingQueuedConnection);
+  }
+  summary.symbols = symbols.size();
+  qDebug() << "History import done:" << summary.bars << "bars of" << summary.symbols << "symbols from" << summary.files << "files,"
+           << summary.rejected << "rows rejected";
+
+  QThread *thread = QThread::currentThread();
+  QMetaObject::invokeMethod(
+    this,
+    [this, thread, summary]() {
+      if (worker != thread) {
+        return;  // Cancelled, cancel() already cleaned up
+      }
+      worker->wait();
+      delete worker;
+      worker = nullptr;
+      emit finished(summary);
+    },
+    Qt::QueuedConnection);
+}
+
+// Maps the file and cuts it into chunks that end on a line break
+bool HistoryImporter::openFile(const QString &path, QList<Chunk> &chunks, HistoryImportSummary &summary) {
+  QSharedPointer<QFile> file(new QFile(path));
+  if (!file->open(QIODevice::ReadOnly)) {
+    summary.errors.append(QString("%1: %2").arg(path, file->errorString()));
+    return false;
+  }
+  const qint64 size = file->size();
+  if (size == 0) {
+    return true;
+  }
+  const char *data = reinterpret_cast<const char *>(file->map(0, size));
+  if (!data) {
+    summary.errors.append(QString("%1: cannot map the file (%2)").arg(path, file->errorString()));
+    return false;
+  }
+  summary.files++;
+  const char *end = data + size;
+  if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+    data += 3;  // UTF-8 byte order mark
+  }
+  const char *first = data;
+  while (first < end && (*first == ' ' || *first == '\r' || *first == '\n' || *first == '\t')) {
+    ++first;
+  }
+
+  Chunk chunk;
+  chunk.file          = file;
+  chunk.defaultSymbol = symbolFromFileName(path);
+  if (first < end && *first == '{') {
+    chunk.json  = true;  // Saved API response, parsed as one document
+    chunk.begin = data;
+    chunk.end   = end;
+    chunks.append(chunk);
+    return true;
+  }
+
+  const char *lineEnd = static_cast<const char *>(std::memchr(first, '\n', end - first));
+  lineEnd             = lineEnd ? lineEnd : end;
+  bool isHeader       = false;
+  if (!parseCsvHeader(QByteArray(first, lineEnd - first), chunk.layout, isHeader)) {
+    summary.errors.append(QString("%1: unrecognized columns").arg(path));
+    return false;
+  }
+  if (chunk.layout.symbol < 0 && chunk.defaultSymbol.isEmpty()) {
+    summary.errors.append(QString("%1: no symbol column and no symbol in the file name").arg(path));
+    return false;
+  }
+  const char *position = isHeader ? qMin(lineEnd + 1, end) : first;
+  while (position < end) {
+    const char *cut = position + qMin<qint64>(CHUNK_BYTES, end - position);
+    if (cut < end) {
+      const char *newline = static_cast<const char *>(std::memchr(cut, '\n', end - cut));
+      cut                 = newline ? newline + 1 : end;
+    }
+    chunk.begin = position;
+    chunk.end   = cut;
+    chunks.append(chunk);
+    position = cut;
+  }
+  return true;
+}
+
+bool HistoryImporter::writeBatch(const Batch &bars, const QHash<QString, QList<CorporateAction>> &actions, HistoryImportSummary &summary) {
+  bool                  written = false;
+  HistoricalMergeResult merge;
+  QMetaObject::invokeMethod(
+    dbManager,
+    [this, &bars, &actions, &merge, &written]() {
+      // Bars first, so a dividend finds the close before it when both are in this batch. The 5min bars of all symbols are
+      // one transaction, daily and weekly responses are one symbol per file anyway
+      written = true;
+      for (auto resolution = bars.constBegin(); written && resolution != bars.constEnd(); ++resolution) {
+        if (resolution.key() == BarResolution::FiveMinutes) {
+          written = dbManager->importHistoricalPrices(resolution.value(), &merge);
+          continue;
+        }
+        for (auto it = resolution.value().constBegin(); written && it != resolution.value().constEnd(); ++it) {
+          HistoricalMergeResult stored;
+          written          = dbManager->storeHistoricalPrices(it.key(), it.value(), resolution.key(), &stored);
+          merge.inserted  += stored.inserted;
+          merge.updated   += stored.updated;
+          merge.unchanged += stored.unchanged;
+        }
+      }
+      written = written && (actions.isEmpty() || dbManager->importCorporateActions(actions));
+    },
+    Qt::BlockingQueuedConnection);
+  if (written) {
+    summary.bars     += merge.inserted + merge.updated + merge.unchanged;
+    summary.inserted += merge.inserted;
+    summary.updated  += merge.updated;
+    for (const QList<CorporateAction> &symbolActions : actions) {
+      summary.actions += symbolActions.size();
+    }
+  }
+  return written;
+}
+
+// Finds the columns by name, or falls back to the fixed [symbol,]timestamp,open,high,low,close,volume order
+bool HistoryImporter::parseCsvHeader(const QByteArray &line, CsvLayout &layout, bool &isHeader) {
+  layout.separator = ',';
+  if (line.count(';') > line.count(layout.separator)) {
+    layout.separator = ';';
+  }
+  if (line.count('\t') > line.count(layout.separator)) {
+    layout.separator = '\t';
+  }
+  const QList<QByteArray> names = line.trimmed().split(layout.separator);
+  layout.columns                = int(names.size());
+  for (int column = 0; column < layout.columns; ++column) {
+    const QByteArray name = names.at(column).trimmed().toLower().replace('"', "");
+    if (name == "symbol" || name == "ticker") {
+      layout.symbol = column;
+    } else if (name == "timestamp" || name == "time" || name == "date" || name == "datetime") {
+      layout.timestamp = column;
+    } else if (name == "open") {
+      layout.open = column;
+    } else if (name == "high") {
+      layout.high = column;
+    } else if (name == "low") {
+      layout.low = column;
+    } else if (name == "close") {
+      layout.close = column;
+    } else if (name == "volume") {
+      layout.volume = column;
+    } else if (name == "split_coefficient" || name == "split") {
+      layout.split = column;
+    } else if (name == "dividend_amount" || name == "dividend") {
+      layout.dividend = column;
+    }
+  }
+  isHeader = layout.timestamp >= 0 || layout.open >= 0 || layout.close >= 0;
+  if (isHeader) {
+    return layout.timestamp >= 0 && layout.open >= 0 && layout.high >= 0 && layout.low >= 0 && layout.close >= 0;
+  }
+  if (layout.columns != 6 && layout.columns != 7) {
+    return false;
+  }
+  const int first  = layout.columns - 6;
+  layout.symbol    = first == 1 ? 0 : -1;
+  layout.timestamp = first;
+  layout.open      = first + 1;
+  layout.high      = first + 2;
+  layout.low       = first + 3;
+  layout.close     = first + 4;
+  layout.volume    = first + 5;
+  return true;
+}
+
+HistoryImporter::ChunkResult HistoryImporter::parseCsvChunk(const Chunk &chunk) {
+  ChunkResult                result;
+  QVarLengthArray<Field, 16> fields;
+  QByteArray                 lastSymbolBytes;
+  QString                    symbol;  // Of target
+  QHash<QString, BarRows>    rows;    // Collected as they come, some vendors write the newest row first
+  BarRows                   *target = nullptr;
+  if (chunk.layout.symbol < 0) {
+    symbol = chunk.defaultSymbol;
+    target = &rows[symbol];
+  }
+  const CsvLayout &layout = chunk.layout;
+
+  for (const char *line = chunk.begin; line < chunk.end;) {
+    const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', chunk.end - line));
+    lineEnd             = lineEnd ? lineEnd : chunk.end;
+    const char *content = lineEnd;
+    if (content > line && content[-1] == '\r') {
+      --content;
+    }
+    const char *next = lineEnd + 1;
+    if (content == line) {
+      line = next;
+      continue;  // Blank line
+    }
+
+    fields.clear();
+    for (const char *field = line;;) {
+      const char *separator = static_cast<const char *>(std::memchr(field, layout.separator, content - field));
+      fields.append(trimmed(field, separator ? separator : content));
+      if (!separator) {
+        break;
+      }
+      field = separator + 1;
+    }
+    line = next;
+    if (fields.size() < layout.columns) {
+      result.rejected++;
+      continue;
+    }
+
+    time_record_t time;
+    price_t       open, high, low, close;
+    qint64        volume           = 0;
+    double        splitCoefficient = 1.0, dividendAmount = 0.0;
+    if (!parseTimestamp(fields[layout.timestamp], time) || !parsePriceField(fields[layout.open], open) ||
+        !parsePriceField(fields[layout.high], high) || !parsePriceField(fields[layout.low], low) ||
+        !parsePriceField(fields[layout.close], close) || (layout.volume >= 0 && !parseInteger(fields[layout.volume], volume)) ||
+        (layout.split >= 0 && !parseOptionalDecimal(fields[layout.split], 1.0, splitCoefficient)) ||
+        (layout.dividend >= 0 && !parseOptionalDecimal(fields[layout.dividend], 0.0, dividendAmount))) {
+      result.rejected++;
+      continue;
+    }
+    HistoricalDataRecord bar(open, high, low, close, volume);
+    if (!isValidBar(bar)) {
+      result.rejected++;
+      continue;
+    }
+    if (layout.symbol >= 0) {
+      // Dumps are grouped by symbol, the hash lookup only happens when it changes
+      const Field symbolField = fields[layout.symbol];
+      if (!target || lastSymbolBytes.size() != symbolField.end - symbolField.begin ||
+          std::memcmp(lastSymbolBytes.constData(), symbolField.begin, symbolField.end - symbolField.begin) != 0) {
+        lastSymbolBytes = QByteArray(symbolField.begin, symbolField.end - symbolField.begin);
+        if (lastSymbolBytes.isEmpty()) {
+          target = nullptr;
+          result.rejected++;
+          continue;
+        }
+        symbol = QString::fromLatin1(lastSymbolBytes).toUpper();
+        target = &rows[symbol];
+      }
+    }
+    target->emplace_back(time, bar);
+    if (splitCoefficient != 1.0 || dividendAmount != 0.0) {
+      addCorporateActions(result.actions[symbol], time, splitCoefficient, dividendAmount);
+    }
+  }
+  for (auto it = rows.begin(); it != rows.end(); ++it) {
+    appendSorted(it.value(), result.bars[it.key()]);
+  }
+  return result;
+}
+
+// A saved Alpha Vantage response, any "Time Series (...)" object. Same parser as the fetcher's replies
+HistoryImporter::ChunkResult HistoryImporter::parseJsonChunk(const Chunk &chunk) {
+  ChunkResult      result;
+  TimeSeriesParser parser;
+  if (!parser.parse(chunk.begin, chunk.end)) {
+    result.error = QString("%1: %2").arg(chunk.file->fileName(), parser.errorString());
+    return result;
+  }
+  const QString symbol = parser.symbol().isEmpty() ? chunk.defaultSymbol : parser.symbol().toUpper();
+  if (symbol.isEmpty()) {
+    result.error = QString("%1: no symbol in the document").arg(chunk.file->fileName());
+    return result;
+  }
+  result.resolution = parser.resolution();
+  result.rejected   = parser.rejected();
+
+  BarSeries parsed = parser.takeBars();
+  qsizetype valid  = 0;
+  for (qsizetype i = 0; i < parsed.size() && isValidBar(parsed.record(i)); ++i) {
+    valid++;
+  }
+  if (valid == parsed.size()) {
+    result.bars[symbol] = std::move(parsed);  // The usual case, no copy
+  } else {
+    BarSeries &bars = result.bars[symbol];
+    bars.reserve(parsed.size());
+    for (qsizetype i = 0; i < parsed.size(); ++i) {
+      const HistoricalDataRecord bar = parsed.record(i);
+      if (isValidBar(bar)) {
+        bars.append(parsed.timestamp(i), bar);
+      } else {
+        result.rejected++;
+      }
+    }
+  }
+  if (!parser.actions().isEmpty()) {
+    result.actions[symbol] = parser.actions();  // Only in the adjusted daily series, "4. close" there is still the unadjusted close
+  }
+  return result;
+}
+
+QString HistoryImporter::symbolFromFileName(const QString &path) {
+  QString name = QFileInfo(path).completeBaseName();
+  name         = name.section('_', -1);  // intraday_5min_AAPL -> AAPL
+  return name.toUpper();
+}
+
+bool HistoryImporter::isValidBar(const HistoricalDataRecord &bar) {
+  return bar.open > 0 && bar.high > 0 && bar.low > 0 && bar.close > 0 && bar.low <= bar.high && bar.low <= qMin(bar.open, bar.close) &&
+         bar.high >= qMax(bar.open, bar.close) && bar.volume >= 0;
+}
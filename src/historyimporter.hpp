@@ -0,0 +1,106 @@
+#ifndef _HISTORY_IMPORTER_HEADER_
+#define _HISTORY_IMPORTER_HEADER_
+
+#include <QAtomicInt>
+#include <QFile>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+
+#include "datamanager.hpp"
+
+// Outcome of an import run
+struct HistoryImportSummary {
+    qint64     files {};
+    qint64     symbols {};
+    qint64     bars {};      // Valid bars handed to the database
+    qint64     rejected {};  // Rows that could not be parsed or failed validation
+    qint64     inserted {};
+    qint64     updated {};
+    qint64     actions {};   // Splits and dividends stored
+    QStringList errors;  // One line per file that could not be read
+};
+
+// Imports price history from vendor/broker CSV dumps and saved Alpha Vantage JSON responses.
+// Files are memory-mapped and cut into chunks at line boundaries, the chunks are parsed on a thread pool and every
+// window of parsed chunks goes to the DatabaseManager as one transaction, while the next window is being parsed.
+//
+// CSV: the header names the columns (symbol/ticker, timestamp/date/time/datetime, open, high, low, close, volume, any
+// order, ',' ';' or tab separated). Without a header the columns are [symbol,]timestamp,open,high,low,close,volume.
+// Without a symbol column the symbol is taken from the file name (AAPL.csv, or the last '_' part of intraday_5min_AAPL.csv).
+// Timestamps are epoch seconds (or milliseconds), or "yyyy-MM-dd[ hh:mm[:ss]]" in US/Eastern time like the vendor's keys,
+// whatever the machine's zone (a plain date is its 00:00 Eastern).
+// Optional split_coefficient and dividend_amount columns (and the same fields of TIME_SERIES_DAILY_ADJUSTED responses)
+// become corporate actions effective at the bar's timestamp; the prices themselves must be the unadjusted ones.
+// Daily and weekly JSON responses go to the daily and weekly tables (stamped at 00:00 UTC of the day or its Monday), the
+// rest is taken as 5min bars.
+class HistoryImporter : public QObject {
+    Q_OBJECT
+
+  public:
+    HistoryImporter(DatabaseManager *dbManager, QObject *parent = nullptr);
+    ~HistoryImporter();
+
+    bool isRunning() const { return worker != nullptr; }
+    void importFiles(const QStringList &paths);  // Returns immediately, one run at a time
+    void cancel();                               // Stops after the window being written, blocks until then
+
+  signals:
+    void progress(qint64 bytesDone, qint64 bytesTotal);
+    void finished(const HistoryImportSummary &summary);
+
+  private:
+    // Column positions of a CSV file, -1 when missing
+    struct CsvLayout {
+        char separator { ',' };
+        int  symbol { -1 };
+        int  timestamp { -1 };
+        int  open { -1 };
+        int  high { -1 };
+        int  low { -1 };
+        int  close { -1 };
+        int  volume { -1 };
+        int  split { -1 };     // Split coefficient, 1 or empty on days without one
+        int  dividend { -1 };  // Dividend amount, 0 or empty on days without one
+        int  columns {};
+    };
+    struct Chunk {
+        QSharedPointer<QFile> file;  // Keeps the mapping alive until the chunk is parsed
+        const char           *begin {};
+        const char           *end {};
+        bool                  json {};
+        CsvLayout             layout;
+        QString               defaultSymbol;
+    };
+    struct ChunkResult {
+        QHash<QString, BarSeries>              bars;
+        BarResolution                          resolution { BarResolution::FiveMinutes };  // Of all the bars
+        QHash<QString, QList<CorporateAction>> actions;
+        qint64                                 rejected {};
+        QString                                error;
+    };
+    using Batch = QMap<BarResolution, QHash<QString, BarSeries>>;
+
+    DatabaseManager *dbManager;  // Lives in the storage thread, only reached through invokeMethod
+    QThread         *worker {};  // Runs run(), created per import
+    QThreadPool      pool;       // Chunk parsers
+    QAtomicInt       cancelled;
+
+    const static qint64 CHUNK_BYTES { 4 * 1024 * 1024 };
+
+    void run(const QStringList &paths);  // In the worker thread
+    bool openFile(const QString &path, QList<Chunk> &chunks, HistoryImportSummary &summary);
+    bool writeBatch(const Batch &bars, const QHash<QString, QList<CorporateAction>> &actions, HistoryImportSummary &summary);
+
+    static ChunkResult parseCsvChunk(const Chunk &chunk);
+    static ChunkResult parseJsonChunk(const Chunk &chunk);
+    static bool        parseCsvHeader(const QByteArray &line, CsvLayout &layout, bool &isHeader);  // false if the columns are unusable
+    static QString     symbolFromFileName(const QString &path);
+    static bool        isValidBar(const HistoricalDataRecord &bar);
+};
+
+#endif
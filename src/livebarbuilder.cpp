@@ -0,0 +1,68 @@
+#include "livebarbuilder.hpp"
+
+LiveBarBuilder::LiveBarBuilder(time_record_t intervalSecs): intervalSecs(intervalSecs) { }
+
+bool LiveBarBuilder::addQuote(SymbolId id, time_record_t time, price_t price) {
+  if (time <= 0 || !(price > 0)) {
+    return false;  // No trade time (quote of an unknown symbol) or no price
+  }
+  const time_record_t start = time - time % intervalSecs;  // Bars are stamped with the start of their interval
+  BarSeries          &bars  = liveBars[id];
+  if (!bars.isEmpty() && start < bars.lastTimestamp()) {
+    return false;  // Out of order, the bar it belongs to is closed
+  }
+  if (!bars.isEmpty() && start == bars.lastTimestamp()) {
+    HistoricalDataRecord bar = bars.record(bars.size() - 1);
+    bar.high                 = qMax(bar.high, price);
+    bar.low                  = qMin(bar.low, price);
+    bar.close                = price;
+    bars.insert(start, bar);  // Replaces the last bar, no shifting
+    return true;
+  }
+  bars.append(start, HistoricalDataRecord(price, price, price, price, 0));
+  if (bars.size() > MAX_BARS) {
+    bars = bars.mid(bars.size() - MAX_BARS);
+  }
+  return true;
+}
+
+const BarSeries &LiveBarBuilder::bars(SymbolId id) const {
+  static const BarSeries empty;
+  auto                   it = liveBars.constFind(id);
+  return it != liveBars.constEnd() ? it.value() : empty;
+}
+
+void LiveBarBuilder::discardBefore(SymbolId id, time_record_t time) {
+  auto it = liveBars.find(id);
+  if (it == liveBars.end() || it->isEmpty() || it->firstTimestamp() >= time) {
+    return;
+  }
+  *it = it->mid(it->lowerBound(time));
+}
+
+void LiveBarBuilder::remove(SymbolId id) {
+  liveBars.remove(id);
+}
+
+qsizetype LiveBarBuilder::foldInto(Stock &stock, qsizetype from) const {
+  const BarSeries &live    = bars(stock.getSymbolId());
+  qsizetype        changed = 0;
+  for (qsizetype i = qMax(from, qsizetype(0)); i < live.size(); ++i) {
+    const BarSeries     &history = stock.getHistoricalPrices();
+    const time_record_t  time    = live.timestamp(i);
+    HistoricalDataRecord bar     = live.record(i);
+    if (!history.isEmpty() && time < history.lastTimestamp()) {
+      continue;  // The downloaded bar is complete and has the real volume
+    }
+    if (!history.isEmpty() && time == history.lastTimestamp()) {
+      const HistoricalDataRecord last = history.record(history.size() - 1);
+      bar.open                        = last.open;
+      bar.high                        = qMax(bar.high, last.high);
+      bar.low                         = qMin(bar.low, last.low);
+      bar.volume                      = last.volume;
+    }
+    stock.updateHistoricalBar(time, bar);
+    ++changed;
+  }
+  return changed;
+}
@@ -0,0 +1,34 @@
+#ifndef _LIVE_BAR_BUILDER_HEADER_
+#define _LIVE_BAR_BUILDER_HEADER_
+
+#include <QHash>
+
+#include "stock.hpp"
+
+// Builds bars of the tracked stocks out of the polled quotes, so the chart keeps moving between historical downloads.
+// Each quote is folded into the bar of its interval: the first price opens it, the last one closes it. The quote API
+// reports no traded volume, so live bars carry 0 and take the volume of the downloaded bar they are folded into.
+// Only the newest MAX_BARS bars are kept per stock, the next download replaces them with the vendor's bars.
+class LiveBarBuilder {
+  public:
+    explicit LiveBarBuilder(time_record_t intervalSecs);
+
+    // Folds a quote (time in seconds since epoch) into its bar, false if it is older than the stock's current bar
+    bool             addQuote(SymbolId id, time_record_t time, price_t price);
+    const BarSeries &bars(SymbolId id) const;                        // Live bars of the stock, oldest first
+    void             discardBefore(SymbolId id, time_record_t time);  // Downloaded bars cover them now
+    void             remove(SymbolId id);
+
+    // Folds the stock's live bars from index from on into its history: past the last bar they are appended, on the last bar
+    // they extend it (its open and volume are kept), on an earlier, completed bar they are ignored. Returns the bars changed.
+    // The history must be decoded (the stock is pinned, or has nothing cached), or the bars would shadow the cached ones.
+    qsizetype foldInto(Stock &stock, qsizetype from = 0) const;
+
+  private:
+    QHash<SymbolId, BarSeries> liveBars;
+    time_record_t              intervalSecs;
+
+    const static qsizetype MAX_BARS { 24 * 12 };  // A day of 5min bars
+};
+
+#endif
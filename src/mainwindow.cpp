@@ -7,11 +7,15 @@
 #include <QDebug>  // For debugging output (like console.log in JS)
 #include <QDialogButtonBox>
 #include <QFont>
+#include <QFileDialog>
 #include <QFormLayout>
 #include <QGroupBox>
+#include <QLocale>
 #include <QMessageBox>  // For simple pop-up messages (instead of alert())
 #include <QSpinBox>
 #include <QStringList>
+#include <QtNumeric>
+#include <algorithm>
 // Qt Charts specific includes
 #include <QtCharts/QCandlestickSeries>
 #include <QtCharts/QCandlestickSet>
@@ -300,6 +304,17 @@ MainWindow::MainWindow(QWidget *parent):
   QLabel      *selectorLabel  = new QLabel("Stock:");
   selectorLayout->addWidget(selectorLabel);
   selectorLayout->addWidget(stockSelector);
+  // Longer ranges come from the database in coarser bars (see DatabaseManager::loadHistoricalRange), the days are the item data
+  rangeSelector = new QComboBox();
+  rangeSelector->setStyleSheet(stockSelector->styleSheet());
+  rangeSelector->addItem("Intraday", 0);
+  rangeSelector->addItem("1 month", 30);
+  rangeSelector->addItem("6 months", 182);
+  rangeSelector->addItem("1 year", 365);
+  rangeSelector->addItem("5 years", 5 * 365);
+  rangeSelector->addItem("20 years", 20 * 365);
+  selectorLayout->addWidget(new QLabel("Range:"));
+  selectorLayout->addWidget(rangeSelector);
   selectorLayout->addStretch();
   stockChartView->setRenderHint(QPainter::Antialiasing);  // For smoother rendering
   chartLayout->addLayout(selectorLayout);
@@ -331,13 +346,61 @@ MainWindow::MainWindow(QWidget *parent):
   networkThread->start();
   // --- Database Manager Setup ---
   // Use QCoreApplication::applicationDirPath() for the database file location
-  dbManager = new DatabaseManager(QCoreApplication::applicationDirPath() + "/" + DATABASE_FILE_PATH, this);
-  if (!dbManager->openDatabase()) {
-    QMessageBox::critical(this, "Database Error", "Failed to open or create database. Application may not function correctly.");
-    // Consider handling this more gracefully, e.g., disabling features
-  }
-  // Settings init
+  // The manager lives in its own thread so SQLite commits never stall the UI
+  // Settings init (before the database, they pick the historical prices backend)
   settings = new QSettings("tobe2098", "stock_tracker", this);
+  QString barStorePath;
+  if (settings->value("columnar_bar_store", false).toBool()) {
+    barStorePath = QCoreApplication::applicationDirPath() + "/" + BAR_STORE_DIRECTORY;
+  }
+  const qint64 historyCacheMegabytes = settings->value("history_cache_mb", HistoryCache::DEFAULT_BUDGET_BYTES / (1024 * 1024)).toLongLong();
+  historyCache.setBudget(historyCacheMegabytes * 1024 * 1024);
+  storageThread = new QThread(this);
+  dbManager     = new DatabaseManager(QCoreApplication::applicationDirPath() + "/" + DATABASE_FILE_PATH, barStorePath);
+  dbManager->moveToThread(storageThread);
+  connect(storageThread, &QThread::finished, dbManager, &QObject::deleteLater);
+  connect(dbManager, &DatabaseManager::writeFailed, this,
+          [this](const QString &error) { statusMessage(QString("Database write failed: %1").arg(error), 5000); });
+  connect(dbManager, &DatabaseManager::statisticsUpdated, this, [this](const QString &symbol, const StockStatistics &statistics) {
+    Stock *stock = findStockBySymbol(symbol);
+    if (!stock) {
+      return;
+    }
+    stock->setStatistics(statistics);
+    if (stockListWidget->currentItem() && stockListWidget->currentItem() == stockListItems.value(stock->getSymbolId())) {
+      displayStockDetails(*stock);  // Its details are on display
+    }
+  });
+  connect(dbManager, &DatabaseManager::historicalPageLoaded, this, &MainWindow::onHistoricalPageLoaded);
+  connect(dbManager, &DatabaseManager::stockDeleted, this, &MainWindow::onStockDeleted);
+  connect(dbManager, &DatabaseManager::adjustedPricesReady, this, &MainWindow::onAdjustedHistoryReady);
+  connect(dbManager, &DatabaseManager::historicalRangeLoaded, this, &MainWindow::onHistoricalRangeLoaded);
+  connect(dbManager, &DatabaseManager::databaseOpened, this, &MainWindow::onDatabaseOpened);
+  storageThread->start();
+  // Opening can migrate the schema, which takes a while on a big history. The window comes up meanwhile, without stocks and
+  // without the stock entry, and onDatabaseOpened fills it in. Everything queued on the storage thread runs after the open
+  historyLoader = nullptr;
+  QMetaObject::invokeMethod(dbManager, [db = dbManager]() { db->requestOpenDatabase(); }, Qt::QueuedConnection);
+  QMetaObject::invokeMethod(dbManager, "setRetentionPolicy", Qt::QueuedConnection,
+                            Q_ARG(int, settings->value("retention_raw_days", 0).toInt()),
+                            Q_ARG(int, settings->value("retention_hourly_days", 0).toInt()));
+  historyImporter = new HistoryImporter(dbManager, this);
+  connect(historyImporter, &HistoryImporter::progress, this, [this](qint64 bytesDone, qint64 bytesTotal) {
+    statusBar()->showMessage(QString("Importing history... %1%").arg(bytesTotal > 0 ? 100 * bytesDone / bytesTotal : 100), 2000);
+  });
+  connect(historyImporter, &HistoryImporter::finished, this, [this](const HistoryImportSummary &summary) {
+    statusMessage(QString("Imported %1 bars of %2 symbols from %3 files (%4 new, %5 rows rejected, %6 splits and dividends).")
+                    .arg(summary.bars)
+                    .arg(summary.symbols)
+                    .arg(summary.files)
+                    .arg(summary.inserted)
+                    .arg(summary.rejected)
+                    .arg(summary.actions),
+                  8000);
+    if (!summary.errors.isEmpty()) {
+      QMessageBox::warning(this, "History Import", summary.errors.mid(0, 10).join("\n"));
+    }
+  });
 
   // --- Signal-Slot Connections ---
   // Connect the 'clicked' signal of the addStockButton to our 'onAddStockButtonClicked' slot.
@@ -362,6 +425,7 @@ MainWindow::MainWindow(QWidget *parent):
   connect(dataFetcher, &StockDataFetcher::fetchError, this, &MainWindow::onStockDataFetchError);
   connect(dataFetcher, &StockDataFetcher::invalidStockDataFetched, this, &MainWindow::onInvalidStockDataFetched);
   connect(dataFetcher, &StockDataFetcher::historicalDataFetched, this, &MainWindow::onHistoricalDataFetched);
+  connect(dataFetcher, &StockDataFetcher::coarseHistoryFetched, this, &MainWindow::onCoarseHistoryFetched);
   connect(dataFetcher, &StockDataFetcher::requestRateLimitExceeded, this, &MainWindow::onRateLimitExceeded);
   connect(rateLimitTimer, &CountdownTimer::finished, dataFetcher, &StockDataFetcher::onHistoricalRequestTimerTimeout);
   QMetaObject::invokeMethod(dataFetcher, "initialize", Qt::QueuedConnection);
@@ -385,17 +449,21 @@ MainWindow::MainWindow(QWidget *parent):
     }
   });
   connect(stockSelector, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onStockSelectionChanged);
+  rangeSelector->setCurrentIndex(qBound(0, settings->value("chart_range", 0).toInt(), rangeSelector->count() - 1));
+  connect(rangeSelector, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onRangeSelectionChanged);
+  if (AutoScaleChartView *autoChartView = qobject_cast<AutoScaleChartView *>(stockChartView)) {
+    connect(autoChartView, &AutoScaleChartView::olderDataRequested, this, &MainWindow::onOlderHistoryRequested);
+  }
   // Initial auto-scale
   if (AutoScaleChartView *autoChartView = qobject_cast<AutoScaleChartView *>(stockChartView)) {
     autoChartView->autoScaleYAxis();
   }
-  trackedStocks = dbManager->loadAllStocks();
   setupPlaceholderChart();
   hasOneStocksData = false;
   setupStockSelector();
-
-  updateStockListDisplay();
-  updateHeatmap();
+  stockSymbolLineEdit->setEnabled(false);  // Until the stored stocks are in, they would replace one added meanwhile
+  addStockButton->setEnabled(false);
+  statusBar()->showMessage("Opening the database (an older one is migrated first)...");
   // Only way that seems to work is setting a timer.
   QTimer::singleShot(0, this, [this]() {
     QByteArray savedGeometry = settings->value("windowGeometry").toByteArray();
@@ -417,6 +485,31 @@ MainWindow::MainWindow(QWidget *parent):
     // QMetaObject::invokeMethod(rateLimitTimer, "setTargetTime", Qt::QueuedConnection, Q_ARG(qint64, remaining_time));//Has to be declared
     // as a stop
   });
+  //   dataFetcher->setAPIKey();
+}
+
+void MainWindow::onDatabaseOpened(bool opened, bool columnarStore, const QList<Stock> &stocks) {
+  statusBar()->clearMessage();
+  stockSymbolLineEdit->setEnabled(true);
+  addStockButton->setEnabled(true);
+  if (!opened) {
+    QMessageBox::critical(this, "Database Error", "Failed to open or create database. Application may not function correctly.");
+    // Consider handling this more gracefully, e.g., disabling features
+  }
+  historyLoader = new HistoryBulkLoader(QCoreApplication::applicationDirPath() + "/" + DATABASE_FILE_PATH,
+                                        columnarStore ? barStorePath : QString(), this);
+  connect(historyLoader, &HistoryBulkLoader::historyLoaded, this, &MainWindow::onBulkHistoryLoaded);
+  connect(historyLoader, &HistoryBulkLoader::progress, this, [this](int loaded, int total) {
+    statusBar()->showMessage(QString("Loading stored history... %1/%2").arg(loaded).arg(total), 1000);
+  });
+  trackedStocks = stocks;
+  rebuildStockSlots();
+  setupStockSelector();
+  updateStockListDisplay();
+  updateHeatmap();
+  if (mainTabWidget->currentIndex() == chart_tab_id && !historicalDataFetchedFromDB) {
+    loadAllHistoricalData();  // The chart tab was opened while the database was
+  }
   QTimer::singleShot(0, this, [this]() {
     ConnectivityChecker checker;
     if (checker.checkInternetConnection()) {
@@ -439,12 +532,22 @@ MainWindow::MainWindow(QWidget *parent):
       statusMessage(QString("No internet connection detected, skipping data update."), 3000);
     }
   });
-  //   dataFetcher->setAPIKey();
 }
 
 // Destructor implementation (empty as Qt's parent-child ownership handles deletion)
 MainWindow::~MainWindow() {
   saveSettings();
+  if (historyLoader) {
+    historyLoader->cancel();
+  }
+  historyImporter->cancel();  // Waits for the batch being written, the storage thread is still up
+
+  if (storageThread && storageThread->isRunning()) {
+    // Commit whatever is still queued before the thread goes away
+    QMetaObject::invokeMethod(dbManager, "closeDatabase", Qt::BlockingQueuedConnection);
+    storageThread->quit();
+    storageThread->wait();
+  }
 
   if (networkThread && networkThread->isRunning()) {
     // Request thread to quit
@@ -504,16 +607,11 @@ void MainWindow::onAddStockButtonClicked() {
 
 // Slot implementation for clicking an item in the stock list
 void MainWindow::onStockListItemClicked(QListWidgetItem *item) {
-  // Extract the symbol from the clicked item's text.
-  // We assume the format is "SYMBOL (Name) - Current Price: $X.XX"
-  StockListItemWidget *customWidget = qobject_cast<StockListItemWidget *>(stockListWidget->itemWidget(item));
-  if (customWidget) {
-    QString symbol = customWidget->findChild<QLabel *>()->text().split(" ")[0];
-    Stock  *stock  = findStockBySymbol(symbol);  // Get stock from in-memory list
-    qDebug() << "Selected stock:" << symbol;
-    if (stock) {
-      displayStockDetails(*stock);
-    }
+  // Every row carries the SymbolId of its stock
+  Stock *stock = findStock(item->data(Qt::UserRole).toInt());
+  if (stock) {
+    qDebug() << "Selected stock:" << stock->getSymbol();
+    displayStockDetails(*stock);
   }
 }
 // NEW SLOT: Handles "Remove from RAM" button click
@@ -524,28 +622,7 @@ void MainWindow::onRemoveStockFromRamClicked(const QString &symbol) {
     QString("Are you sure you want to remove '%1' from the tracked list? It will remain in the database.").arg(symbol),
     QMessageBox::Yes | QMessageBox::No);
   if (reply == QMessageBox::Yes) {
-    int indexToRemove = -1;
-    for (int i = 0; i < trackedStocks.size(); ++i) {
-      if (trackedStocks.at(i).getSymbol() == symbol) {
-        indexToRemove = i;
-        break;
-      }
-    }
-
-    if (indexToRemove != -1) {
-      trackedStocks.removeAt(indexToRemove);  // Remove from our in-memory list
-      // Find and remove the corresponding QListWidgetItem
-      for (int i = 0; i < stockListWidget->count(); ++i) {
-        QListWidgetItem *item = stockListWidget->item(i);
-        // When using setItemWidget, the item->text() is usually empty
-        // so we rely on finding the widget itself
-        StockListItemWidget *customWidget = qobject_cast<StockListItemWidget *>(stockListWidget->itemWidget(item));
-        if (customWidget &&
-            customWidget->findChild<QLabel *>()->text().startsWith(symbol + " (")) {  // Crude check, but works for our format
-          delete stockListWidget->takeItem(i);                                        // Take item and delete it
-          break;
-        }
-      }
+    if (removeTrackedStock(SymbolTable::instance().find(symbol))) {  // Removes its list row too
       // updateStockListDisplay();                                      // Refresh the list if needed (though direct removal might be
       // faster)
       stockDetailsLabel->setText("Select a stock to see details.");  // Clear details
@@ -563,50 +640,52 @@ void MainWindow::onDeleteStockFromDbClicked(const QString &symbol) {
     QString("Are you sure you want to PERMANENTLY delete '%1' from the database and tracked list? This cannot be undone.").arg(symbol),
     QMessageBox::Yes | QMessageBox::No);
   if (reply == QMessageBox::Yes) {
-    if (dbManager->deleteStock(symbol)) {  // Delete from database
-      // If successfully deleted from DB, also remove from RAM and UI
-      int indexToRemove = -1;
-      for (int i = 0; i < trackedStocks.size(); ++i) {
-        if (trackedStocks.at(i).getSymbol() == symbol) {
-          indexToRemove = i;
-          break;
-        }
-      }
-
-      if (indexToRemove != -1) {
-        trackedStocks.removeAt(indexToRemove);  // Remove from in-memory list
-      }
-      // Remove the corresponding QListWidgetItem
-      for (int i = 0; i < stockListWidget->count(); ++i) {
-        QListWidgetItem     *item         = stockListWidget->item(i);
-        StockListItemWidget *customWidget = qobject_cast<StockListItemWidget *>(stockListWidget->itemWidget(item));
-        if (customWidget && customWidget->findChild<QLabel *>()->text().startsWith(symbol + " (")) {
-          delete stockListWidget->takeItem(i);
-          break;
-        }
-      }
-      // updateStockListDisplay();                                      // Refresh the list if needed
-      stockDetailsLabel->setText("Select a stock to see details.");  // Clear details
-      // QMessageBox::information(this, "Stock Deleted", QString("Stock '%1' has been permanently deleted.").arg(symbol));
-      statusMessage(QString("Stock '%1' has been permanently deleted.").arg(symbol), 3000);
-      setupStockSelector();
-      updateHeatmap();  // Update heatmap after deletion
-      qDebug() << "Stock" << symbol << "deleted from DB and RAM.";
-    } else {
-      QMessageBox::critical(this, "Deletion Error", QString("Failed to delete '%1' from the database.").arg(symbol));
-    }
+    // Queued behind whatever the storage thread is doing, onStockDeleted finishes the job
+    QMetaObject::invokeMethod(dbManager, [db = dbManager, symbol]() { db->requestDeleteStock(symbol); }, Qt::QueuedConnection);
+  }
+}
+void MainWindow::onStockDeleted(const QString &symbol, bool deleted) {
+  if (deleted) {  // Delete from database
+    // If successfully deleted from DB, also remove from RAM and UI
+    removeTrackedStock(SymbolTable::instance().find(symbol));  // Remove from in-memory list and its list row
+    // updateStockListDisplay();                                      // Refresh the list if needed
+    stockDetailsLabel->setText("Select a stock to see details.");  // Clear details
+    // QMessageBox::information(this, "Stock Deleted", QString("Stock '%1' has been permanently deleted.").arg(symbol));
+    statusMessage(QString("Stock '%1' has been permanently deleted.").arg(symbol), 3000);
+    setupStockSelector();
+    updateHeatmap();  // Update heatmap after deletion
+    qDebug() << "Stock" << symbol << "deleted from DB and RAM.";
+  } else {
+    QMessageBox::critical(this, "Deletion Error", QString("Failed to delete '%1' from the database.").arg(symbol));
   }
 }
 void MainWindow::onDownloadStockClicked(const QString &symbol) {
   Stock *stock = findStockBySymbol(symbol);  // Get stock from in-memory list
   if (stock) {
-    time_record_t now = QDateTime::currentSecsSinceEpoch();
+    time_record_t       now        = QDateTime::currentSecsSinceEpoch();
+    const BarResolution resolution = chartResolution();
+    if (resolution >= BarResolution::Daily) {
+      // The long range views want the daily or weekly adjusted series, one request covers twenty years
+      const time_record_t fetched = coarseFetchTimes.value(stock->getSymbolId(), 0);
+      if (fetched != 0 && now - fetched < HISTORICAL_CACHE_LIFETIME_SECS) {
+        statusMessage(QString("Long-term history for '%1' is recent. Using cached data.").arg(symbol), 3000);
+        expandHistory(*stock);
+        updateChart(*stock);
+        mainTabWidget->setCurrentIndex(chart_tab_id);
+        return;
+      }
+      statusMessage(QString("Fetching long-term history for '%1'...").arg(symbol), 500);
+      QMetaObject::invokeMethod(
+        dataFetcher, [fetcher = dataFetcher, symbol, resolution]() { fetcher->fetchHistoricalData(symbol, resolution); },
+        Qt::QueuedConnection);
+      return;
+    }
     if (stock->getLastHistoricalFetchTime() != 0 && now - stock->getLastHistoricalFetchTime() < HISTORICAL_CACHE_LIFETIME_SECS) {
       statusMessage(QString("Historical data for '%1' is recent. Using cached data.").arg(symbol), 3000);
       qDebug() << "Historical data for" << symbol << "is recent. Using cached data.";
+      expandHistory(*stock);
       if (stock->getHistoricalPrices().size() == 0) {
-        stock->setHistoricalPrices(dbManager->loadHistoricalPrices(stock->getSymbol()));
-        setupStockSelector();
+        loadRecentHistoricalPrices(*stock);  // The chart is redrawn when the page arrives
       }
       updateChart(*stock);  // Use existing historical data
       mainTabWidget->setCurrentIndex(chart_tab_id);
@@ -620,36 +699,58 @@ void MainWindow::onDownloadStockClicked(const QString &symbol) {
 // Helper method to update the QListWidget display
 void MainWindow::updateStockListDisplay() {
   stockListWidget->clear();  // Clear all existing items first
+  stockListItems.clear();
   for (const Stock &stock : trackedStocks) {
-    // Format the text for each list item
-    QString displayText = QString("%1 (%2) - Current Price: $%3 (<span style='color:%5;'>%4%</span>)")
-                            .arg(stock.getSymbol(), stock.getName(), QString::number(stock.getCurrentPrice(), 'f', 2),
-                                 QString::number((stock.getPriceChange() / stock.getCurrentPrice()) * 100.0, 'f', 2),
-                                 (stock.getPriceChange() >= 0 ? "green" : "red")  // Format to 2 decimal places
-                            );
-    // Create the custom widget for the list item
-    // 'stockListWidget' is passed as the parent, ensuring proper memory management
-    StockListItemWidget *customItemWidget = new StockListItemWidget(stock.getSymbol(), displayText, stockListWidget);
-
-    // Create a QListWidgetItem and set its size hint to match the custom widget's preferred size
-    QListWidgetItem *item = new QListWidgetItem(stockListWidget);
-    // item->setSizeHint(QSize(-1, 40));  // Important for correct item height
-    // This is the crucial line: Associate our custom widget with the QListWidgetItem
-    stockListWidget->setItemWidget(item, customItemWidget);
-    // Connect the custom widget's signals to MainWindow's new slots
-    // This connects specific signals from 'customItemWidget' to slots in 'this' (MainWindow).
-    // Each 'customItemWidget' instance for each stock has its own connections.
-
-    // Connection for "Download historical data"
-    connect(customItemWidget, &StockListItemWidget::downloadClicked, this, &MainWindow::onDownloadStockClicked);
-
-    // Connection for "Remove from RAM"
-    connect(customItemWidget, &StockListItemWidget::removeClicked, this, &MainWindow::onRemoveStockFromRamClicked);
-
-    // Connection for "Delete from DB"
-    connect(customItemWidget, &StockListItemWidget::deleteClicked, this, &MainWindow::onDeleteStockFromDbClicked);
-
-    stockListWidget->addItem(item);  // Add the formatted text as a new item
+    addStockListRow(stock);
+  }
+}
+
+QString MainWindow::stockListText(const Stock &stock) const {
+  // Format the text for each list item
+  return QString("%1 (%2) - Current Price: $%3 (<span style='color:%5;'>%4%</span>)")
+    .arg(stock.getSymbol(), stock.getName(), QString::number(stock.getCurrentPrice(), 'f', 2),
+         QString::number((stock.getPriceChange() / stock.getCurrentPrice()) * 100.0, 'f', 2),
+         (stock.getPriceChange() >= 0 ? "green" : "red")  // Format to 2 decimal places
+    );
+}
+
+void MainWindow::addStockListRow(const Stock &stock) {
+  // Create the custom widget for the list item
+  // 'stockListWidget' is passed as the parent, ensuring proper memory management
+  StockListItemWidget *customItemWidget = new StockListItemWidget(stock.getSymbol(), stockListText(stock), stockListWidget);
+
+  // Create a QListWidgetItem and set its size hint to match the custom widget's preferred size
+  QListWidgetItem *item = new QListWidgetItem(stockListWidget);
+  item->setData(Qt::UserRole, stock.getSymbolId());  // Clicks map back to the stock without parsing the label
+  // item->setSizeHint(QSize(-1, 40));  // Important for correct item height
+  // This is the crucial line: Associate our custom widget with the QListWidgetItem
+  stockListWidget->setItemWidget(item, customItemWidget);
+  // Connect the custom widget's signals to MainWindow's new slots
+  // This connects specific signals from 'customItemWidget' to slots in 'this' (MainWindow).
+  // Each 'customItemWidget' instance for each stock has its own connections.
+
+  // Connection for "Download historical data"
+  connect(customItemWidget, &StockListItemWidget::downloadClicked, this, &MainWindow::onDownloadStockClicked);
+
+  // Connection for "Remove from RAM"
+  connect(customItemWidget, &StockListItemWidget::removeClicked, this, &MainWindow::onRemoveStockFromRamClicked);
+
+  // Connection for "Delete from DB"
+  connect(customItemWidget, &StockListItemWidget::deleteClicked, this, &MainWindow::onDeleteStockFromDbClicked);
+
+  stockListWidget->addItem(item);  // Add the formatted text as a new item
+  stockListItems.insert(stock.getSymbolId(), item);
+}
+
+// A quote only changes its own row, the rest of the list is left alone
+void MainWindow::updateStockListRow(const Stock &stock) {
+  QListWidgetItem *item = stockListItems.value(stock.getSymbolId());
+  if (!item) {
+    addStockListRow(stock);
+    return;
+  }
+  if (StockListItemWidget *customWidget = qobject_cast<StockListItemWidget *>(stockListWidget->itemWidget(item))) {
+    customWidget->setDisplayText(stockListText(stock));
   }
 }
 
@@ -675,6 +776,18 @@ void MainWindow::displayStockDetails(const Stock &stock) {
                            QString::number(100 * (stock.getDayHigh() - stock.getDayLow()) / stock.getDayLow(), 'f', 2),
                            //    (QDateTime::fromSecsSinceEpoch(stock.getLastTimestamp())).toString()
                            (stock.getDayOpen() - stock.getDayClose() >= 0 ? "green" : "red"));
+  // Precomputed from the stored history (StockStatistics), nothing is scanned here
+  const StockStatistics &statistics = stock.getStatistics();
+  if (!statistics.isEmpty()) {
+    const double periodReturn = statistics.periodReturn();
+    details += QString("<br><b>52 week range:</b> $%1 - $%2, <b>Avg volume:</b> %3<br>"
+                       "<b>Volatility:</b> %4%, <b>%5 day return:</b> <span style='color:%7;'>%6</span>")
+                 .arg(QString::number(statistics.low52Week(), 'f', 2), QString::number(statistics.high52Week(), 'f', 2),
+                      QLocale().toString(qint64(statistics.averageVolume())), QString::number(100 * statistics.volatility(), 'f', 1),
+                      QString::number(StockStatistics::RETURN_DAYS),
+                      qIsNaN(periodReturn) ? QString("n/a") : QString::number(100 * periodReturn, 'f', 2) + "%",
+                      !qIsNaN(periodReturn) && periodReturn < 0 ? "red" : "green");
+  }
   stockDetailsLabel->setText(details);  // Set the HTML text to the label
 }
 // ... implement new slots ...
@@ -760,6 +873,45 @@ void MainWindow::onSettingsButtonClicked() {
   // otherLayout->addRow(checkBox);
   // otherLayout->addRow("Max items:", spinBox);
 
+  QCheckBox *columnarStoreBox = new QCheckBox("Store historical prices in memory-mapped files (restart required)", &settingsDialog);
+  columnarStoreBox->setChecked(settings->value("columnar_bar_store", false).toBool());
+  otherLayout->addRow(columnarStoreBox);
+
+  // Retention, older bars are rolled up into hourly and then daily bars in the background
+  QSpinBox *rawRetentionBox = new QSpinBox(&settingsDialog);
+  rawRetentionBox->setRange(0, 36500);
+  rawRetentionBox->setSpecialValueText("Forever");
+  rawRetentionBox->setSuffix(" days");
+  rawRetentionBox->setValue(settings->value("retention_raw_days", 0).toInt());
+  QSpinBox *hourlyRetentionBox = new QSpinBox(&settingsDialog);
+  hourlyRetentionBox->setRange(0, 36500);
+  hourlyRetentionBox->setSpecialValueText("Forever");
+  hourlyRetentionBox->setSuffix(" days");
+  hourlyRetentionBox->setValue(settings->value("retention_hourly_days", 0).toInt());
+  otherLayout->addRow("Keep 5min bars for:", rawRetentionBox);
+  otherLayout->addRow("Keep hourly bars for:", hourlyRetentionBox);
+
+  // Memory for loaded histories, the least recently charted ones are dropped and reloaded from the database when needed
+  QSpinBox *historyCacheBox = new QSpinBox(&settingsDialog);
+  historyCacheBox->setRange(16, 65536);
+  historyCacheBox->setSuffix(" MB");
+  historyCacheBox->setValue(int(historyCache.budget() / (1024 * 1024)));
+  otherLayout->addRow("History cache size:", historyCacheBox);
+
+  QPushButton *importButton = new QPushButton("Import history files...", &settingsDialog);
+  importButton->setEnabled(!historyImporter->isRunning());
+  otherLayout->addRow(importButton);
+  connect(importButton, &QPushButton::clicked, [this, &settingsDialog]() {
+    QStringList files = QFileDialog::getOpenFileNames(&settingsDialog, "Import price history", QString(),
+                                                      "Price history (*.csv *.txt *.json);;All files (*)");
+    if (files.isEmpty()) {
+      return;
+    }
+    historyImporter->importFiles(files);
+    statusMessage(QString("Importing history from %1 files...").arg(files.size()), 2000);
+    settingsDialog.reject();
+  });
+
   // Add groups to main layout
   layout->addWidget(apiGroup);
   layout->addWidget(otherGroup);
@@ -800,6 +952,13 @@ void MainWindow::onSettingsButtonClicked() {
     QString new_key_historical = api_key_historical_edit->text().trimmed();
     // bool    newNotifications = checkBox->isChecked();
     // int     newMaxItems      = spinBox->value();
+    settings->setValue("columnar_bar_store", columnarStoreBox->isChecked());
+    settings->setValue("retention_raw_days", rawRetentionBox->value());
+    settings->setValue("retention_hourly_days", hourlyRetentionBox->value());
+    settings->setValue("history_cache_mb", historyCacheBox->value());
+    historyCache.setBudget(qint64(historyCacheBox->value()) * 1024 * 1024);
+    QMetaObject::invokeMethod(dbManager, "setRetentionPolicy", Qt::QueuedConnection, Q_ARG(int, rawRetentionBox->value()),
+                              Q_ARG(int, hourlyRetentionBox->value()));
 
     // Update main window settings
     QMetaObject::invokeMethod(dataFetcher, "updateQuoteAPIKey", Qt::QueuedConnection, Q_ARG(QString, new_quote_key));
@@ -829,7 +988,7 @@ void MainWindow::onTabChanged(int index) {
   if (index == heatmap_tab_id) {
     updateHeatmap();  // Ensure heatmap is updated when its tab is selected
   } else if (index == chart_tab_id) {
-    if (!historicalDataFetchedFromDB) {
+    if (!historicalDataFetchedFromDB && historyLoader) {  // Else once the database is open
       loadAllHistoricalData();
     }
     // If you want to auto-display chart of selected stock when tab is changed
@@ -854,14 +1013,15 @@ void MainWindow::onStockDataFetched(const Stock &stock) {
     existingStock->setPriceChange(stock.getPriceChange());
     existingStock->setLastQuoteFetchTime(fetchedStockCopy.getLastQuoteFetchTime());
     existingStock->setDayStats(fetchedStockCopy.getDayStats());
-    dbManager->addOrUpdateStock(*existingStock);
-    updateStockListDisplay();             // Refresh the list widget
+    foldLiveQuote(*existingStock, stock.getLastQuoteFetchTime());  // The fetcher stamps the quote with its trade time
+    persistStock(*existingStock);
+    updateStockListRow(*existingStock);   // Refresh its row of the list widget
     displayStockDetails(*existingStock);  // Display details of the newly fetched/updated stock
     qDebug() << "Updated existing stock:" << stock.getSymbol();
   } else {
-    trackedStocks.append(fetchedStockCopy);  // Add new stock to our list
-    dbManager->addOrUpdateStock(fetchedStockCopy);
-    updateStockListDisplay();               // Refresh the list widget
+    addTrackedStock(fetchedStockCopy);  // Add new stock to our list
+    persistStock(fetchedStockCopy);
+    addStockListRow(fetchedStockCopy);      // Append its row to the list widget
     displayStockDetails(fetchedStockCopy);  // Display details of the newly fetched/updated stock
     qDebug() << "Added new stock:" << stock.getSymbol();
   }
@@ -869,27 +1029,81 @@ void MainWindow::onStockDataFetched(const Stock &stock) {
   updateHeatmap();
 }
 // New slot for historical data fetched
-void MainWindow::onHistoricalDataFetched(const QString &symbol, const QMap<time_record_t, HistoricalDataRecord> &historicalData) {
+void MainWindow::onHistoricalDataFetched(const QString &symbol, const BarSeries &historicalData, const BarQualityReport &quality) {
   qDebug() << "Historical data fetched for:" << symbol << " (" << historicalData.size() << " points)";
   Stock *stock = findStockBySymbol(symbol);
   // if (!historicalDataFetchedFromDB) {
   //   loadAllHistoricalData();
   // }
   if (stock) {
-    stock->setHistoricalPrices(historicalData);  // Set historical prices for the stock
+    expandHistory(*stock);
+    if (stock->getHistoricalPrices().isEmpty() && stock->getLastHistoricalFetchTime() != 0) {
+      loadRecentHistoricalPrices(*stock);  // Pick up the stored history first, older pages load when panning
+    }
+    // The fetched bars are unadjusted, like the stored ones; the stock holds them adjusted, like the pages read back. The
+    // schedule is read on the storage thread, onAdjustedHistoryReady merges the result. Queued before the write below, so
+    // the bars are adjusted with the actions as they were when they were fetched
+    QMetaObject::invokeMethod(
+      dbManager, [db = dbManager, symbol, historicalData]() { db->requestAdjustedPrices(symbol, historicalData); }, Qt::QueuedConnection);
+    stock->addHistoryQuality(quality.flags);
     stock->setLastHistoricalFetchTime(QDateTime::currentSecsSinceEpoch());
-    updateChart(*stock);                           // Update the chart with this stock's data
-    mainTabWidget->setCurrentIndex(chart_tab_id);  // Switch to the chart tab
-    // Update historical prices in database
-    dbManager->updateHistoricalPrices(symbol, historicalData);
+    chartRanges.remove(stock->getSymbolId());  // Read again behind the write below
+    // Merge historical prices into the database (only new or changed bars are written)
+    persistHistoricalPrices(symbol, historicalData);
     // Also update the stock's last_historical_fetch_time in the main stocks table
-    dbManager->addOrUpdateStock(*stock);  // This will update the fetch time
-    hasOneStocksData = true;
-    setupStockSelector();
+    persistStock(*stock);  // This will update the fetch time
   } else {
     qWarning() << "Received historical data for unknown stock:" << symbol;
   }
 }
+void MainWindow::onAdjustedHistoryReady(const QString &symbol, const BarSeries &adjusted) {
+  Stock *stock = findStockBySymbol(symbol);
+  if (!stock) {
+    return;  // Removed while the bars were adjusted
+  }
+  expandHistory(*stock);                   // It is charted below, it may have been moved off the chart in the meantime
+  stock->mergeHistoricalPrices(adjusted);  // Merge the new window into the stock's history
+  if (!adjusted.isEmpty()) {
+    liveBars.discardBefore(stock->getSymbolId(), adjusted.lastTimestamp());  // The vendor's bars replace the live ones
+    liveBars.foldInto(*stock);                                                // Apart from the one still being built
+  }
+  updateChart(*stock);                           // Update the chart with this stock's data
+  mainTabWidget->setCurrentIndex(chart_tab_id);  // Switch to the chart tab
+  hasOneStocksData = true;
+  setupStockSelector();
+}
+// Daily and weekly bars only go to the database, the stock keeps its 5min bars and the range views read them back
+void MainWindow::onCoarseHistoryFetched(const QString &symbol, BarResolution resolution, const BarSeries &historicalData,
+                                        const QList<CorporateAction> &actions) {
+  qDebug() << "Long-term history fetched for:" << symbol << " (" << historicalData.size() << " bars," << actions.size() << "actions)";
+  Stock *stock = findStockBySymbol(symbol);
+  if (!stock) {
+    qWarning() << "Received historical data for unknown stock:" << symbol;
+    return;
+  }
+  // Queued like every write; the range read below is queued behind it on the storage thread, so it sees the new bars
+  QMetaObject::invokeMethod(
+    dbManager,
+    [db = dbManager, symbol, resolution, historicalData, actions]() {
+      // Bars first, so a dividend finds the close before it
+      if (db->storeHistoricalPrices(symbol, historicalData, resolution) && !actions.isEmpty()) {
+        db->importCorporateActions({ { symbol, actions } });
+      }
+    },
+    Qt::QueuedConnection);
+  coarseFetchTimes.insert(stock->getSymbolId(), QDateTime::currentSecsSinceEpoch());
+  chartRanges.remove(stock->getSymbolId());
+  statusMessage(QString("Stored %1 %2 bars for '%3'.")
+                  .arg(historicalData.size())
+                  .arg(resolution == BarResolution::Weekly ? "weekly" : "daily")
+                  .arg(symbol),
+                3000);
+  expandHistory(*stock);
+  updateChart(*stock);
+  mainTabWidget->setCurrentIndex(chart_tab_id);
+  hasOneStocksData = true;
+  setupStockSelector();
+}
 // New Slot: Handles errors during stock data fetch
 void MainWindow::onStockDataFetchError(const QString &symbol, const QString &errorString) {
   qWarning() << "Failed to fetch data for" << symbol << ":" << errorString;
@@ -913,27 +1127,203 @@ void MainWindow::statusMessage(const QString &message, qint64 duration) {
 }
 
 // Helper method to find a stock by its symbol in the trackedStocks list
+Stock *MainWindow::findStock(SymbolId id) {
+  if (id < 0 || id >= stockSlots.size() || stockSlots.at(id) < 0) {
+    return nullptr;  // Not tracked
+  }
+  return &trackedStocks[stockSlots.at(id)];  // Return pointer to the element in the list
+}
+
 Stock *MainWindow::findStockBySymbol(const QString &symbol) {
-  for (int i = 0; i < trackedStocks.size(); ++i) {
-    if (trackedStocks.at(i).getSymbol() == symbol) {
-      return &trackedStocks[i];  // Return pointer to the element in the list
-    }
+  return findStock(SymbolTable::instance().find(symbol));  // One hash probe, no scan of trackedStocks
+}
+
+void MainWindow::addTrackedStock(const Stock &stock) {
+  const SymbolId id = stock.getSymbolId();
+  if (id < 0) {
+    return;  // A stock without a symbol is never tracked
+  }
+  if (id >= stockSlots.size()) {
+    stockSlots.resize(SymbolTable::instance().size(), -1);
+  }
+  stockSlots[id] = trackedStocks.size();
+  trackedStocks.append(stock);
+}
+
+bool MainWindow::removeTrackedStock(SymbolId id) {
+  if (!findStock(id)) {
+    return false;
+  }
+  const qsizetype slot = stockSlots.at(id);
+  trackedStocks.removeAt(slot);
+  stockSlots[id] = -1;
+  for (qsizetype i = slot; i < trackedStocks.size(); ++i) {
+    stockSlots[trackedStocks.at(i).getSymbolId()] = i;  // The stocks after it moved up by one
+  }
+  historyCursors.remove(id);
+  pendingPages.remove(id);
+  coarseFetchTimes.remove(id);
+  chartRanges.remove(id);
+  historyCache.remove(id);
+  liveBars.remove(id);
+  delete stockListItems.take(id);  // Deleting the item takes it out of stockListWidget
+  return true;
+}
+
+void MainWindow::rebuildStockSlots() {
+  stockSlots.fill(-1, SymbolTable::instance().size());
+  for (qsizetype i = 0; i < trackedStocks.size(); ++i) {
+    stockSlots[trackedStocks.at(i).getSymbolId()] = i;
+  }
+}
+
+// Queues a stock row on the storage thread, returns immediately
+void MainWindow::persistStock(const Stock &stock) {
+  QMetaObject::invokeMethod(dbManager, [db = dbManager, stock]() { db->queueStockUpdate(stock); }, Qt::QueuedConnection);
+}
+
+// Queues historical prices on the storage thread, returns immediately
+void MainWindow::persistHistoricalPrices(const QString &symbol, const BarSeries &historicalData) {
+  QMetaObject::invokeMethod(
+    dbManager, [db = dbManager, symbol, historicalData]() { db->queueHistoricalPrices(symbol, historicalData); }, Qt::QueuedConnection);
+}
+
+// Reads run on the storage thread too (the connection belongs to it). They are queued and the page comes back by signal,
+// the GUI never waits for a group commit or a compaction pass
+void MainWindow::requestHistoricalPage(const HistoricalPriceCursor &cursor) {
+  pendingPages.insert(SymbolTable::instance().find(cursor.symbol));
+  QMetaObject::invokeMethod(dbManager, [db = dbManager, cursor]() { db->requestHistoricalPage(cursor); }, Qt::QueuedConnection);
+}
+
+// Asks for the newest page of stored bars, onHistoricalPageLoaded merges it into the stock and keeps the cursor
+void MainWindow::loadRecentHistoricalPrices(const Stock &stock) {
+  HistoricalPriceCursor cursor;
+  cursor.symbol   = stock.getSymbol();
+  cursor.pageSize = HISTORY_PAGE_BARS;
+  historyCursors.remove(stock.getSymbolId());  // Older pages wait for the new cursor
+  requestHistoricalPage(cursor);
+}
+
+// The newest page (no cursor yet) or an older one. Bars that came in while it was read, a fetch or live quotes, are newer
+// than the stored ones and win
+void MainWindow::onHistoricalPageLoaded(const HistoricalPriceCursor &cursor, const BarSeries &page) {
+  const SymbolId id    = SymbolTable::instance().find(cursor.symbol);
+  Stock         *stock = findStock(id);
+  pendingPages.remove(id);
+  if (!stock) {
+    return;  // Removed while the page was read
+  }
+  const bool older = historyCursors.contains(id);
+  historyCursors.insert(id, cursor);
+  stock->addHistoryQuality(cursor.quality);
+  if (page.isEmpty()) {
+    return;
+  }
+  if (!historyCache.isPinned(id)) {
+    historyCache.insert(id, page);  // Moved off the chart in the meantime
+  } else {
+    BarSeries bars = page;
+    bars.merge(stock->getHistoricalPrices());
+    stock->setHistoricalPrices(bars);
+    historyCache.updatePinned(id, bars.size());
+  }
+  if (!hasOneStocksData) {
+    hasOneStocksData = true;
+    setupStockSelector();
+  } else if (stockSelector->findData(id) < 0) {
+    stockSelector->addItem(stock->getSymbol() + " - " + stock->getName(), id);
+  }
+  if (id == chartedSymbol && historyCache.isPinned(id) && chartRangeDays() == 0) {  // A range view reads its own bars
+    updateChart(*stock, older);
+  }
+  if (older) {
+    statusMessage(QString("Loaded %1 older bars for '%2'.").arg(page.size()).arg(stock->getSymbol()), 1500);
+  }
+}
+
+// Pages in the next older block of stored bars for the charted stock
+void MainWindow::onOlderHistoryRequested(qint64 oldestLoadedMSecs) {
+  Q_UNUSED(oldestLoadedMSecs);
+  if (chartRangeDays() > 0) {
+    return;  // A range view already holds its whole range
+  }
+  Stock *stock  = findStock(chartedSymbol);
+  auto   cursor = historyCursors.constFind(chartedSymbol);
+  if (!stock || cursor == historyCursors.constEnd() || cursor->exhausted) {
+    return;  // Everything stored is already loaded
+  }
+  if (pendingPages.contains(chartedSymbol)) {
+    return;  // Panning fires this repeatedly, one page at a time
+  }
+  requestHistoricalPage(*cursor);
+}
+
+// Moves a stock's bars into the history cache while it is off the chart (about 11 bytes a bar instead of 48)
+void MainWindow::compactHistory(Stock &stock) {
+  historyCache.unpin(stock.getSymbolId(), stock.getHistoricalPrices());
+  stock.clearHistoricalPrices();
+  qDebug() << "History cache holds" << historyCache.usedBytes() << "of" << historyCache.budget() << "bytes";
+}
+
+void MainWindow::expandHistory(Stock &stock) {
+  const SymbolId id = stock.getSymbolId();
+  if (historyCache.isPinned(id)) {
+    return;  // Already decoded in the stock
+  }
+  const bool wasEvicted = historyCache.wasEvicted(id);
+  BarSeries  bars       = historyCache.pin(id);
+  if (bars.isEmpty() && stock.getHistoricalPrices().isEmpty() && wasEvicted) {
+    loadRecentHistoricalPrices(stock);  // Dropped for the budget, the newest page again and older pages on demand
+  } else {
+    bars.merge(stock.getHistoricalPrices());  // Anything merged in since the compaction is newer
+    stock.setHistoricalPrices(bars);
+  }
+  liveBars.foldInto(stock);  // Quotes that came in while it was off the chart
+  historyCache.updatePinned(id, stock.getHistoricalPrices().size());
+}
+
+bool MainWindow::hasHistory(const Stock &stock) const {
+  const SymbolId id = stock.getSymbolId();
+  return !stock.getHistoricalPrices().isEmpty() || historyCache.contains(id) || historyCache.wasEvicted(id);
+}
+
+// Each quote extends the stock's live bar. Only a decoded (pinned) history takes it right away, a compacted one gets its
+// live bars when expandHistory() decodes it again
+void MainWindow::foldLiveQuote(Stock &stock, time_record_t quoteTime) {
+  const SymbolId id = stock.getSymbolId();
+  if (!liveBars.addQuote(id, quoteTime, stock.getCurrentPrice()) || !historyCache.isPinned(id)) {
+    return;
+  }
+  if (liveBars.foldInto(stock, liveBars.bars(id).size() - 1) > 0 && id == chartedSymbol) {
+    historyCache.updatePinned(id, stock.getHistoricalPrices().size());
+    updateLiveCandle(stock);
   }
-  // If not found in memory, try loading from database (useful for fresh start/missing data)
-  // IMPORTANT: This creates a copy. If you want to modify, you'd need to add to trackedStocks.
-  // For now, let's keep it simple: if not in `trackedStocks`, we assume it's new.
-  // A more complex solution might add it to `trackedStocks` if found in DB here.
-  return nullptr;  // Not found
 }
 
 // New helper method to draw/update the chart
-void MainWindow::updateChart(const Stock &stock) {
+void MainWindow::updateChart(const Stock &stock, bool keepVisibleRange) {
   // Clear existing chart series if any
   QChart *chart = stockChartView->chart();
   if (!chart) {
     chart = new QChart();
     stockChartView->setChart(chart);
   }
+  // Remember the visible window when the same stock is redrawn with more bars
+  QDateTime visibleMin, visibleMax;
+  keepVisibleRange = keepVisibleRange && stock.getSymbolId() == chartedSymbol;
+  if (keepVisibleRange && !chart->axes(Qt::Horizontal).isEmpty()) {
+    if (QDateTimeAxis *currentAxis = qobject_cast<QDateTimeAxis *>(chart->axes(Qt::Horizontal).first())) {
+      visibleMin = currentAxis->min();
+      visibleMax = currentAxis->max();
+    }
+  }
+  if (stock.getSymbolId() != chartedSymbol) {
+    if (Stock *previous = findStock(chartedSymbol)) {
+      compactHistory(*previous);  // Only the charted stock keeps its bars decoded
+    }
+  }
+  chartedSymbol = stock.getSymbolId();
+  historyCache.updatePinned(chartedSymbol, stock.getHistoricalPrices().size());  // Its bars may have grown since it was pinned
   chart->removeAllSeries();  // Clear any previous series
   // Remove all existing axes properly
   QList<QAbstractAxis *> axes = chart->axes();
@@ -947,40 +1337,29 @@ void MainWindow::updateChart(const Stock &stock) {
   series->setDecreasingColor(QColor(Qt::red));    // Color for days where close < open
   series->setBodyWidth(0.8);
   // Add data points to the series
-  // QMap is sorted by key (QDate), so iterating gives chronological order
+  // The bars are sorted by timestamp, so one pass over the columns gives chronological order
   QPen thinPen(QColor("#888888"));
   thinPen.setWidthF(1);  // Use setWidthF for subpixel width
   series->setPen(thinPen);
-  for (auto it = stock.getHistoricalPrices().constBegin(); it != stock.getHistoricalPrices().constEnd(); ++it) {
-    // Convert QDate to QDateTime and then to milliseconds since epoch for QPointF
-    const time_record_t        &date   = it.key();
-    const HistoricalDataRecord &record = it.value();
-
-    // Create a candlestick set:
-    // Arguments: open, high, low, close, timestamp (in ms since epoch)
-    // bool isValid = true;
-    // if (record.high < record.low) {
-    //   qDebug() << "ERROR: High < Low at" << QDateTime::fromSecsSinceEpoch(date).toString();
-    //   qDebug() << "  High:" << record.high << "Low:" << record.low;
-    //   isValid = false;
-    // }
-    // if (record.open < record.low || record.open > record.high) {
-    //   qDebug() << "ERROR: Open outside range at" << QDateTime::fromSecsSinceEpoch(date).toString();
-    //   qDebug() << "  Open:" << record.open << "Range: [" << record.low << "," << record.high << "]";
-    //   isValid = false;
-    // }
-    // if (record.close < record.low || record.close > record.high) {
-    //   qDebug() << "ERROR: Close outside range at" << QDateTime::fromSecsSinceEpoch(date).toString();
-    //   qDebug() << "  Close:" << record.close << "Range: [" << record.low << "," << record.high << "]";
-    //   isValid = false;
-    // }
-
-    // if (!isValid) {
-    //   continue;  // Skip invalid data
-    // }
-    QCandlestickSet *set = new QCandlestickSet(record.open, record.high, record.low, record.close, date * 1000);
-    series->append(set);
+  // A range view reads its bars from the database in the resolution that fits the chart, the paged view draws the stock's.
+  // Until the range is read, or with nothing stored in it yet, the stock's own bars are drawn
+  BarResolution resolution = BarResolution::FiveMinutes;
+  BarSeries     rangeBars  = chartRangeDays() > 0 ? loadChartRange(stock, resolution) : BarSeries();
+  if (rangeBars.isEmpty()) {
+    resolution = BarResolution::FiveMinutes;
   }
+  const BarSeries         &bars = rangeBars.isEmpty() ? stock.getHistoricalPrices() : rangeBars;
+  QList<QCandlestickSet *> sets;
+  sets.reserve(bars.size());
+  for (qsizetype i = 0; i < bars.size(); ++i) {
+    // Timestamps are seconds since epoch, the chart wants milliseconds
+    const time_record_t &date = bars.timestamps().at(i);
+
+    // Create a candlestick set: open, high, low, close, timestamp (in ms since epoch)
+    // The bars were validated when they were fetched or loaded (normalizeBars), nothing to check per frame
+    sets.append(new QCandlestickSet(bars.opens().at(i), bars.highs().at(i), bars.lows().at(i), bars.closes().at(i), date * 1000));
+  }
+  series->append(sets);  // One insertion for the whole series instead of one per bar
   // QCandlestickSet *testGreen = new QCandlestickSet(100, 105, 99, 103, QDateTime::currentDateTime().toMSecsSinceEpoch());
   // QCandlestickSet *testRed   = new QCandlestickSet(100, 104, 96, 98, QDateTime::currentDateTime().addDays(1).toMSecsSinceEpoch());
   // series->append(testGreen);
@@ -993,7 +1372,7 @@ void MainWindow::updateChart(const Stock &stock) {
 
   // Create custom X-axis for Date/Time
   QDateTimeAxis *axisX = new QDateTimeAxis();
-  axisX->setFormat("dd/MM hh:mm");  // Format for dates
+  axisX->setFormat(resolution >= BarResolution::Daily ? "dd/MM/yyyy" : "dd/MM hh:mm");  // Format for dates
   axisX->setTitleText("Time stamp");
   axisX->setTickCount(10);
   chart->addAxis(axisX, Qt::AlignBottom);  // or appropriate alignment
@@ -1004,22 +1383,21 @@ void MainWindow::updateChart(const Stock &stock) {
   chart->addAxis(axisY, Qt::AlignLeft);  // or appropriate alignment
   series->attachAxis(axisY);
 
-  // Adjust ranges automatically based on data
-  axisX->setRange(QDateTime::fromSecsSinceEpoch(stock.getHistoricalPrices().firstKey()),
-                  QDateTime::fromSecsSinceEpoch(stock.getHistoricalPrices().lastKey()));
-  // Find min/max price for Y-axis range
-  double minPrice = std::numeric_limits<double>::max(), maxPrice = std::numeric_limits<double>::min();
-  if (!stock.getHistoricalPrices().isEmpty()) {
-    for (HistoricalDataRecord &record : stock.getHistoricalPrices().values()) {
-      if (record.low < minPrice) {
-        minPrice = record.low;
-      }
-      if (record.high > maxPrice) {
-        maxPrice = record.high;
-      }
+  // Adjust ranges automatically based on data. A range or coarse view can come up empty (nothing stored in it yet), its
+  // axes keep their defaults
+  if (!bars.isEmpty()) {
+    axisX->setRange(QDateTime::fromSecsSinceEpoch(bars.firstTimestamp()), QDateTime::fromSecsSinceEpoch(bars.lastTimestamp()));
+    // Find min/max price for Y-axis range, a linear sweep over the low and high columns
+    const double minPrice = *std::min_element(bars.lows().cbegin(), bars.lows().cend());
+    const double maxPrice = *std::max_element(bars.highs().cbegin(), bars.highs().cend());
+    axisY->setRange(qMax(minPrice * 0.95, 0.0), maxPrice * 1.05);  // Add a small buffer
+  }
+  if (!bars.isEmpty() && visibleMin.isValid() && visibleMax.isValid()) {
+    axisX->setRange(visibleMin, visibleMax);
+    if (AutoScaleChartView *autoChartView = qobject_cast<AutoScaleChartView *>(stockChartView)) {
+      autoChartView->autoScaleYAxis();
     }
   }
-  axisY->setRange(qMax(minPrice * 0.95, 0.0), maxPrice * 1.05);  // Add a small buffer
 
   chart->setTitle(QString("Historical data for $%1").arg(stock.getSymbol()));
   // stockChartView->setRubberBand(QChartView::RectangleRubberBand);
@@ -1046,9 +1424,109 @@ void MainWindow::updateChart(const Stock &stock) {
   stockChartView->chart()->setTheme(QChart::ChartThemeDark);  // Optional: apply a theme
 }
 
+// Only the last candle changed, so it is rewritten (or one is appended) instead of rebuilding the whole series.
+// Falls back to updateChart() when the chart does not hold the stock's bars up to the one before the last.
+void MainWindow::updateLiveCandle(const Stock &stock) {
+  QChart          *chart = stockChartView->chart();
+  const BarSeries &bars  = stock.getHistoricalPrices();
+  if (!chart || bars.isEmpty() || chart->series().isEmpty() || chartRangeDays() > 0) {  // Range views are redrawn when reopened
+    return;
+  }
+  QCandlestickSeries *series = qobject_cast<QCandlestickSeries *>(chart->series().first());
+  if (!series) {
+    return;
+  }
+  const qsizetype                last      = bars.size() - 1;
+  const qreal                    timestamp = qreal(bars.lastTimestamp() * 1000);
+  const QList<QCandlestickSet *> sets      = series->sets();
+  const HistoricalDataRecord     bar       = bars.record(last);
+  if (sets.size() == bars.size() && sets.last()->timestamp() == timestamp) {
+    QCandlestickSet *set = sets.last();
+    set->setOpen(bar.open);
+    set->setHigh(bar.high);
+    set->setLow(bar.low);
+    set->setClose(bar.close);
+  } else if (sets.size() == last && (sets.isEmpty() || sets.last()->timestamp() == qreal(bars.timestamp(last - 1) * 1000))) {
+    series->append(new QCandlestickSet(bar.open, bar.high, bar.low, bar.close, timestamp));
+    QList<QAbstractAxis *> axesX = chart->axes(Qt::Horizontal);
+    QDateTimeAxis         *axisX = axesX.isEmpty() ? nullptr : qobject_cast<QDateTimeAxis *>(axesX.first());
+    if (axisX && last > 0 && axisX->max() >= QDateTime::fromSecsSinceEpoch(bars.timestamp(last - 1))) {
+      axisX->setMax(QDateTime::fromSecsSinceEpoch(bars.lastTimestamp()));  // Keep following the newest bar
+    }
+  } else {
+    updateChart(stock, true);
+    return;
+  }
+  QList<QAbstractAxis *> axesY = chart->axes(Qt::Vertical);
+  QValueAxis            *axisY = axesY.isEmpty() ? nullptr : qobject_cast<QValueAxis *>(axesY.first());
+  if (axisY && (bar.high > axisY->max() || bar.low < axisY->min())) {
+    axisY->setRange(qMin(axisY->min(), double(bar.low) * 0.95), qMax(axisY->max(), double(bar.high) * 1.05));
+  }
+}
+
+int MainWindow::chartRangeDays() const {
+  return rangeSelector->currentData().toInt();
+}
+
+BarResolution MainWindow::chartResolution() const {
+  const int days = chartRangeDays();
+  if (days <= 0) {
+    return BarResolution::FiveMinutes;
+  }
+  const time_record_t now = QDateTime::currentSecsSinceEpoch();
+  return resolutionFor(now - qint64(days) * 24 * 60 * 60, now, qMax(stockChartView->width(), 1));
+}
+
+// One bar per pixel at most: five years on a full-width chart are about 1,300 daily bars instead of about 100k 5min ones.
+// Redraws reuse the last read of the stock's range; a new one is read on the storage thread and redrawn when it arrives
+BarSeries MainWindow::loadChartRange(const Stock &stock, BarResolution &resolution) {
+  const int       days    = chartRangeDays();
+  const qsizetype maxBars = qMax(stockChartView->width(), 1);
+  auto            cached  = chartRanges.constFind(stock.getSymbolId());
+  if (cached != chartRanges.constEnd() && cached->days == days && cached->maxBars == maxBars) {
+    resolution = cached->resolution;
+    return cached->bars;  // Empty while pending
+  }
+  ChartRange range;
+  range.days    = days;
+  range.maxBars = maxBars;
+  chartRanges.insert(stock.getSymbolId(), range);
+  const time_record_t to   = QDateTime::currentSecsSinceEpoch();
+  const time_record_t from = to - qint64(days) * 24 * 60 * 60;
+  QMetaObject::invokeMethod(
+    dbManager, [db = dbManager, symbol = stock.getSymbol(), from, to, maxBars]() { db->requestHistoricalRange(symbol, from, to, maxBars); },
+    Qt::QueuedConnection);
+  return {};
+}
+
+void MainWindow::onHistoricalRangeLoaded(const QString &symbol, time_record_t from, time_record_t to, qsizetype maxBars,
+                                         BarResolution resolution, const BarSeries &bars) {
+  Stock *stock = findStockBySymbol(symbol);
+  if (!stock) {
+    return;  // Removed while it was read
+  }
+  const SymbolId id    = stock->getSymbolId();
+  auto           range = chartRanges.find(id);
+  const int      days  = int((to - from) / (24 * 60 * 60));
+  if (range == chartRanges.end() || range->days != days || range->maxBars != maxBars) {
+    return;  // Another range was asked for since, or the stored bars changed and it is read again
+  }
+  range->resolution = resolution;
+  range->bars       = bars;
+  if (id == chartedSymbol && chartRangeDays() == days) {
+    updateChart(*stock);
+  }
+}
+
+// The heatmap gets the few values it draws, trackedStocks and their histories are left alone
 void MainWindow::updateHeatmap() {
-  std::sort(trackedStocks.begin(), trackedStocks.end(), [](const Stock &a, const Stock &b) { return a.getSymbol() < b.getSymbol(); });
-  heatmapWidget->setStocks(trackedStocks);
+  QList<HeatmapEntry> entries;
+  entries.reserve(trackedStocks.size());
+  for (const Stock &stock : trackedStocks) {
+    entries.append({ stock.getSymbolId(), stock.getSymbol(), stock.getCurrentPrice(), stock.getPriceChange() });
+  }
+  std::sort(entries.begin(), entries.end(), [](const HeatmapEntry &a, const HeatmapEntry &b) { return a.symbol < b.symbol; });
+  heatmapWidget->setStocks(entries);
 }
 
 void MainWindow::setupPlaceholderChart() {
@@ -1108,10 +1586,10 @@ void MainWindow::setupStockSelector() {
 
   // Populate with available stocks
   for (const Stock &stock : trackedStocks) {
-    if (stock.getHistoricalPrices().size() == 0) {
+    if (!hasHistory(stock)) {
       continue;
     }
-    stockSelector->addItem(stock.getSymbol() + " - " + stock.getName(), QVariant::fromValue(stock));
+    stockSelector->addItem(stock.getSymbol() + " - " + stock.getName(), stock.getSymbolId());  // The id only, a Stock copy would pin its bars
   }
 }
 void MainWindow::saveWindowGeometry() {
@@ -1119,11 +1597,12 @@ void MainWindow::saveWindowGeometry() {
   settings->setValue("windowGeometry", window_geometry);
 }
 void MainWindow::saveHistoricalUsage() {
-  QStringList request_list;
-  bool        success { QMetaObject::invokeMethod(dataFetcher, "saveHistoricalRequestList", Qt::BlockingQueuedConnection,
-                                                  Q_RETURN_ARG(QStringList, request_list)) };
+  QVariantMap budgets;
+  bool        success { QMetaObject::invokeMethod(dataFetcher, "saveRateLimits", Qt::BlockingQueuedConnection,
+                                                  Q_RETURN_ARG(QVariantMap, budgets)) };
   if (success) {
-    settings->setValue("usageList", request_list);
+    settings->setValue("rateLimits", budgets);
+    settings->remove("usageList");  // Request list of older versions, rateLimits has it now
     // qDebug() << "Got result:" << window_geometry;
   } else {
     qDebug() << "Could not get request list.";
@@ -1132,6 +1611,14 @@ void MainWindow::saveHistoricalUsage() {
 void MainWindow::saveSettings() {
   saveWindowGeometry();
   saveHistoricalUsage();
+  QVariantMap   coarse_fetches;
+  time_record_t now { QDateTime::currentSecsSinceEpoch() };
+  for (auto it = coarseFetchTimes.constBegin(); it != coarseFetchTimes.constEnd(); ++it) {
+    if (now - it.value() < HISTORICAL_CACHE_LIFETIME_SECS) {  // Older ones are fetched again anyway
+      coarse_fetches.insert(SymbolTable::instance().symbol(it.key()), it.value());
+    }
+  }
+  settings->setValue("coarseFetchTimes", coarse_fetches);
   QString key_quote;
   bool success { QMetaObject::invokeMethod(dataFetcher, "getQuoteAPIKey", Qt::BlockingQueuedConnection, Q_RETURN_ARG(QString, key_quote)) };
   if (success) {
@@ -1153,24 +1640,67 @@ void MainWindow::saveSettings() {
 }
 void MainWindow::loadSettings() {
   this->restoreGeometry(settings->value("windowGeometry").toByteArray());
+  const QVariantMap coarse_fetches { settings->value("coarseFetchTimes").toMap() };
+  for (auto it = coarse_fetches.constBegin(); it != coarse_fetches.constEnd(); ++it) {
+    coarseFetchTimes.insert(SymbolTable::instance().intern(it.key()), it.value().toLongLong());
+  }
 
-  QMetaObject::invokeMethod(dataFetcher, "loadHistoricalRequestList", Qt::QueuedConnection,
-                            Q_ARG(QStringList, settings->value("usageList").toStringList()));
   QMetaObject::invokeMethod(dataFetcher, "updateQuoteAPIKey", Qt::QueuedConnection,
                             Q_ARG(QString, settings->value("api_key_quote").toString()));
   QMetaObject::invokeMethod(dataFetcher, "updateHistoricalAPIKey", Qt::QueuedConnection,
                             Q_ARG(QString, settings->value("api_key_historical").toString()));
+  // After the keys, the budgets are per key
+  QMetaObject::invokeMethod(dataFetcher, "loadRateLimits", Qt::QueuedConnection, Q_ARG(QVariantMap, settings->value("rateLimits").toMap()),
+                            Q_ARG(QStringList, settings->value("usageList").toStringList()));
 }
 
 void MainWindow::loadAllHistoricalData() {
   historicalDataFetchedFromDB = true;
-  for (Stock &stock : trackedStocks) {
-    if (stock.getLastHistoricalFetchTime() != 0 && stock.getHistoricalPrices().isEmpty()) {
-      stock.setHistoricalPrices(dbManager->loadHistoricalPrices(stock.getSymbol()));
-      hasOneStocksData = true;
+  QStringList symbols;
+  for (const Stock &stock : trackedStocks) {
+    if (stock.getLastHistoricalFetchTime() != 0 && !hasHistory(stock)) {
+      symbols.append(stock.getSymbol());
     }
   }
-  setupStockSelector();
+  if (symbols.isEmpty()) {
+    setupStockSelector();
+    return;
+  }
+  // The loader reads through its own connections, which only see committed rows. The flush is queued and the load starts
+  // from its completion, the GUI does not wait for the commit
+  QMetaObject::invokeMethod(
+    dbManager,
+    [this, db = dbManager, symbols]() {
+      db->flushPendingWrites();
+      QMetaObject::invokeMethod(
+        this, [this, symbols]() { historyLoader->load(symbols, HISTORY_PAGE_BARS); },  // Only the newest page, the chart pages in the rest
+        Qt::QueuedConnection);
+    },
+    Qt::QueuedConnection);
+}
+
+// One stock of the bulk load, the selector grows as the pages arrive
+void MainWindow::onBulkHistoryLoaded(const QString &symbol, const BarSeries &historicalData, const HistoricalPriceCursor &cursor) {
+  Stock *stock = findStockBySymbol(symbol);
+  if (!stock || historicalData.isEmpty() || hasHistory(*stock)) {
+    return;  // Removed, nothing stored, or loaded some other way in the meantime
+  }
+  historyCache.insert(stock->getSymbolId(), historicalData);  // Off the chart until it is selected
+  stock->addHistoryQuality(cursor.quality);
+  historyCursors.insert(stock->getSymbolId(), cursor);
+  if (!hasOneStocksData) {
+    hasOneStocksData = true;
+    setupStockSelector();
+  } else if (stockSelector->findData(stock->getSymbolId()) < 0) {
+    stockSelector->addItem(symbol + " - " + stock->getName(), stock->getSymbolId());
+  }
+}
+
+void MainWindow::onRangeSelectionChanged(int index) {
+  settings->setValue("chart_range", index);
+  if (Stock *stock = findStock(chartedSymbol)) {
+    updateChart(*stock);  // Not keeping the visible window, it belongs to the previous range
+  }
 }
 
 void MainWindow::onStockSelectionChanged(int index) {
@@ -1189,7 +1719,10 @@ void MainWindow::onStockSelectionChanged(int index) {
   // Get selected stock
   QVariant stockData = stockSelector->itemData(index);
   if (stockData.isValid()) {
-    Stock selectedStock = stockData.value<Stock>();
-    updateChart(selectedStock);
+    Stock *trackedStock = findStock(stockData.toInt());
+    if (trackedStock) {
+      expandHistory(*trackedStock);
+      updateChart(*trackedStock);
+    }
   }
 }
\ No newline at end of file
@@ -20,6 +20,7 @@
 #include <QDateTime>
 #include <QHBoxLayout>  // Horizontal Box Layout
 #include <QRandomGenerator>
+#include <QSet>
 #include <QSettings>
 #include <QThread>
 #include <QVBoxLayout>  // Vertical Box Layout
@@ -32,12 +33,18 @@
 #include <QtCharts/QValueAxis>  // For value axis
 // Include our custom Stock class (Model)
 #include "autoscalechartview.hpp"
+#include "barcodec.hpp"
 #include "countdowntimer.hpp"
 #include "datamanager.hpp"
 #include "downloadprogress.hpp"
 #include "heatmappainter.hpp"
+#include "historycache.hpp"
+#include "historybulkloader.hpp"
+#include "historyimporter.hpp"
+#include "livebarbuilder.hpp"
 #include "stock.hpp"
 #include "stockdatafetcher.hpp"
+#include "symboltable.hpp"
 // Define our MainWindow class, inheriting from QMainWindow
 // Important: This macro brings QtCharts namespace into scope
 class MainWindow : public QMainWindow {
@@ -67,6 +74,7 @@ class MainWindow : public QMainWindow {
     // It takes a QListWidgetItem pointer as an argument, which is provided by the signal.
     void onStockListItemClicked(QListWidgetItem *item);
     void onStockSelectionChanged(int index);
+    void onRangeSelectionChanged(int index);
     void onSettingsButtonClicked();  // New slot for the settings button
     void onChartDataUpdated(const QList<QPair<qint64, double>> &historicalData);
     // You might also consider a slot for when a tab is changed, if needed
@@ -74,7 +82,9 @@ class MainWindow : public QMainWindow {
 
     // New slots to receive data from StockDataFetcher
     void onStockDataFetched(const Stock &stock);
-    void onHistoricalDataFetched(const QString &symbol, const QMap<time_record_t, HistoricalDataRecord> &historicalData);  // New slot
+    void onHistoricalDataFetched(const QString &symbol, const BarSeries &historicalData, const BarQualityReport &quality);
+    void onCoarseHistoryFetched(const QString &symbol, BarResolution resolution, const BarSeries &historicalData,
+                                const QList<CorporateAction> &actions);
     void onInvalidStockDataFetched(const QString &error);
     void onStockDataFetchError(const QString &symbol, const QString &errorString);
     void onRateLimitExceeded(const QString &message, qint64 remaining_time);
@@ -84,6 +94,15 @@ class MainWindow : public QMainWindow {
     void onDeleteStockFromDbClicked(const QString &symbol);
     void onDownloadStockClicked(const QString &symbol);
 
+    void onOlderHistoryRequested(qint64 oldestLoadedMSecs);  // Chart panned to the first loaded bar
+    void onHistoricalPageLoaded(const HistoricalPriceCursor &cursor, const BarSeries &page);
+    void onAdjustedHistoryReady(const QString &symbol, const BarSeries &adjusted);  // Second half of onHistoricalDataFetched
+    void onHistoricalRangeLoaded(const QString &symbol, time_record_t from, time_record_t to, qsizetype maxBars, BarResolution resolution,
+                                 const BarSeries &bars);
+    void onStockDeleted(const QString &symbol, bool deleted);
+    void onDatabaseOpened(bool opened, bool columnarStore, const QList<Stock> &stocks);  // The rest of the start-up
+    void onBulkHistoryLoaded(const QString &symbol, const BarSeries &historicalData, const HistoricalPriceCursor &cursor);
+
   private:
     // Declare pointers to our UI widgets.
     // We use pointers because we'll create these widgets dynamically (using 'new')
@@ -100,6 +119,7 @@ class MainWindow : public QMainWindow {
 
     QChartView *stockChartView;
     QComboBox  *stockSelector;
+    QComboBox  *rangeSelector;  // Paged 5min bars, or a range read in the resolution that fits the chart
     bool        hasOneStocksData;
 
     HeatmapPainter *heatmapWidget;  // New member for heatmap widget
@@ -113,23 +133,60 @@ class MainWindow : public QMainWindow {
     // Our new data fetcher instance
     StockDataFetcher *dataFetcher;
     QThread          *networkThread;
-    // Database manager
-    DatabaseManager *dbManager;
+    // Database manager, lives in storageThread
+    DatabaseManager   *dbManager;
+    QThread           *storageThread;
+    HistoryBulkLoader *historyLoader;    // Loads the stored history of all tracked stocks in parallel, once the database is open
+    HistoryImporter   *historyImporter;  // Bulk imports CSV/JSON history files into the database
     // This QList will hold our Stock objects. It represents the "data" part
     // of our Model for now, specifically the collection of tracked stocks.
     QList<Stock> trackedStocks;
+    // Index of each SymbolId's stock in trackedStocks (-1 when not tracked), and its row in stockListWidget
+    QList<qsizetype>                   stockSlots;
+    QHash<SymbolId, QListWidgetItem *> stockListItems;
 
     const QString DATABASE_FILE_PATH             = "stocks.db";   // SQLite database file name
+    const QString BAR_STORE_DIRECTORY            = "bars";        // Segment files of the optional columnar bar store
     const int     QUOTE_CACHE_LIFETIME_SECS      = 5 * 60;        // 5 minutes cache for current quotes
     const int     HISTORICAL_CACHE_LIFETIME_SECS = 24 * 60 * 60;  // 24 hours cache for historical data
 
+    const qsizetype HISTORY_PAGE_BARS = 2000;  // Bars loaded per page, the newest page first (about 10 days of 5min bars)
+
     bool historicalDataFetchedFromDB { false };
+    // Paging state of the stored history of each stock, and the stock currently on the chart
+    QHash<SymbolId, HistoricalPriceCursor> historyCursors;
+    QSet<SymbolId>                         pendingPages;  // Pages asked of the storage thread and not delivered yet
+    SymbolId                               chartedSymbol { INVALID_SYMBOL_ID };
+    // Histories of the stocks off the chart, kept compressed within a memory budget; the charted stock is pinned
+    HistoryCache historyCache;
+    // Bars built from the polled quotes since the last download, folded into a stock's history while it is decoded
+    LiveBarBuilder liveBars { StockDataFetcher::HISTORICAL_BAR_INTERVAL_SECS };
+    // Last daily or weekly download of each stock, they count against the same daily request limit. Kept in the settings
+    // beside rateLimits (by symbol, the ids are handed out anew each run) so a restart does not download them again
+    QHash<SymbolId, time_record_t> coarseFetchTimes;
+    // Last range view read of each stock, redrawn from here until its range, the chart's width or the stored bars change
+    struct ChartRange {
+        int           days {};
+        qsizetype     maxBars {};
+        BarResolution resolution { BarResolution::FiveMinutes };
+        BarSeries     bars;  // Empty until the storage thread delivers them
+    };
+    QHash<SymbolId, ChartRange> chartRanges;
     // Helper methods for managing the UI and data display.
     // These are regular private member functions.
-    void updateStockListDisplay();
+    void    updateStockListDisplay();
+    void    addStockListRow(const Stock &stock);
+    void    updateStockListRow(const Stock &stock);  // Rewrites the stock's row in place
+    QString stockListText(const Stock &stock) const;
     void displayStockDetails(const Stock &stock);
-    void updateChart(const Stock &stock);  // New private helper to draw/update chart
+    void updateChart(const Stock &stock, bool keepVisibleRange = false);  // New private helper to draw/update chart
     void updateHeatmap();                  // New helper to update the heatmap
+    void updateLiveCandle(const Stock &stock);  // Redraws the charted stock's last candle in place, appends it if new
+
+    // Chart range helpers, 0 days is the paged 5min view of the stock's own bars
+    int           chartRangeDays() const;
+    BarResolution chartResolution() const;  // What a range is drawn in, FiveMinutes for the paged view
+    BarSeries     loadChartRange(const Stock &stock, BarResolution &resolution);  // Empty until onHistoricalRangeLoaded has it
 
     void setupPlaceholderChart();
     void setupStockSelector();
@@ -142,7 +199,25 @@ class MainWindow : public QMainWindow {
     void loadAllHistoricalData();
     // void createPlaceholderData();
     void   statusMessage(const QString &message, qint64 duration);
+    Stock *findStock(SymbolId id);  // Constant time, nullptr if the stock is not tracked
     Stock *findStockBySymbol(const QString &symbol);
+
+    // Tracked stock bookkeeping, keeps stockSlots in step with trackedStocks
+    void addTrackedStock(const Stock &stock);
+    bool removeTrackedStock(SymbolId id);  // Also drops the stock's row, cursor and cached history
+    void rebuildStockSlots();              // After trackedStocks was replaced or reordered
+
+    // Storage thread helpers
+    void persistStock(const Stock &stock);
+    void persistHistoricalPrices(const QString &symbol, const BarSeries &historicalData);
+    void requestHistoricalPage(const HistoricalPriceCursor &cursor);  // Delivered to onHistoricalPageLoaded
+    void loadRecentHistoricalPrices(const Stock &stock);               // Newest page, starts the stock's cursor
+
+    // History cache helpers
+    void compactHistory(Stock &stock);          // Moves the stock's bars into historyCache and unpins it
+    void expandHistory(Stock &stock);           // Pins the stock and decodes its bars into it, reloads them if evicted
+    bool hasHistory(const Stock &stock) const;  // Loaded, or evicted from historyCache and reloadable
+    void foldLiveQuote(Stock &stock, time_record_t quoteTime);  // Into its live bar, and into the chart if it is on it
 };
 
 #endif  // MAINWINDOW_H
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "priceparser.hpp"
+#include <QByteArray>
+#include <QVarLengthArray>
+#include <cmath>
+
+namespace {
+  bool isDigit(char c) { return c >= '0' && c <= '9'; }
+}  // namespace
+
+// Plain decimals ("123.4567", "-0.5"): a mantissa of at most 15 digits divided by an exact power of ten is correctly
+// rounded, so this gives the same double as strtod; exponents and longer mantissas take the slow path.
+bool parseDecimal(const char *begin, const char *end, double &value) {
+  static const double POWERS_OF_TEN[] { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+  const char *p        = begin;
+  bool        negative = false;
+  if (p != end && (*p == '-' || *p == '+')) {
+    negative = *p++ == '-';
+  }
+  quint64 mantissa = 0;
+  int     digits = 0, fraction = 0;
+  bool    dot = false;
+  for (; p != end; ++p) {
+    if (isDigit(*p)) {
+      if (++digits > 15) {
+        break;
+      }
+      mantissa  = mantissa * 10 + quint64(*p - '0');
+      fraction += dot;
+    } else if (*p == '.' && !dot) {
+      dot = true;
+    } else {
+      break;
+    }
+  }
+  if (p != end || digits == 0) {
+    bool ok;
+    value = QByteArray::fromRawData(begin, end - begin).toDouble(&ok);
+    return ok && std::isfinite(value);
+  }
+  value = double(mantissa) / POWERS_OF_TEN[fraction];
+  value = negative ? -value : value;
+  return true;
+}
+
+bool parsePriceTicks(const char *begin, const char *end, qint64 &ticks) {
+  const char *p        = begin;
+  bool        negative = false;
+  if (p != end && (*p == '-' || *p == '+')) {
+    negative = *p++ == '-';
+  }
+  qint64 units = 0;
+  int    digits = 0;
+  for (; p != end && isDigit(*p) && digits < 14; ++p, ++digits) {
+    units = units * 10 + (*p - '0');
+  }
+  qint64 fraction = 0, scale = PRICE_TICKS_PER_UNIT;
+  bool   roundUp = false;
+  if (p != end && *p == '.') {
+    for (++p; p != end && isDigit(*p); ++p, ++digits) {
+      if (scale > 1) {
+        scale    /= 10;
+        fraction += (*p - '0') * scale;
+      } else if (scale == 1) {
+        roundUp = *p >= '5';  // First digit past the tick decides, the rest is ignored
+        scale   = 0;
+      }
+    }
+  }
+  if (p != end || digits == 0) {
+    double value;  // Exponents, 15+ integer digits
+    if (!parseDecimal(begin, end, value) || std::abs(value) > 1e14) {
+      return false;
+    }
+    ticks = std::llround(value * PRICE_TICKS_PER_UNIT);
+    return true;
+  }
+  const qint64 value = units * PRICE_TICKS_PER_UNIT + fraction + roundUp;
+  ticks              = negative ? -value : value;
+  return true;
+}
+
+bool parsePrice(const char *begin, const char *end, price_t &price) {
+#ifdef STOCKTRACKER_FIXED_POINT_PRICES
+  qint64 ticks;
+  if (!parsePriceTicks(begin, end, ticks)) {
+    return false;
+  }
+  price = FixedPrice::fromTicks(ticks);
+  return true;
+#else
+  return parseDecimal(begin, end, price);
+#endif
+}
+
+bool parsePrice(QStringView text, price_t &price) {
+  QVarLengthArray<char, 32> latin(text.size());  // Narrowed on the stack, prices are short
+  for (qsizetype i = 0; i < text.size(); ++i) {
+    const char16_t c = text[i].unicode();
+    if (c > 0x7f) {
+      return false;
+    }
+    latin[i] = char(c);
+  }
+  return parsePrice(latin.constData(), latin.constData() + latin.size(), price);
+}
@@ -0,0 +1,21 @@
+#ifndef _PRICE_PARSER_HEADER_
+#define _PRICE_PARSER_HEADER_
+
+#include <QStringView>
+
+#include "global.hpp"
+
+// Number parsing for the hot paths (CSV import, Alpha Vantage time series), without locale lookups or allocations.
+// Every function returns false on malformed or non-finite input and leaves the value unspecified.
+
+// Decimal or scientific notation, gives the same double as strtod
+bool parseDecimal(const char *begin, const char *end, double &value);
+// Price ticks of 1 / PRICE_TICKS_PER_UNIT, rounded half away from zero past the fourth decimal. Plain decimals never go
+// through a double, so "101.1" is exactly 1011000 ticks
+bool parsePriceTicks(const char *begin, const char *end, qint64 &ticks);
+
+// Parses into price_t: straight to ticks in a fixed-point build, to a double otherwise
+bool parsePrice(const char *begin, const char *end, price_t &price);
+bool parsePrice(QStringView text, price_t &price);  // JSON string values, ASCII only
+
+#endif
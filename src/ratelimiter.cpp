@@ -0,0 +1,189 @@
+#include "ratelimiter.hpp"
+#include <QDebug>
+#include <algorithm>
+
+void RateLimiter::setRules(const QString &provider, const QList<Rule> &providerRules, const QString &apiKey) {
+  rules.insert(apiKey.isEmpty() ? provider : budgetKey(provider, apiKey), providerRules);
+}
+
+const QList<RateLimiter::Rule> &RateLimiter::rulesOf(const QString &provider, const QString &apiKey) const {
+  static const QList<Rule> none;
+  auto                     it = rules.constFind(budgetKey(provider, apiKey));
+  if (it == rules.constEnd()) {
+    it = rules.constFind(provider);
+  }
+  return it != rules.constEnd() ? it.value() : none;
+}
+
+QList<RateLimiter::State> RateLimiter::current(const QString &key, const QList<Rule> &budgetRules, qint64 now) const {
+  QList<State> budget  = states.value(key);
+  bool         matches = budget.size() == budgetRules.size();
+  for (qsizetype i = 0; matches && i < budget.size(); ++i) {
+    const State &state = budget.at(i);
+    const Rule  &rule  = budgetRules.at(i);
+    matches            = state.kind == rule.kind && state.capacity == rule.capacity && state.periodMs == rule.periodMs;
+  }
+  if (!matches) {
+    budget.clear();
+    for (const Rule &rule : budgetRules) {
+      State state;
+      state.kind     = rule.kind;
+      state.capacity = rule.capacity;
+      state.periodMs = rule.periodMs;
+      state.credit   = rule.capacity * rule.periodMs;  // Full bucket
+      state.updated  = now;
+      budget.append(state);
+    }
+    return budget;
+  }
+  for (qsizetype i = 0; i < budget.size(); ++i) {
+    const Rule &rule  = budgetRules.at(i);
+    State      &state = budget[i];
+    if (rule.kind == Rule::TokenBucket) {
+      const qint64 full = rule.capacity * rule.periodMs;
+      if (now > state.updated) {
+        state.credit  += qMin(now - state.updated, full) * qMax(rule.refill, qint64(0));  // Longer than full takes is full
+        state.updated  = now;
+      }
+      state.credit = qMin(state.credit, full);
+    } else {
+      qsizetype expired = 0;
+      while (expired < state.grants.size() && state.grants.at(expired) + rule.periodMs <= now) {
+        expired++;
+      }
+      state.grants.remove(0, expired);
+    }
+  }
+  return budget;
+}
+
+qint64 RateLimiter::wait(const Rule &rule, const State &state, qint64 permits, qint64 now) {
+  if (permits > rule.capacity) {
+    return -1;
+  }
+  if (rule.kind == Rule::TokenBucket) {
+    const qint64 missing = permits * rule.periodMs - state.credit;
+    if (missing <= 0) {
+      return 0;
+    }
+    return rule.refill > 0 ? (missing + rule.refill - 1) / rule.refill : -1;
+  }
+  // The window admits them once enough of the oldest requests have left it
+  const qsizetype excess = state.grants.size() + permits - rule.capacity;
+  return excess > 0 ? state.grants.at(excess - 1) + rule.periodMs - now : 0;
+}
+
+qint64 RateLimiter::timeToNext(const QString &provider, const QString &apiKey, qint64 permits, qint64 now) const {
+  const QList<Rule> &budgetRules = rulesOf(provider, apiKey);
+  const QList<State> budget      = current(budgetKey(provider, apiKey), budgetRules, now);
+  qint64             longest     = 0;  // The rules are independent, all of them are met once the slowest is
+  for (qsizetype i = 0; i < budget.size(); ++i) {
+    const qint64 next = wait(budgetRules.at(i), budget.at(i), permits, now);
+    if (next < 0) {
+      return -1;
+    }
+    longest = qMax(longest, next);
+  }
+  return longest;
+}
+
+bool RateLimiter::tryAcquire(const QString &provider, const QString &apiKey, qint64 permits, qint64 now) {
+  const QList<Rule> &budgetRules = rulesOf(provider, apiKey);
+  if (budgetRules.isEmpty()) {
+    return true;
+  }
+  const QString key    = budgetKey(provider, apiKey);
+  QList<State>  budget = current(key, budgetRules, now);
+  for (qsizetype i = 0; i < budget.size(); ++i) {
+    if (wait(budgetRules.at(i), budget.at(i), permits, now) != 0) {
+      return false;
+    }
+  }
+  for (qsizetype i = 0; i < budget.size(); ++i) {
+    State &state = budget[i];
+    if (state.kind == Rule::TokenBucket) {
+      state.credit -= permits * budgetRules.at(i).periodMs;
+    } else {
+      const qint64 at = state.grants.isEmpty() ? now : qMax(now, state.grants.last());  // Stays sorted if the clock went back
+      state.grants.insert(state.grants.size(), permits, at);
+    }
+  }
+  states.insert(key, budget);
+  return true;
+}
+
+void RateLimiter::addGrants(const QString &provider, const QString &apiKey, const QList<qint64> &times) {
+  const QList<Rule> &budgetRules = rulesOf(provider, apiKey);
+  const QString      key         = budgetKey(provider, apiKey);
+  const qint64       now         = currentTime();
+  QList<State>       budget      = current(key, budgetRules, now);
+  for (qsizetype i = 0; i < budget.size(); ++i) {
+    State &state = budget[i];
+    if (state.kind != Rule::SlidingWindow) {
+      continue;
+    }
+    for (const qint64 time : times) {
+      if (time + budgetRules.at(i).periodMs > now) {
+        state.grants.append(time);
+      }
+    }
+    std::sort(state.grants.begin(), state.grants.end());
+  }
+  states.insert(key, budget);
+}
+
+QVariantMap RateLimiter::save(qint64 now) const {
+  QVariantMap saved;
+  for (auto it = states.constBegin(); it != states.constEnd(); ++it) {
+    const QString provider = it.key().section(':', 0, 0);
+    const QString apiKey   = it.key().mid(provider.size() + 1);
+    QVariantList  budget;
+    for (const State &state : current(it.key(), rulesOf(provider, apiKey), now)) {
+      QVariantList fields { int(state.kind), state.capacity, state.periodMs };
+      if (state.kind == Rule::TokenBucket) {
+        fields << state.credit << state.updated;
+      } else {
+        for (const qint64 time : state.grants) {
+          fields << time;
+        }
+      }
+      budget.append(QVariant(fields));
+    }
+    if (!budget.isEmpty()) {
+      saved.insert(it.key(), budget);
+    }
+  }
+  return saved;
+}
+
+void RateLimiter::restore(const QVariantMap &saved) {
+  for (auto it = saved.constBegin(); it != saved.constEnd(); ++it) {
+    QList<State> budget;
+    bool         valid = true;
+    for (const QVariant &entry : it.value().toList()) {
+      const QVariantList fields = entry.toList();
+      State              state;
+      state.kind     = Rule::Kind(fields.value(0, -1).toInt());
+      state.capacity = fields.value(1).toLongLong();
+      state.periodMs = fields.value(2).toLongLong();
+      if (state.kind == Rule::TokenBucket && fields.size() == 5) {
+        state.credit  = fields.at(3).toLongLong();
+        state.updated = fields.at(4).toLongLong();
+      } else if (state.kind == Rule::SlidingWindow && fields.size() >= 3) {
+        for (qsizetype i = 3; i < fields.size(); ++i) {
+          state.grants.append(fields.at(i).toLongLong());
+        }
+        std::sort(state.grants.begin(), state.grants.end());
+      } else {
+        valid = false;
+        break;
+      }
+      budget.append(state);
+    }
+    if (valid && !budget.isEmpty()) {
+      states.insert(it.key(), budget);  // Checked against the rules when used, see current
+    } else {
+      qWarning() << "Dropping the saved request budget" << it.key().section(':', 0, 0) << ", it is malformed";
+    }
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef _RATE_LIMITER_HEADER_
+#define _RATE_LIMITER_HEADER_
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVariantMap>
+
+// Request budgets of the data providers, one per provider and API key (a new key starts with a full budget). A provider has
+// one or more rules and a request takes its permits from all of them: token buckets, a burst refilled at a steady rate, and
+// sliding windows, at most so many requests in any window (the "25 a day" kind). Times are milliseconds since the epoch, now
+// defaults to the clock. Waits are exact, the time the permits become available, not a polling interval.
+// Not thread-safe, the fetcher only uses it on the network thread.
+class RateLimiter {
+  public:
+    struct Rule {
+        enum Kind { TokenBucket, SlidingWindow };
+
+        Kind   kind;
+        qint64 capacity;  // Burst of the bucket, requests per window
+        qint64 refill;    // Bucket only: permits added back every periodMs
+        qint64 periodMs;  // Refill period of the bucket, length of the window
+
+        static Rule tokenBucket(qint64 burst, qint64 permits, qint64 periodMs) { return { TokenBucket, burst, permits, periodMs }; }
+        static Rule slidingWindow(qint64 requests, qint64 windowMs) { return { SlidingWindow, requests, 0, windowMs }; }
+    };
+
+    // Rules of a provider, or of one of its keys when apiKey is given (a paid key with a bigger allowance). No rules, no limit
+    void setRules(const QString &provider, const QList<Rule> &providerRules, const QString &apiKey = QString());
+
+    // Takes the permits if every rule has them now, false and nothing taken otherwise
+    bool   tryAcquire(const QString &provider, const QString &apiKey, qint64 permits = 1, qint64 now = currentTime());
+    // Milliseconds until tryAcquire would succeed, 0 if it would now, -1 never (more permits than a rule holds)
+    qint64 timeToNext(const QString &provider, const QString &apiKey, qint64 permits = 1, qint64 now = currentTime()) const;
+
+    // Counts requests made at the given times against the sliding windows, requests tracked elsewhere before
+    void addGrants(const QString &provider, const QString &apiKey, const QList<qint64> &times);
+
+    // The used budgets as a QSettings value, and back. Budgets of rules that changed since are dropped
+    QVariantMap save(qint64 now = currentTime()) const;
+    void        restore(const QVariantMap &saved);
+
+    static qint64 currentTime() { return QDateTime::currentMSecsSinceEpoch(); }
+
+  private:
+    // Bucket credit is kept in permit-milliseconds: a permit is periodMs of it and refill comes in every millisecond, so
+    // refilling and the wait for the next permit are exact in integers
+    struct State {
+        Rule::Kind    kind { Rule::TokenBucket };
+        qint64        capacity {};  // Of the rule the state was made for, a state of another rule is dropped
+        qint64        periodMs {};  // Same, credit and grants only mean something with the period they were counted in
+        qint64        credit {};    // Bucket only
+        qint64        updated {};   // Time credit was worked out at
+        QList<qint64> grants;       // Window only: times of the requests still in it, oldest first
+    };
+
+    QHash<QString, QList<Rule>>  rules;   // By provider, or by budgetKey for a key of its own
+    QHash<QString, QList<State>> states;  // By budgetKey, created on the first request
+
+    static QString budgetKey(const QString &provider, const QString &apiKey) { return provider + ':' + apiKey; }
+    const QList<Rule> &rulesOf(const QString &provider, const QString &apiKey) const;
+    // The states of a budget at now: buckets refilled, expired grants gone, fresh ones if there are none or the rules changed
+    QList<State> current(const QString &key, const QList<Rule> &budgetRules, qint64 now) const;
+    static qint64 wait(const Rule &rule, const State &state, qint64 permits, qint64 now);
+};
+
+#endif
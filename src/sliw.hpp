@@ -17,6 +17,7 @@ class StockListItemWidget : public QWidget {
     ~StockListItemWidget();
 
     const QString &getSymbol() const { return symbol; }
+    void           setDisplayText(const QString &displayText) { stockLabel->setText(displayText); }
   signals:
     // Signal emitted when the "Remove from RAM" button is clicked
     void removeClicked(const QString &symbol);
@@ -2,9 +2,37 @@
 
 Stock::Stock(QString symbol, QString symbol_name, price_t current_price, price_t price_change, price_t day_high, price_t day_low,
              price_t day_open, price_t prev_close, time_record_t time_quote, time_record_t time_historical):
-    symbol(symbol), name(symbol_name), currentPrice(current_price), priceChange(price_change), lastUpdatedQuote(time_quote),
-    lastUpdatedHistorical(time_historical), dayStats({ day_high, day_low, day_open, prev_close, 0 }), historicalPrices() { }
+    symbol(symbol), symbolId(SymbolTable::instance().intern(symbol)), name(symbol_name), currentPrice(current_price), priceChange(price_change), lastUpdatedQuote(time_quote),
+    lastUpdatedHistorical(time_historical), dayStats({ day_high, day_low, day_open, prev_close, 0 }) { }
 
-Stock::Stock(QString symbol): symbol(symbol), dayStats({ 0.0, 0.0, 0.0, 0.0, 0 }) { }
+Stock::Stock(QString symbol): symbol(symbol), symbolId(SymbolTable::instance().intern(symbol)), dayStats({ 0.0, 0.0, 0.0, 0.0, 0 }) { }
 
 Stock::Stock(): dayStats({ 0.0, 0.0, 0.0, 0.0, 0 }) { }
+
+const BarSeries &Stock::getHistoricalPrices() const {
+  static const BarSeries empty;
+  return historicalPrices ? *historicalPrices : empty;
+}
+
+void Stock::setHistoricalPrices(const BarSeries &prices) {
+  historicalPrices = prices.isEmpty() ? HistoryHandle() : HistoryHandle(new BarSeries(prices));
+}
+
+// Holders of the old handle keep their snapshot. The copy shares the columns, only the merge detaches them
+void Stock::mergeHistoricalPrices(const BarSeries &prices) {
+  if (prices.isEmpty()) {
+    return;
+  }
+  BarSeries merged = getHistoricalPrices();
+  merged.merge(prices);
+  historicalPrices = HistoryHandle(new BarSeries(merged));
+}
+
+// Called for every live quote. The old handle is released before the change, so unless a snapshot still holds it the
+// columns are no longer shared and the bar is written in place instead of copying the whole history
+void Stock::updateHistoricalBar(time_record_t time, const HistoricalDataRecord &bar) {
+  BarSeries updated = getHistoricalPrices();
+  historicalPrices.reset();
+  updated.insert(time, bar);
+  historicalPrices = HistoryHandle(new BarSeries(updated));
+}
@@ -2,22 +2,22 @@
 #define _STOCKTICKER_STOCK_HEADER_
 
 #include <QDate>
-#include <QMap>
+#include <QSharedPointer>
 #include <QString>
+#include "barseries.hpp"
+#include "barvalidator.hpp"
 #include "global.hpp"
-
-struct HistoricalDataRecord {
-    price_t  high {};
-    price_t  low {};
-    price_t  open {};
-    price_t  close {};
-    volume_t volume {};
-    HistoricalDataRecord(price_t open, price_t high, price_t low, price_t close, volume_t volume):
-        high(high), low(low), open(open), close(close), volume(volume) { }
-};
+#include "stockstatistics.hpp"
+#include "symboltable.hpp"
 
 class Stock {
+    // The bars behind one reference count, so copying a Stock (quotes queued to the storage thread, list copies) does not
+    // touch the six shared columns. Never modified once created: a change builds a new series and swaps the pointer.
+    // Elsewhere the bars travel as BarSeries, whose columns are implicitly shared, so signals and caches copy no bars either
+    using HistoryHandle = QSharedPointer<const BarSeries>;
+
     QString              symbol;
+    SymbolId             symbolId { INVALID_SYMBOL_ID };  // Interned once here, everything keyed by symbol uses it
     QString              name;
     price_t              currentPrice;
     price_t              priceChange;
@@ -25,10 +25,13 @@ class Stock {
     time_record_t        lastUpdatedHistorical;  // seconds since epoch
     HistoricalDataRecord dayStats;
     // QList<HistoricalData> candleData;????
-    QMap<time_record_t, HistoricalDataRecord> historicalPrices;  // Key is seconds since epoch
+    HistoryHandle        historicalPrices;  // Timestamps are seconds since epoch, null when nothing is loaded
+    quint32              historyQuality { BarQualityReport::Clean };  // BarQualityReport flags of every batch ingested
+    StockStatistics      statistics;  // Of the stored history, maintained by the DatabaseManager as bars are merged
 
   public:
     const QString&                                   getSymbol() const { return symbol; }
+    SymbolId                                         getSymbolId() const { return symbolId; }
     const QString&                                   getName() const { return name; }
     price_t                                          getCurrentPrice() const { return currentPrice; }
     price_t                                          getPriceChange() const { return priceChange; }
@@ -36,17 +39,24 @@ class Stock {
     price_t                                          getDayLow() const { return dayStats.low; }
     price_t                                          getDayOpen() const { return dayStats.open; }
     price_t                                          getDayClose() const { return dayStats.close; }
-    const QMap<time_record_t, HistoricalDataRecord>& getHistoricalPrices() const { return historicalPrices; }  // New getter
+    const BarSeries&                                 getHistoricalPrices() const;  // Empty series when nothing is loaded
     time_record_t                                    getLastQuoteFetchTime() const { return lastUpdatedQuote; }
     time_record_t                                    getLastHistoricalFetchTime() const { return lastUpdatedHistorical; }
     HistoricalDataRecord                             getDayStats() const { return dayStats; }
+    quint32                                          getHistoryQuality() const { return historyQuality; }
+    const StockStatistics&                           getStatistics() const { return statistics; }
 
     void setCurrentPrice(price_t price) { currentPrice = price; }
     void setPriceChange(price_t price_change) { priceChange = price_change; }
-    void setHistoricalPrices(const QMap<time_record_t, HistoricalDataRecord>& prices) { historicalPrices = prices; }  // New setter
+    void setHistoricalPrices(const BarSeries& prices);
+    void mergeHistoricalPrices(const BarSeries& prices);  // Newer wins, into a new series
+    void updateHistoricalBar(time_record_t time, const HistoricalDataRecord& bar);  // Replaces or appends one bar, into a new series
+    void clearHistoricalPrices() { historicalPrices.reset(); }
+    void addHistoryQuality(quint32 flags) { historyQuality |= flags; }
     void setLastQuoteFetchTime(time_record_t time) { lastUpdatedQuote = time; }
     void setLastHistoricalFetchTime(time_record_t time) { lastUpdatedHistorical = time; }
     void setDayStats(HistoricalDataRecord record) { dayStats = record; }
+    void setStatistics(const StockStatistics& stored) { statistics = stored; }
     Stock(QString symbol, QString symbol_name, price_t current_price, price_t price_change, price_t day_high, price_t day_low,
           price_t day_open, price_t prev_close, time_record_t time_quote, time_record_t time_historical = 0);
     Stock(QString symbol);
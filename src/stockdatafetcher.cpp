@@ -1,6 +1,7 @@
 // src/stockdatafetcher.cpp
 
 #include "stockdatafetcher.hpp"
+#include "timeseriesparser.hpp"
 #include <QApplication>
 #include <QDir>
 #include <QEventLoop>
@@ -11,24 +12,30 @@ constexpr qint64 MAX_LIMIT_TIMER { 60'000 };
 // Constructor
 StockDataFetcher::StockDataFetcher(QObject *parent):
     QObject(parent), manager(nullptr), networkReplies(),  // 'this' sets StockDataFetcher as parent, handles deletion
-    symbolRequestTimer(nullptr), isFetchingSymbol(false) {
+    symbolRequestTimer(nullptr) {
   // Connect the finished signal of the manager to our slot
+  parsePool.setMaxThreadCount(qMax(2, QThread::idealThreadCount() / 2));  // Replies arrive a few at a time
+  // Windows, not buckets: a bucket lets its burst and a period of refill through in the same minute. A whole minute's
+  // allowance of quotes can go out at startup, in two bursts a second apart
+  limiter.setRules(QUOTE_PROVIDER, { RateLimiter::Rule::slidingWindow(QUOTE_REQUESTS_PER_MINUTE, 60'000),
+                                     RateLimiter::Rule::slidingWindow(QUOTE_REQUESTS_PER_SECOND, 1'000) });
+  limiter.setRules(HISTORICAL_PROVIDER, { RateLimiter::Rule::slidingWindow(HISTORICAL_REQUESTS_PER_DAY, 24 * 3600 * 1000) });
 }
 void StockDataFetcher::initialize() {
   manager            = new QNetworkAccessManager(this);
   symbolRequestTimer = new QTimer(this);
+  symbolRequestTimer->setSingleShot(true);
   connect(manager, &QNetworkAccessManager::finished, this, &StockDataFetcher::onNetworkReplyFinished);
   // Connect timer timeout to our slot to process the queue
   connect(symbolRequestTimer, &QTimer::timeout, this, &StockDataFetcher::requestSymbolSlot);
   // connect(historicalRequestTimer, &QTimer::timeout, this, &StockDataFetcher::requestHistoricalSlot);
   // Start the timer, it will trigger processNextRequest every REQUEST_INTERVAL_MS
   // historicalRequestTimer->start(HISTORICAL_REQUEST_INTERVAL_MS);
-
-  // Move timer to the new thread
-  symbolRequestTimer->start(SYMBOL_REQUEST_INTERVAL_MS);
 }
 
 StockDataFetcher::~StockDataFetcher() {
+  parsePool.clear();  // Parsers emit through this object, let the running ones finish before it goes
+  parsePool.waitForDone();
   qDebug() << "StockDataFetcher destroyed.";
   // manager is deleted automatically because it has 'this' as parent.
 }
@@ -44,26 +51,31 @@ void StockDataFetcher::fetchStockData(const QString &symbol) {
     emit fetchError(symbol, "Stock symbol cannot be empty.");
     return;
   }
-  if (symbolQueue.contains(symbol)) {
+  const SymbolId id = SymbolTable::instance().intern(symbol);
+  if (queuedQuotes.contains(id)) {
     qDebug() << "Symbol" << symbol << "already in queue.";
     return;  // Don't add duplicates to the queue if already pending
   }
-  symbolQueue.enqueue(symbol);
+  symbolQueue.enqueue(id);
+  queuedQuotes.insert(id);
   qDebug() << "Enqueued symbol:" << symbol << ". Queue size:" << symbolQueue.size();
-  // If not currently fetching, immediately try to process the next request
-  // This allows the first request to go out without waiting for the timer,
-  // and subsequent ones will be rate-limited.
-  if (!isFetchingSymbol) {
+  // Unless the timer waits for the next permit, the request goes out right away if the budget allows it
+  if (!symbolRequestTimer->isActive()) {
     processNextRequestSymbol();
   }
 }
-void StockDataFetcher::fetchHistoricalData(const QString &symbol) {
+void StockDataFetcher::fetchHistoricalData(const QString &symbol, BarResolution resolution) {
   if (symbol.isEmpty()) {
     emit fetchError(symbol, "Stock symbol cannot be empty.");
     return;
   }
-  if (!historicalQueue.contains(symbol)) {
-    historicalQueue.enqueue(symbol);
+  if (resolution == BarResolution::Hourly) {
+    resolution = BarResolution::FiveMinutes;  // Hourly bars are only rolled up from 5min ones
+  }
+  const SymbolId id = SymbolTable::instance().intern(symbol);
+  if (!queuedHistorical.contains({ id, int(resolution) })) {
+    historicalQueue.enqueue({ id, resolution });
+    queuedHistorical.insert({ id, int(resolution) });
     qDebug() << "Enqueued symbol:" << symbol << ". Queue size:" << symbolQueue.size();
   } else {
     qDebug() << "Symbol" << symbol << "already in queue.";
@@ -78,7 +90,6 @@ void StockDataFetcher::fetchHistoricalData(const QString &symbol) {
   // }
 }
 void StockDataFetcher::requestSymbolSlot() {
-  isFetchingSymbol = false;
   processNextRequestSymbol();
 }
 void StockDataFetcher::requestHistoricalSlot() {
@@ -92,9 +103,15 @@ void StockDataFetcher::processNextRequestSymbol() {
     // m_requestTimer->stop();
     return;
   }
+  if (!limiter.tryAcquire(QUOTE_PROVIDER, apiKeyQuote)) {
+    const qint64 wait = limiter.timeToNext(QUOTE_PROVIDER, apiKeyQuote);  // Exact, the timer fires when the permit is there
+    symbolRequestTimer->start(wait < 0 ? MAX_LIMIT_TIMER : qBound(qint64(1), wait, MAX_LIMIT_TIMER));
+    return;
+  }
 
-  QString symbolToFetch = symbolQueue.dequeue();  // Get the next symbol from the queue
-  isFetchingSymbol      = true;
+  const SymbolId id = symbolQueue.dequeue();  // Get the next symbol from the queue
+  queuedQuotes.remove(id);
+  QString symbolToFetch = SymbolTable::instance().symbol(id);
 
   QString downloadId  = generateDownloadId(symbolToFetch, QuoteRequest);
   QString description = QString("Quote: %1").arg(symbolToFetch);
@@ -125,7 +142,10 @@ void StockDataFetcher::processNextRequestSymbol() {
 
   emit downloadStarted(downloadId, description);
 
-  symbolRequestTimer->start(SYMBOL_REQUEST_INTERVAL_MS);
+  if (!symbolQueue.isEmpty()) {
+    // As many as the budget allows go out now, then one whenever a permit frees up
+    processNextRequestSymbol();
+  }
 }
 // New slot to process requests from the queue
 void StockDataFetcher::processNextRequestHistorical() {
@@ -134,42 +154,71 @@ void StockDataFetcher::processNextRequestHistorical() {
     qDebug() << "This should not happen (processNextRequestHistorical)";
     return;
   }
-  time_record_t elapsed_time { (QDateTime::currentSecsSinceEpoch() - lastHistoricalRequests[earliestRequest]) };
-  if (elapsed_time <= HISTORICAL_REQUESTS_INTERVAL) {
-    time_record_t remaining_time { (HISTORICAL_REQUESTS_INTERVAL - elapsed_time) };
+  if (!limiter.tryAcquire(HISTORICAL_PROVIDER, apiKeyHistorical)) {
+    time_record_t remaining_time { getTimeToNextRequest() };
 
     // Notify in some way, bottom right or left with countdown
     const qint64 hours { remaining_time / 3600 }, minutes { (remaining_time - hours * 3600) / 60 },
       seconds { remaining_time - hours * 3600 - minutes * 60 };
     emit requestRateLimitExceeded(
-      QString("Requested historical data beyond the limit of %1 requests per %2 seconds interval. Time to next "
-              "request: %3 hours %4 minutes and %5 seconds.")
-        .arg(QString::number(MAX_HISTORICAL_REQUESTS_PER_INTERVAL), QString::number(HISTORICAL_REQUESTS_INTERVAL), QString::number(hours),
-             QString::number(minutes), QString::number(seconds)),
+      QString("Requested historical data beyond the limit of %1 requests per day. Time to next "
+              "request: %2 hours %3 minutes and %4 seconds.")
+        .arg(QString::number(HISTORICAL_REQUESTS_PER_DAY), QString::number(hours), QString::number(minutes), QString::number(seconds)),
       remaining_time);
     return;
   }
-  QString symbol = historicalQueue.dequeue();  // Get the next symbol from the queue
+  const auto [id, resolution] = historicalQueue.dequeue();  // Get the next symbol from the queue
+  queuedHistorical.remove({ id, int(resolution) });
+  QString symbol = SymbolTable::instance().symbol(id);
   // Generate unique download ID
-  QString downloadId  = generateDownloadId(symbol, HistoricalRequest);
+  QString downloadId  = generateDownloadId(symbol, HistoricalRequest, resolution);
   QString description = QString("Historical: %1").arg(symbol);
-  // Use a dummy URL for now. The actual data parsing will be mocked in onNetworkReplyFinished.
-  QUrl url(QString("https://www.alphavantage.co/query?function=TIME_SERIES_INTRADAY&interval=5min&symbol=%1&apikey=%2&outputsize=full")
+  // Unadjusted bars: the database keeps prices as traded and applies splits and dividends when reading them back.
+  // The adjusted daily and weekly series have the traded prices too, next to the adjusted close that is not used
+  QUrl url(QString("https://www.alphavantage.co/query?function=TIME_SERIES_INTRADAY&interval=5min&symbol=%1&apikey=%2&outputsize=full"
+                   "&adjusted=false")
              .arg(symbol, apiKeyHistorical));
+  if (resolution == BarResolution::Daily) {
+    description = QString("Daily history: %1").arg(symbol);
+    url         = QUrl(
+      QString("https://www.alphavantage.co/query?function=TIME_SERIES_DAILY_ADJUSTED&symbol=%1&apikey=%2&outputsize=full")
+        .arg(symbol, apiKeyHistorical));
+  } else if (resolution == BarResolution::Weekly) {
+    description = QString("Weekly history: %1").arg(symbol);
+    url         = QUrl(QString("https://www.alphavantage.co/query?function=TIME_SERIES_WEEKLY_ADJUSTED&symbol=%1&apikey=%2")
+                         .arg(symbol, apiKeyHistorical));
+  }
   qDebug() << "Requesting data for:" << symbol << "from" << url.toString();
   QNetworkRequest request(url);
   // You might add specific headers if your API requires them, e.g.:
   // request.setRawHeader("X-API-KEY", m_apiKey.toUtf8());
   request.setAttribute(RequestTypeAttributeId, QVariant::fromValue(RequestType::HistoricalRequest));
   request.setAttribute(DownloadIdAttribute, downloadId);  // Store download ID in request
+  request.setAttribute(ResolutionAttributeId, int(resolution));
   // request.setAttribute(NoDaysHistoricRequest, QVariant::fromValue(historicalToFetch.second));
 
   QNetworkReply *reply = manager->get(request);
 
+  // Parsed as the bytes arrive, so the bars are ready right after the last one instead of a full parse later
+  HistoricalStreamPtr stream = HistoricalStreamPtr::create();
+  stream->symbol             = symbol;
+  stream->resolution         = resolution;
+  connect(reply, &QNetworkReply::readyRead, this, [this, reply, stream]() {
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 200) {
+      if (!stream->sized) {  // Nothing was queued yet, so no task holds the parser
+        const QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+        stream->parser.reset(length.isValid() ? length.toLongLong() : -1);
+        stream->sized = true;
+      }
+      queuePiece(stream, reply->readAll(), false);  // Error bodies are left for onNetworkReplyFinished to report
+    }
+  });
+
   // Store download info
   DownloadInfo downloadInfo;
   downloadInfo.description = description;
   downloadInfo.downloadId  = downloadId;
+  downloadInfo.stream      = stream;
   networkReplies[reply]    = downloadInfo;
   // Connect progress tracking
   connect(reply, &QNetworkReply::downloadProgress, this, [this, downloadId](qint64 received, qint64 total) {
@@ -184,24 +233,28 @@ void StockDataFetcher::processNextRequestHistorical() {
   // Emit download started
   emit downloadStarted(downloadId, description);
 
-  lastHistoricalRequests[earliestRequest] = QDateTime::currentSecsSinceEpoch();
-  earliestRequest                         = (earliestRequest + 1) % MAX_HISTORICAL_REQUESTS_PER_INTERVAL;
   if (!historicalQueue.isEmpty()) {
     // In case multiple were queued
     processNextRequestHistorical();
   }
   // historicalRequestTimer->start(HISTORICAL_REQUEST_INTERVAL_MS);
 }
-QString StockDataFetcher::generateDownloadId(const QString &symbol, RequestType type) {
-  return QString("%1_%2").arg(symbol).arg(type == QuoteRequest ? "q" : "h");
+QString StockDataFetcher::generateDownloadId(const QString &symbol, RequestType type, BarResolution resolution) {
+  const char *suffix = type == QuoteRequest                   ? "q"
+                     : resolution == BarResolution::Daily  ? "hd"
+                     : resolution == BarResolution::Weekly ? "hw"
+                                                           : "h";
+  return QString("%1_%2").arg(symbol).arg(suffix);
 }
 // Slot to handle the network reply when it's finished
 void StockDataFetcher::onNetworkReplyFinished(QNetworkReply *reply) {
-  QString downloadId;
+  QString             downloadId;
+  HistoricalStreamPtr stream;
 
   // Get download ID from the reply
   if (networkReplies.contains(reply)) {
     downloadId = networkReplies[reply].downloadId;
+    stream     = networkReplies[reply].stream;
     networkReplies.remove(reply);  // Clean up
   } else {
     // Fallback - extract from request attribute
@@ -218,6 +271,14 @@ void StockDataFetcher::onNetworkReplyFinished(QNetworkReply *reply) {
   QVariant    statusCode         = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
   QVariant    requestTypeVariant = reply->request().attribute(RequestTypeAttributeId);
   RequestType requestType        = static_cast<RequestType>(requestTypeVariant.toInt());
+  const auto  resolution         = BarResolution(reply->request().attribute(ResolutionAttributeId).toInt());  // 0, 5min, if unset
+
+  const bool succeeded = reply->error() == QNetworkReply::NoError && (!statusCode.isValid() || statusCode.toInt() == 200);
+  if (stream && !succeeded) {
+    QMutexLocker locker(&stream->mutex);
+    stream->cancelled = true;  // The pieces parsed so far are dropped with it
+    stream->pieces.clear();
+  }
 
   if (reply->error() != QNetworkReply::NoError) {
     // Handle network errors (e.g., no internet, host not found, 404, etc.)
@@ -237,90 +298,138 @@ void StockDataFetcher::onNetworkReplyFinished(QNetworkReply *reply) {
     qWarning() << errorMsg;
     emit downloadError(downloadId, errorMsg);
     if (httpStatus == 429) {
-      // This should never happen with the timers setup
+      // This should never happen with the limiter setup
       // emit requestRateLimitExceeded("API Rate Limit Exceeded. Please wait.");
       // You might want to re-enqueue the symbol or implement exponential back-off here.
       qDebug() << "This should never happen(onNetworkReplyFinished, symbol)";
-      isFetchingSymbol = true;
-      symbolRequestTimer->start(10 * SYMBOL_REQUEST_INTERVAL_MS);
+      symbolRequestTimer->start(RATE_LIMITED_BACKOFF_MS);
     }
     emit fetchError(symbol, errorMsg);
   } else {
-    // Success (HTTP Status 200 OK)
-    QByteArray responseData = reply->readAll();
+    // Success (HTTP Status 200 OK). Only the bytes are collected here, the parsing runs on parsePool so a big historical
+    // reply does not hold up the quote timer, the next requests or the progress of the other downloads
+    QByteArray responseData = reply->readAll();  // A historical reply's last piece, readyRead took the rest
     qDebug() << "Received response for" << symbol << ".";  // << responseData.data();
     if (requestType == QuoteRequest) {
-      qDebug() << responseData.data();
-      QJsonDocument jsonDoc = QJsonDocument::fromJson(responseData);
-      QJsonObject   jsonObject;
-      if (jsonDoc.isObject()) {
-        jsonObject = jsonDoc.object();
-        //    Stock(QString symbol, QString symbol_name, price_t current_price, price_t price_change, percentage_t percent_change, price_t
-        //    day_high,price_t day_low, price_t day_open, price_t prev_close, time_record_t time)
-        if (!jsonObject["d"].isNull()) {
-          Stock fetchedStock(symbol, symbol + " Co.", jsonObject["c"].toDouble(), jsonObject["d"].toDouble(), jsonObject["h"].toDouble(),
-                             jsonObject["l"].toDouble(), jsonObject["o"].toDouble(), jsonObject["pc"].toDouble(),
-                             jsonObject["t"].toInteger());
-          emit  stockDataFetched(fetchedStock);  // Emit signal with the new Stock object
-        } else {
-          qDebug() << "Non-existent stock.";
-          emit invalidStockDataFetched("Stock does not exist.");
-        }
-      } else {
-        qDebug() << "Response is not a JSON.";
-        emit invalidStockDataFetched("Network response is not a valid JSON.");
-      }
+      parsePool.start([this, symbol, responseData]() { parseQuoteReply(symbol, responseData); });
     } else if (requestType == HistoricalRequest) {
-      // --- SIMULATED JSON PARSING FOR HISTORICAL DATA ---
-      // In a real app, parse the actual JSON response for historical data
-      QMap<time_record_t, HistoricalDataRecord> historicalData;
-      QJsonDocument                             jsonDoc = QJsonDocument::fromJson(responseData);
-      QJsonObject                               rootObj;
-      if (jsonDoc.isObject()) {
-        rootObj                   = jsonDoc.object();
-        QJsonObject timeSeriesObj = rootObj["Time Series (5min)"].toObject();
-        // We assume the stock exists because it has to be in the list for it to be clicked for the request
-        for (auto it = timeSeriesObj.begin(); it != timeSeriesObj.end(); ++it) {
-          // qDebug() << it.value().toString();
-          QJsonObject   dayData           = it.value().toObject();
-          time_record_t secondsSinceEpoch = QDateTime::fromString(it.key(), "yyyy-MM-dd hh:mm:ss").toSecsSinceEpoch();
-          // Debug the actual data we're parsing
-          historicalData.insert(secondsSinceEpoch, { dayData["1. open"].toString().toDouble(), dayData["2. high"].toString().toDouble(),
-                                                     dayData["3. low"].toString().toDouble(), dayData["4. close"].toString().toDouble(),
-                                                     dayData["5. volume"].toString().toLongLong() });
-        }
-        emit historicalDataFetched(symbol, historicalData);
-      } else {
-        qDebug() << "Response is not a JSON.";
-        emit invalidStockDataFetched("Network response is not a valid JSON.");
+      if (!stream) {
+        stream             = HistoricalStreamPtr::create();  // Not one of ours, parsed whole
+        stream->symbol     = symbol;
+        stream->resolution = resolution;
+      }
+      if (!stream->sized) {  // Arrived whole, readyRead queued nothing
+        stream->parser.reset(responseData.size());
+        stream->sized = true;
       }
+      queuePiece(stream, responseData, true);
     }
   }
 
   reply->deleteLater();  // Crucial: delete the reply object when done to prevent memory leaks
 }
 
-void StockDataFetcher::loadHistoricalRequestList(QStringList points_list) {
-  for (const QString &item : points_list) {
-    lastHistoricalRequests.append(item.toLongLong());
+// Run on parsePool. They only emit signals, whose receivers live in the GUI thread, so the results arrive queued
+void StockDataFetcher::parseQuoteReply(const QString &symbol, const QByteArray &responseData) {
+  qDebug() << responseData.data();
+  QJsonDocument jsonDoc = QJsonDocument::fromJson(responseData);
+  QJsonObject   jsonObject;
+  if (jsonDoc.isObject()) {
+    jsonObject = jsonDoc.object();
+    //    Stock(QString symbol, QString symbol_name, price_t current_price, price_t price_change, percentage_t percent_change, price_t
+    //    day_high,price_t day_low, price_t day_open, price_t prev_close, time_record_t time)
+    if (!jsonObject["d"].isNull()) {
+      Stock fetchedStock(symbol, symbol + " Co.", jsonObject["c"].toDouble(), jsonObject["d"].toDouble(), jsonObject["h"].toDouble(),
+                         jsonObject["l"].toDouble(), jsonObject["o"].toDouble(), jsonObject["pc"].toDouble(),
+                         jsonObject["t"].toInteger());
+      emit  stockDataFetched(fetchedStock);  // Emit signal with the new Stock object
+    } else {
+      qDebug() << "Non-existent stock.";
+      emit invalidStockDataFetched("Stock does not exist.");
+    }
+  } else {
+    qDebug() << "Response is not a JSON.";
+    emit invalidStockDataFetched("Network response is not a valid JSON.");
+  }
+}
+
+void StockDataFetcher::queuePiece(const HistoricalStreamPtr &stream, const QByteArray &piece, bool last) {
+  QMutexLocker locker(&stream->mutex);
+  if (!piece.isEmpty()) {
+    stream->pieces.append(piece);
+  }
+  stream->finished = stream->finished || last;
+  if (stream->draining || stream->cancelled) {
+    return;  // The running task picks the piece up
   }
-  while (lastHistoricalRequests.size() < MAX_HISTORICAL_REQUESTS_PER_INTERVAL) {
-    lastHistoricalRequests.append(0);
+  stream->draining = true;
+  locker.unlock();
+  parsePool.start([this, stream]() { drainStream(stream); });
+}
+
+// Feeds the queued pieces until there are none left. The reply has either more to come, a later readyRead starts the next
+// task, or it has finished and the bars are published
+void StockDataFetcher::drainStream(const HistoricalStreamPtr &stream) {
+  for (;;) {
+    QMutexLocker locker(&stream->mutex);
+    if (stream->cancelled) {
+      stream->draining = false;
+      return;
+    }
+    if (stream->pieces.isEmpty()) {
+      if (stream->finished) {
+        break;  // Still draining, no other task is started for this stream
+      }
+      stream->draining = false;
+      return;
+    }
+    const QByteArray piece = stream->pieces.takeFirst();
+    locker.unlock();
+    stream->parser.feed(piece);  // Bytes are dropped once parsed, only a bar cut in two is kept back
   }
-  earliestRequest = 0;
-  for (quint64 i = 0; i < MAX_HISTORICAL_REQUESTS_PER_INTERVAL; i++) {
-    if (lastHistoricalRequests.at(i) < lastHistoricalRequests.at(earliestRequest)) {
-      earliestRequest = i;
-      break;
+  publishHistorical(stream->symbol, stream->resolution, stream->parser);
+}
+
+// One pass over the bytes, no QJsonDocument (see TimeSeriesParser). The intraday, daily and weekly series share it
+void StockDataFetcher::publishHistorical(const QString &symbol, BarResolution resolution, TimeSeriesParser &parser) {
+  if (!parser.finish()) {
+    qDebug() << "Response has no time series for" << symbol << ":" << parser.errorString();
+    emit invalidStockDataFetched("Network response is not a valid time series: " + parser.errorString());
+  } else {
+    if (parser.rejected() > 0) {
+      qWarning() << "Skipped" << parser.rejected() << "malformed bars for" << symbol;
+    }
+    // Validated once here, the chart and everything downstream take the bars as they are. Daily and weekly bars are
+    // already on their buckets, only drops and repairs
+    BarSeries              historicalData = parser.takeBars();
+    const BarQualityReport quality =
+      normalizeBars(historicalData, resolution == BarResolution::FiveMinutes ? HISTORICAL_BAR_INTERVAL_SECS : 0);
+    if (!quality.isClean()) {
+      qWarning() << "Normalized" << symbol << "history: dropped" << quality.dropped << ", repaired" << quality.repaired << ", realigned"
+                 << quality.realigned << ", duplicates" << quality.duplicates << ", gaps" << quality.gaps;
+    }
+    if (resolution == BarResolution::FiveMinutes) {
+      emit historicalDataFetched(symbol, historicalData, quality);
+    } else {
+      emit coarseHistoryFetched(symbol, resolution, historicalData, parser.actions());
     }
   }
 }
-QStringList StockDataFetcher::saveHistoricalRequestList() {
-  QStringList stringed_list;
-  for (const time_record_t point : lastHistoricalRequests) {
-    stringed_list.append(QString::number(point));
+
+void StockDataFetcher::loadRateLimits(QVariantMap saved, QStringList legacyUsage) {
+  limiter.restore(saved);
+  if (saved.isEmpty() && !legacyUsage.isEmpty()) {
+    QList<qint64> times;
+    for (const QString &item : legacyUsage) {
+      if (item.toLongLong() > 0) {
+        times.append(item.toLongLong() * 1000);  // The list was padded with 0s
+      }
+    }
+    limiter.addGrants(HISTORICAL_PROVIDER, apiKeyHistorical, times);
   }
-  return stringed_list;
+}
+QVariantMap StockDataFetcher::saveRateLimits() const {
+  return limiter.save();
 }
 
 void StockDataFetcher::onHistoricalRequestTimerTimeout() {
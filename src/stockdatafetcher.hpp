@@ -8,28 +8,54 @@
 #include <QJsonArray>             // For JSON arrays
 #include <QJsonDocument>          // For parsing JSON
 #include <QJsonObject>            // For JSON objects
+#include <QMap>
+#include <QMutex>
 #include <QNetworkAccessManager>  // For making network requests
 #include <QNetworkReply>          // For handling network responses
 #include <QObject>                // Base class for signal/slot
 #include <QQueue>
 #include <QRandomGenerator>
+#include <QSet>
+#include <QSharedPointer>
 #include <QString>
 #include <QStringList>
 #include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 #include <QUrl>  // For URLs
 #include <QUrlQuery>
 
-#include "stock.hpp"  // Our Stock data model
+#include "barresolution.hpp"    // Bar size of a historical request
+#include "corporateactions.hpp"  // Splits and dividends of the daily adjusted series
+#include "ratelimiter.hpp"       // Request budgets of Finnhub and Alpha Vantage
+#include "stock.hpp"             // Our Stock data model
+#include "timeseriesparser.hpp"  // Historical replies, parsed as they download
 
 class StockDataFetcher : public QObject {
     Q_OBJECT  // Essential for signals and slots
 
-      struct DownloadInfo {
-        qint64  received = 0;
-        qint64  total    = 0;
-        QString description;
-        QString downloadId;  // Add this field
+      // A historical reply parsed while it downloads. readyRead queues the pieces, one parsePool task at a time feeds them
+      // to the parser in order, and the task that finds the reply finished emits the bars
+      struct HistoricalStream {
+        QString           symbol;
+        BarResolution     resolution { BarResolution::FiveMinutes };
+        QMutex            mutex;  // Guards the pieces and the flags, the parser belongs to the task draining them
+        QList<QByteArray> pieces;
+        bool              draining {};
+        bool              finished {};
+        bool              cancelled {};
+        bool              sized {};  // The parser was reset for the reply's length, network thread only, before the first piece
+        TimeSeriesParser  parser;
+    };
+    using HistoricalStreamPtr = QSharedPointer<HistoricalStream>;
+
+    struct DownloadInfo {
+        qint64              received = 0;
+        qint64              total    = 0;
+        QString             description;
+        QString             downloadId;  // Add this field
+        HistoricalStreamPtr stream;      // Historical requests only
     };
 
   public:
@@ -40,25 +66,34 @@ class StockDataFetcher : public QObject {
   public slots:
     // Slot to initiate fetching data for a given stock symbol
     void fetchStockData(const QString &symbol);
-    void fetchHistoricalData(const QString &symbol);  // New slot for historical data
+    // New slot for historical data: the 5min intraday series, or the daily/weekly adjusted one (hourly fetches 5min bars)
+    void fetchHistoricalData(const QString &symbol, BarResolution resolution = BarResolution::FiveMinutes);
 
-    void        loadHistoricalRequestList(QStringList points_list);
-    QStringList saveHistoricalRequestList();
+    // The used request budgets, kept in the settings. legacyUsage is the historical request list of older versions (seconds
+    // since epoch), counted against the Alpha Vantage key when there are no saved budgets yet
+    void        loadRateLimits(QVariantMap saved, QStringList legacyUsage);
+    QVariantMap saveRateLimits() const;
 
     void initialize();
 
+    // Seconds until the next historical request is allowed, 0 if it is now
     time_record_t getTimeToNextRequest() const noexcept {
-      return HISTORICAL_REQUESTS_INTERVAL - QDateTime::currentSecsSinceEpoch() + lastHistoricalRequests.at(earliestRequest);
+      return (limiter.timeToNext(HISTORICAL_PROVIDER, apiKeyHistorical) + 999) / 1000;
     }
     void    onHistoricalRequestTimerTimeout();
     QString getQuoteAPIKey() const noexcept { return apiKeyQuote; };
     QString getHistoricalAPIKey() const noexcept { return apiKeyHistorical; }
     void    updateQuoteAPIKey(QString key);
     void    updateHistoricalAPIKey(QString key);
+
+    const static qint64 HISTORICAL_BAR_INTERVAL_SECS { 5 * 60 };  // Bar size of the intraday request, interval=5min
   signals:
     // Signal emitted when stock data is successfully fetched
     void stockDataFetched(const Stock &stock);
-    void historicalDataFetched(const QString &symbol, const QMap<time_record_t, HistoricalDataRecord> &historicalData);
+    void historicalDataFetched(const QString &symbol, const BarSeries &historicalData, const BarQualityReport &quality);
+    // Daily or weekly bars as traded, with the splits and dividends of the daily series
+    void coarseHistoryFetched(const QString &symbol, BarResolution resolution, const BarSeries &historicalData,
+                              const QList<CorporateAction> &actions);
     void invalidStockDataFetched(const QString &error);
     // Signal emitted if there's an error during fetching
     void fetchError(const QString &symbol, const QString &errorString);
@@ -77,25 +112,30 @@ class StockDataFetcher : public QObject {
   private:
     QNetworkAccessManager              *manager;  // The network manager instance
     QMap<QNetworkReply *, DownloadInfo> networkReplies;
+    QThreadPool                         parsePool;  // Parses the replies, the network thread only collects the bytes
     QString                             apiKeyQuote;
     QString                             apiKeyHistorical;
 
-    QQueue<QString> symbolQueue;         // Queue of symbols to fetch
-    QQueue<QString> historicalQueue;     // New queue for historical requests (symbol, daysBack)
-    QTimer         *symbolRequestTimer;  // Timer to control request rate
-
-    QList<time_record_t> lastHistoricalRequests;
-    quint64              earliestRequest;
-    const static qint64  SYMBOL_REQUEST_INTERVAL_MS { 1100 };  // Example: 1.1 seconds
-    const static qint64  MAX_HISTORICAL_REQUESTS_PER_INTERVAL { 25 };
-    const static qint64  HISTORICAL_REQUESTS_INTERVAL { 1 * 24 * 3600 };  // In seconds
+    QQueue<SymbolId>                      symbolQueue;         // Queue of symbols to fetch
+    QQueue<QPair<SymbolId, BarResolution>> historicalQueue;     // New queue for historical requests (symbol, resolution)
+    QSet<SymbolId>                        queuedQuotes;        // Members of symbolQueue, so duplicates are found without scanning it
+    QSet<QPair<SymbolId, int>>            queuedHistorical;    // Same for historicalQueue, the resolution as an int for qHash
+    QTimer                               *symbolRequestTimer;  // Single shot, set for the next quote permit
+
+    RateLimiter                  limiter;  // Per provider and API key, a new key starts with a full budget
+    constexpr static const char *QUOTE_PROVIDER { "finnhub" };
+    constexpr static const char *HISTORICAL_PROVIDER { "alphavantage" };
+    const static qint64          QUOTE_REQUESTS_PER_MINUTE { 60 };  // Finnhub free tier
+    const static qint64          QUOTE_REQUESTS_PER_SECOND { 30 };
+    const static qint64          HISTORICAL_REQUESTS_PER_DAY { 25 };  // Alpha Vantage free tier
+    const static qint64          RATE_LIMITED_BACKOFF_MS { 11'000 };  // After a 429 nonetheless
     // const quint64 HISTORICAL_REQUEST_INTERVAL_MS { 1100 };  // Example: 1.1 seconds
     // Static member to hold the custom attribute ID
     const static QNetworkRequest::Attribute RequestTypeAttributeId { QNetworkRequest::Attribute(QNetworkRequest::User + 1) };
     const static QNetworkRequest::Attribute NoDaysHistoricRequest { QNetworkRequest::Attribute(QNetworkRequest::User + 2) };
     const static QNetworkRequest::Attribute DownloadIdAttribute { QNetworkRequest::Attribute(QNetworkRequest::User + 3) };
+    const static QNetworkRequest::Attribute ResolutionAttributeId { QNetworkRequest::Attribute(QNetworkRequest::User + 4) };
 
-    bool isFetchingSymbol;                // Flag to prevent multiple simultaneous fetches (if API only allows one at a time)
     void processNextRequestSymbol();      // New slot to handle the request queue
     void processNextRequestHistorical();  // New slot to handle the request queue
 
@@ -103,7 +143,14 @@ class StockDataFetcher : public QObject {
       QuoteRequest,
       HistoricalRequest
     };
-    QString generateDownloadId(const QString &symbol, RequestType type);
+    QString generateDownloadId(const QString &symbol, RequestType type, BarResolution resolution = BarResolution::FiveMinutes);
+
+    // Run on parsePool, they touch no member and only emit the results
+    void parseQuoteReply(const QString &symbol, const QByteArray &responseData);
+    void drainStream(const HistoricalStreamPtr &stream);
+    void publishHistorical(const QString &symbol, BarResolution resolution, TimeSeriesParser &parser);
+    // Network thread: hands a piece of a historical reply to the stream's parser, last when the reply has finished
+    void queuePiece(const HistoricalStreamPtr &stream, const QByteArray &piece, bool last);
 };
 
 class ConnectivityChecker : public QObject {
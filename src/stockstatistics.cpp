@@ -0,0 +1,167 @@
+#include "stockstatistics.hpp"
+#include <QDataStream>
+#include <QDebug>
+#include <QIODevice>
+#include <QtNumeric>
+#include <cmath>
+#include <limits>
+
+namespace {
+  constexpr quint32 STATISTICS_VERSION { 2 };  // 2 keeps the returns of the volatility window, a version 1 blob is rebuilt
+}  // namespace
+
+qint64 StockStatistics::dayOf(time_record_t time) {
+  qint64 day = time / SECONDS_PER_DAY;
+  return time % SECONDS_PER_DAY < 0 ? day - 1 : day;  // Round down before 1970 too
+}
+
+time_record_t StockStatistics::openDayStart() const {
+  return hasOpenDay ? openDay * SECONDS_PER_DAY : std::numeric_limits<time_record_t>::min();
+}
+
+void StockStatistics::update(const BarSeries &dailyBars) {
+  for (qsizetype i = 0; i < dailyBars.size(); ++i) {
+    const qint64 day = dayOf(dailyBars.timestamp(i));
+    if (hasOpenDay && day < openDay) {
+      continue;  // Folded in already
+    }
+    if (hasOpenDay && day > openDay) {
+      completeDay(openDay, today);  // The open day is over, whether or not its bars were passed again
+    }
+    const HistoricalDataRecord bar = dailyBars.record(i);
+    today                          = { double(bar.high), double(bar.low), double(bar.close), double(bar.volume) };
+    openDay                        = day;
+    hasOpenDay                     = true;
+  }
+  expireWindow();
+}
+
+void StockStatistics::completeDay(qint64 day, const Day &bar) {
+  if (previousClose > 0 && bar.close > 0) {
+    const double logReturn  = std::log(bar.close / previousClose);
+    const double delta      = logReturn - returnMean;
+    returnMean             += delta / double(++returnCount);
+    returnM2               += delta * (logReturn - returnMean);
+    recentReturns.append(logReturn);
+    if (recentReturns.size() > VOLATILITY_DAYS) {
+      // Welford backwards: the mean without the oldest return, then its share of the squared deviations
+      const double oldest  = recentReturns.takeFirst();
+      const double mean    = returnMean;
+      returnMean           = (returnMean * double(returnCount) - oldest) / double(returnCount - 1);
+      returnM2            -= (oldest - mean) * (oldest - returnMean);
+      returnM2             = qMax(returnM2, 0.0);  // Rounding must not make it negative
+      --returnCount;
+    }
+  }
+  previousClose = bar.close;
+
+  // A new high makes every smaller one before it irrelevant for the rest of the window, likewise for lows
+  while (!highWindow.isEmpty() && highWindow.last().value <= bar.high) {
+    highWindow.removeLast();
+  }
+  highWindow.append({ day, bar.high });
+  while (!lowWindow.isEmpty() && lowWindow.last().value >= bar.low) {
+    lowWindow.removeLast();
+  }
+  lowWindow.append({ day, bar.low });
+
+  recentVolumes.append(bar.volume);
+  volumeSum += bar.volume;
+  if (recentVolumes.size() > AVERAGE_VOLUME_DAYS) {
+    volumeSum -= recentVolumes.takeFirst();
+  }
+  recentCloses.append(bar.close);
+  if (recentCloses.size() > RETURN_DAYS) {
+    recentCloses.removeFirst();
+  }
+  ++completedDays;
+}
+
+void StockStatistics::expireWindow() {
+  while (!highWindow.isEmpty() && highWindow.first().day <= openDay - WINDOW_DAYS) {
+    highWindow.removeFirst();
+  }
+  while (!lowWindow.isEmpty() && lowWindow.first().day <= openDay - WINDOW_DAYS) {
+    lowWindow.removeFirst();
+  }
+}
+
+double StockStatistics::high52Week() const {
+  if (!hasOpenDay) {
+    return 0;
+  }
+  return highWindow.isEmpty() ? today.high : qMax(highWindow.first().value, today.high);
+}
+
+double StockStatistics::low52Week() const {
+  if (!hasOpenDay) {
+    return 0;
+  }
+  return lowWindow.isEmpty() ? today.low : qMin(lowWindow.first().value, today.low);
+}
+
+double StockStatistics::averageVolume() const {
+  return recentVolumes.isEmpty() ? 0 : volumeSum / double(recentVolumes.size());
+}
+
+double StockStatistics::volatility() const {
+  return returnCount < 2 ? 0 : std::sqrt(returnM2 / double(returnCount - 1) * TRADING_DAYS_PER_YEAR);
+}
+
+double StockStatistics::periodReturn() const {
+  if (!hasOpenDay || recentCloses.size() < RETURN_DAYS || recentCloses.first() <= 0) {
+    return qQNaN();
+  }
+  return today.close / recentCloses.first() - 1.0;
+}
+
+QByteArray StockStatistics::toByteArray() const {
+  QByteArray  data;
+  QDataStream stream(&data, QIODevice::WriteOnly);
+  stream.setVersion(QDataStream::Qt_6_0);
+  stream << STATISTICS_VERSION << hasOpenDay << openDay << today.high << today.low << today.close << today.volume
+         << qint64(completedDays) << returnCount << returnMean << returnM2 << previousClose;
+  for (const QList<DayValue> *window : { &highWindow, &lowWindow }) {
+    stream << qint32(window->size());
+    for (const DayValue &entry : *window) {
+      stream << entry.day << entry.value;
+    }
+  }
+  stream << recentVolumes << volumeSum << recentCloses << recentReturns;
+  return data;
+}
+
+bool StockStatistics::fromByteArray(const QByteArray &data, StockStatistics &statistics) {
+  QDataStream stream(data);
+  stream.setVersion(QDataStream::Qt_6_0);
+  StockStatistics loaded;
+  quint32         version {};
+  qint64          completedDays;
+  stream >> version;
+  if (stream.status() != QDataStream::Ok || version != STATISTICS_VERSION) {
+    qWarning() << "Unsupported stock statistics version" << version;
+    return false;
+  }
+  stream >> loaded.hasOpenDay >> loaded.openDay >> loaded.today.high >> loaded.today.low >> loaded.today.close >> loaded.today.volume
+    >> completedDays >> loaded.returnCount >> loaded.returnMean >> loaded.returnM2 >> loaded.previousClose;
+  loaded.completedDays = completedDays;
+  for (QList<DayValue> *window : { &loaded.highWindow, &loaded.lowWindow }) {
+    qint32 size = -1;
+    stream >> size;
+    if (stream.status() != QDataStream::Ok || size < 0 || size > WINDOW_DAYS) {
+      qWarning() << "Corrupt stock statistics.";
+      return false;
+    }
+    window->resize(size);
+    for (DayValue &entry : *window) {
+      stream >> entry.day >> entry.value;
+    }
+  }
+  stream >> loaded.recentVolumes >> loaded.volumeSum >> loaded.recentCloses >> loaded.recentReturns;
+  if (stream.status() != QDataStream::Ok || loaded.recentReturns.size() != loaded.returnCount) {
+    qWarning() << "Corrupt stock statistics.";
+    return false;
+  }
+  statistics = loaded;
+  return true;
+}
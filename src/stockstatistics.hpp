@@ -0,0 +1,80 @@
+#ifndef _STOCK_STATISTICS_HEADER_
+#define _STOCK_STATISTICS_HEADER_
+
+#include <QByteArray>
+#include <QList>
+
+#include "barseries.hpp"
+
+// Summary statistics of a symbol's stored history, kept up to date as bars are merged so that readers get them in O(1):
+// the 52-week high and low, the average daily volume, the realized volatility and the return over the last sessions.
+// History is folded in per US/Eastern trading date, like the daily rollup. A completed day updates the running state once:
+// monotonic deques hold the extrema of the 52-week window, Welford's method the variance of the daily log returns of the
+// last VOLATILITY_DAYS sessions (a return leaving the window is taken out again). The newest day
+// is still open and is replaced on every update, so bars fetched again for it are not counted twice.
+class StockStatistics {
+  public:
+    bool isEmpty() const { return !hasOpenDay; }
+    void clear() { *this = StockStatistics(); }
+
+    // Where the next update has to start: the open day. Days before it are folded in for good, so when bars before it
+    // change the statistics are cleared and the whole history replayed. The minimum time when empty.
+    time_record_t openDayStart() const;
+    // Folds daily bars (stamped at 00:00 UTC of their trading date, as DatabaseManager::rollUp gives them) from openDayStart()
+    // on: all but the last are completed days, the last one becomes the open day
+    void update(const BarSeries &dailyBars);
+
+    double    high52Week() const;     // 0 when empty
+    double    low52Week() const;      // 0 when empty
+    double    averageVolume() const;  // Mean volume of the last AVERAGE_VOLUME_DAYS completed sessions, 0 without any
+    double    volatility() const;     // Annualized standard deviation of the last VOLATILITY_DAYS log returns, 0 without two
+    double    periodReturn() const;   // Over the last RETURN_DAYS sessions as a fraction, NaN while fewer are stored
+    qsizetype sessions() const { return completedDays + (hasOpenDay ? 1 : 0); }
+
+    QByteArray  toByteArray() const;
+    static bool fromByteArray(const QByteArray &data, StockStatistics &statistics);
+
+    const static int RETURN_DAYS { 20 };          // About a month of sessions
+    const static int AVERAGE_VOLUME_DAYS { 30 };
+    const static int VOLATILITY_DAYS { 252 };     // A year of sessions
+
+  private:
+    struct DayValue {
+        qint64 day;
+        double value;
+    };
+    struct Day {
+        double high {};
+        double low {};
+        double close {};
+        double volume {};
+    };
+
+    bool      hasOpenDay { false };
+    qint64    openDay {};  // Day number (days since epoch) of today
+    Day       today;
+    qsizetype completedDays {};
+
+    // Welford's running mean and sum of squared deviations of the daily log returns in recentReturns
+    qint64        returnCount {};
+    double        returnMean {};
+    double        returnM2 {};
+    double        previousClose {};  // Of the last completed day
+    QList<double> recentReturns;     // The last VOLATILITY_DAYS log returns, oldest first
+
+    QList<DayValue> highWindow;     // Highs of the window in decreasing order, the front is the maximum
+    QList<DayValue> lowWindow;      // Lows in increasing order, the front is the minimum
+    QList<double>   recentVolumes;  // The last AVERAGE_VOLUME_DAYS completed sessions
+    double          volumeSum {};   // Of recentVolumes
+    QList<double>   recentCloses;   // The last RETURN_DAYS completed sessions
+
+    const static int    WINDOW_DAYS { 365 };  // 52 weeks, calendar days
+    const static int    TRADING_DAYS_PER_YEAR { 252 };
+    const static qint64 SECONDS_PER_DAY { 24 * 60 * 60 };
+
+    void          completeDay(qint64 day, const Day &bar);
+    void          expireWindow();  // Drops window entries that fell out of the 52 weeks before openDay
+    static qint64 dayOf(time_record_t time);
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "symboltable.hpp"
+
+SymbolTable &SymbolTable::instance() {
+  static SymbolTable table;
+  return table;
+}
+
+SymbolId SymbolTable::intern(const QString &symbol) {
+  if (symbol.isEmpty()) {
+    return INVALID_SYMBOL_ID;
+  }
+  {
+    QReadLocker reader(&lock);  // Nearly every call is for a symbol that is already known
+    auto        found = ids.constFind(symbol);
+    if (found != ids.constEnd()) {
+      return found.value();
+    }
+  }
+  QWriteLocker writer(&lock);
+  auto         found = ids.constFind(symbol);
+  if (found != ids.constEnd()) {
+    return found.value();  // Interned by another thread in between
+  }
+  const SymbolId id = SymbolId(symbols.size());
+  symbols.append(symbol);
+  ids.insert(symbol, id);
+  return id;
+}
+
+SymbolId SymbolTable::find(const QString &symbol) const {
+  QReadLocker reader(&lock);
+  return ids.value(symbol, INVALID_SYMBOL_ID);
+}
+
+QString SymbolTable::symbol(SymbolId id) const {
+  QReadLocker reader(&lock);
+  return (id >= 0 && id < symbols.size()) ? symbols.at(id) : QString();
+}
+
+qsizetype SymbolTable::size() const {
+  QReadLocker reader(&lock);
+  return symbols.size();
+}
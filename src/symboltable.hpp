@@ -0,0 +1,33 @@
+#ifndef _SYMBOL_TABLE_HEADER_
+#define _SYMBOL_TABLE_HEADER_
+
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <QString>
+
+// Dense integer handle of a ticker, 0, 1, 2... in the order symbols are first seen
+using SymbolId = qint32;
+constexpr SymbolId INVALID_SYMBOL_ID { -1 };
+
+// Process-wide interning table: every ticker gets one SymbolId for the lifetime of the process, so per-symbol state can
+// live in plain arrays indexed by id and lookups cost one hash probe instead of scans and string compares.
+// Ids are never reused, removing a stock leaves its id allocated. Thread-safe, the fetcher, storage and UI threads share it.
+class SymbolTable {
+  public:
+    static SymbolTable &instance();
+
+    SymbolId  intern(const QString &symbol);      // Existing id, or a new one; INVALID_SYMBOL_ID for an empty symbol
+    SymbolId  find(const QString &symbol) const;  // INVALID_SYMBOL_ID if the symbol was never interned
+    QString   symbol(SymbolId id) const;          // Empty for an unknown id
+    qsizetype size() const;                       // Ids handed out so far, all of them are below this
+
+  private:
+    SymbolTable() = default;
+
+    mutable QReadWriteLock   lock;
+    QHash<QString, SymbolId> ids;
+    QList<QString>           symbols;  // Indexed by SymbolId
+};
+
+#endif
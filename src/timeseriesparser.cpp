@@ -0,0 +1,405 @@
+#include "timeseriesparser.hpp"
+#include "priceparser.hpp"
+#include "timestampparser.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+  template <qsizetype N>
+  bool equals(const char *begin, const char *end, const char (&literal)[N]) {
+    return end - begin == N - 1 && std::memcmp(begin, literal, N - 1) == 0;
+  }
+
+  template <qsizetype N>
+  bool endsWith(const char *begin, const char *end, const char (&literal)[N]) {
+    return end - begin >= N - 1 && std::memcmp(end - (N - 1), literal, N - 1) == 0;
+  }
+
+  bool contains(const char *begin, const char *end, const char *literal) {
+    return std::search(begin, end, literal, literal + std::strlen(literal)) != end;
+  }
+
+  bool parseVolume(const char *begin, const char *end, volume_t &volume) {
+    volume = 0;
+    const char *p = begin;
+    for (; p != end && *p >= '0' && *p <= '9' && p - begin < 18; ++p) {
+      volume = volume * 10 + (*p - '0');
+    }
+    if (p == end && p != begin) {
+      return true;
+    }
+    double decimal;  // "1234.0" and the like
+    if (!parseDecimal(begin, end, decimal) || decimal < 0 || decimal > 9e18) {
+      return false;
+    }
+    volume = volume_t(decimal + 0.5);
+    return true;
+  }
+}  // namespace
+
+bool TimeSeriesParser::parse(const char *begin, const char *end) {
+  reset(end - begin);
+  feed(begin, end);  // Parsed in place, nothing is copied unless the response is cut short
+  return finish();
+}
+
+void TimeSeriesParser::reset(qint64 expectedBytes) {
+  stage            = Stage::Start;
+  seriesResolution = BarResolution::FiveMinutes;
+  seriesBars.clear();
+  seriesActions.clear();
+  seriesSymbol.clear();
+  error.clear();
+  rejectedBars = 0;
+  foundSeries  = false;
+  pending.clear();
+  rows.clear();
+  if (expectedBytes > 0) {
+    rows.reserve(size_t(expectedBytes / RESPONSE_BYTES_PER_BAR + 1));
+  }
+}
+
+bool TimeSeriesParser::feed(const char *begin, const char *end) {
+  if (stage == Stage::Failed || stage == Stage::Done) {
+    return stage == Stage::Done;  // Whitespace or garbage after the root object is ignored, like QJsonDocument did
+  }
+  if (pending.isEmpty()) {
+    const char *rest = parseUnits(begin, end);
+    if (stage != Stage::Failed && stage != Stage::Done) {
+      pending.append(rest, end - rest);
+    }
+  } else {
+    pending.append(begin, end - begin);
+    const char *rest = parseUnits(pending.constData(), pending.constData() + pending.size());
+    if (stage != Stage::Failed && stage != Stage::Done) {
+      pending.remove(0, rest - pending.constData());
+    } else {
+      pending.clear();
+    }
+  }
+  return stage != Stage::Failed;
+}
+
+bool TimeSeriesParser::finish() {
+  if (stage == Stage::Failed) {
+    return false;
+  }
+  pending.clear();
+  if (stage != Stage::Done) {
+    return fail(error.isEmpty() ? QString("Truncated JSON response.") : error);
+  }
+  if (!foundSeries) {
+    return fail(error.isEmpty() ? QString("No time series in the response.") : error);
+  }
+
+  auto byTime = [](const Row &a, const Row &b) { return a.first < b.first; };
+  if (rows.size() > 1 && rows.front().first > rows.back().first) {
+    std::reverse(rows.begin(), rows.end());  // Newest first, as the vendor sends them
+  }
+  if (!std::is_sorted(rows.cbegin(), rows.cend(), byTime)) {
+    std::stable_sort(rows.begin(), rows.end(), byTime);
+  }
+  seriesBars.reserve(qsizetype(rows.size()));
+  for (const auto &[time, bar] : rows) {
+    seriesBars.append(time, bar);  // A repeated timestamp replaces the bar before it
+  }
+  std::vector<Row>().swap(rows);  // The bars are in the columns now, the rows would double the memory
+  return true;
+}
+
+// Parses units until the bytes run out in the middle of one, which is then undone: its rows and actions are dropped and the
+// returned position is its first byte
+const char *TimeSeriesParser::parseUnits(const char *begin, const char *last) {
+  p   = begin;
+  end = last;
+  while (stage != Stage::Done && stage != Stage::Failed) {
+    const char     *unitStart   = p;
+    const size_t    rowCount    = rows.size();
+    const qsizetype actionCount = seriesActions.size();
+    const qsizetype rejectCount = rejectedBars;
+    starved                     = false;
+    if (!parseUnit() && stage != Stage::Failed) {  // Starved
+      rows.erase(rows.begin() + qsizetype(rowCount), rows.end());
+      seriesActions.resize(actionCount);
+      rejectedBars = rejectCount;
+      return unitStart;
+    }
+  }
+  return p;
+}
+
+// One unit of the current stage: the opening brace, a member of the root object with the separator after it (the series
+// only up to its opening brace), a bar with its separator, or the separator after the series
+bool TimeSeriesParser::parseUnit() {
+  Field key;
+  bool  done = false;
+  switch (stage) {
+    case Stage::Start: {
+      if (!expect('{')) {
+        return malformed("Response is not a JSON object.");
+      }
+      const bool empty = atObjectEnd();
+      if (starved) {
+        return false;
+      }
+      stage = empty ? Stage::Done : Stage::RootMember;
+      return true;
+    }
+    case Stage::RootMember:
+      if (!readString(key) || !expect(':')) {
+        return malformed("Malformed JSON response.");
+      }
+      if (contains(key.begin, key.end, "Time Series")) {  // "Time Series (5min)", "Time Series (Daily)", "Weekly Adjusted ..."
+        seriesResolution = contains(key.begin, key.end, "Daily")  ? BarResolution::Daily
+                         : contains(key.begin, key.end, "Weekly") ? BarResolution::Weekly
+                                                                  : BarResolution::FiveMinutes;
+        if (!expect('{')) {
+          return malformed("Malformed time series.");
+        }
+        const bool empty = atObjectEnd();
+        if (starved) {
+          return false;
+        }
+        foundSeries = true;
+        stage       = empty ? Stage::RootSeparator : Stage::SeriesBar;
+        return true;
+      }
+      if (equals(key.begin, key.end, "Meta Data")) {
+        if (!parseMetaData()) {
+          return malformed("Malformed meta data.");
+        }
+      } else if (equals(key.begin, key.end, "Error Message") || equals(key.begin, key.end, "Note") ||
+                 equals(key.begin, key.end, "Information")) {
+        Field message;
+        if (!readString(message)) {
+          return malformed("Malformed JSON response.");
+        }
+        error = QString::fromUtf8(message.begin, message.end - message.begin);  // Rate limit or bad symbol, kept for the caller
+      } else if (!skipValue()) {
+        return malformed("Malformed JSON response.");
+      }
+      if (!nextMember(done)) {
+        return malformed("Malformed JSON response.");
+      }
+      stage = done ? Stage::Done : Stage::RootMember;
+      return true;
+    case Stage::SeriesBar:
+      if (!readString(key) || !expect(':') || !parseBar(key) || !nextMember(done)) {
+        return malformed("Malformed time series.");
+      }
+      stage = done ? Stage::RootSeparator : Stage::SeriesBar;
+      return true;
+    case Stage::RootSeparator:
+      if (!nextMember(done)) {
+        return malformed("Malformed JSON response.");
+      }
+      stage = done ? Stage::Done : Stage::RootMember;
+      return true;
+    case Stage::Done:
+    case Stage::Failed:
+      break;
+  }
+  return false;
+}
+
+void TimeSeriesParser::skipSpace() {
+  while (p != end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+    ++p;
+  }
+}
+
+bool TimeSeriesParser::atEnd() {
+  starved = starved || p == end;
+  return p == end;
+}
+
+bool TimeSeriesParser::expect(char c) {
+  skipSpace();
+  if (atEnd() || *p != c) {
+    return false;
+  }
+  ++p;
+  return true;
+}
+
+bool TimeSeriesParser::readString(Field &text) {
+  if (!expect('"')) {
+    return false;
+  }
+  text.begin = p;
+  while (p != end && *p != '"') {
+    p += *p == '\\' && end - p > 1 ? 2 : 1;
+  }
+  if (atEnd()) {
+    return false;
+  }
+  text.end = p++;
+  return true;
+}
+
+bool TimeSeriesParser::skipValue() {
+  skipSpace();
+  if (atEnd()) {
+    return false;
+  }
+  Field text;
+  if (*p == '"') {
+    return readString(text);
+  }
+  if (*p != '{' && *p != '[') {
+    const char *start = p;  // Number, true, false or null
+    while (p != end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') {
+      ++p;
+    }
+    return !atEnd() && p != start;  // Cut at the end of the bytes, the rest may still come
+  }
+  int depth = 0;
+  while (!atEnd()) {
+    if (*p == '"') {
+      if (!readString(text)) {
+        return false;
+      }
+      continue;
+    }
+    depth += (*p == '{' || *p == '[') - (*p == '}' || *p == ']');
+    ++p;
+    if (depth == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TimeSeriesParser::atObjectEnd() {
+  skipSpace();
+  if (!atEnd() && *p == '}') {
+    ++p;
+    return true;
+  }
+  return false;
+}
+
+bool TimeSeriesParser::nextMember(bool &done) {
+  skipSpace();
+  if (atEnd() || (*p != ',' && *p != '}')) {
+    return false;
+  }
+  done = *p++ == '}';
+  return true;
+}
+
+bool TimeSeriesParser::parseMetaData() {
+  if (!expect('{')) {
+    return false;
+  }
+  for (bool done = atObjectEnd(); !done;) {
+    Field key, value;
+    if (!readString(key) || !expect(':')) {
+      return false;
+    }
+    if (equals(key.begin, key.end, "2. Symbol")) {
+      if (!readString(value)) {
+        return false;
+      }
+      seriesSymbol = QString::fromLatin1(value.begin, value.end - value.begin);
+    } else if (!skipValue()) {
+      return false;
+    }
+    if (!nextMember(done)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// One bar object. Its fields are told apart by their number ("1. open" ... "8. split coefficient"), the volume is
+// "5. volume" in the intraday series and "6. volume" in the adjusted ones, after "5. adjusted close"
+bool TimeSeriesParser::parseBar(Field key) {
+  const unsigned ALL_PRICES = 0xF;  // One bit per field, "1. open" to "4. close"
+  if (!expect('{')) {
+    return false;
+  }
+  price_t  open {}, high {}, low {}, close {};
+  volume_t volume           = 0;
+  double   dividendAmount   = 0.0;
+  double   splitCoefficient = 1.0;
+  unsigned parsed           = 0;
+  bool     malformed        = false;
+  for (bool done = atObjectEnd(); !done;) {
+    Field name, value;
+    if (!readString(name) || !expect(':')) {
+      return false;
+    }
+    skipSpace();
+    if (atEnd()) {
+      return false;
+    }
+    if (*p != '"') {
+      malformed = true;  // The vendor quotes every number
+      if (!skipValue() || !nextMember(done)) {
+        return false;
+      }
+      continue;
+    }
+    if (!readString(value)) {
+      return false;
+    }
+    const char field = name.end - name.begin > 3 && name.begin[1] == '.' ? name.begin[0] : 0;
+    if (field >= '1' && field <= '4') {
+      price_t *prices[] { &open, &high, &low, &close };
+      malformed = malformed || !parsePrice(value.begin, value.end, *prices[field - '1']);
+      parsed   |= 1u << (field - '1');
+    } else if ((field == '5' || field == '6') && endsWith(name.begin, name.end, "volume")) {
+      malformed = malformed || !parseVolume(value.begin, value.end, volume);  // Not "5. adjusted close"
+    } else if (field == '7') {
+      malformed = malformed || !parseDecimal(value.begin, value.end, dividendAmount);
+    } else if (field == '8') {
+      malformed = malformed || !parseDecimal(value.begin, value.end, splitCoefficient);
+    }
+    if (!nextMember(done)) {
+      return false;
+    }
+  }
+  time_record_t time;
+  if (malformed || parsed != ALL_PRICES || !parseTime(key, time)) {
+    rejectedBars++;
+    return true;  // The rest of the response is still usable
+  }
+  rows.emplace_back(time, HistoricalDataRecord(open, high, low, close, volume));
+  if (seriesResolution == BarResolution::Daily) {
+    if (splitCoefficient > 0 && splitCoefficient != 1.0) {
+      seriesActions.append(CorporateAction::split(time, splitCoefficient));
+    }
+    if (dividendAmount > 0) {
+      seriesActions.append(CorporateAction::dividend(time, dividendAmount, 0.0));  // The database computes the factor
+    }
+  }
+  return true;
+}
+
+// "yyyy-MM-dd hh:mm:ss" (intraday, US/Eastern) or "yyyy-MM-dd" (daily and weekly, UTC day buckets)
+bool TimeSeriesParser::parseTime(Field key, time_record_t &time) {
+  if (seriesResolution == BarResolution::FiveMinutes) {
+    return parseEasternTimestamp(key.begin, key.end, time);
+  }
+  time_record_t day;
+  if (!parseWallClock(key.begin, key.end, day)) {
+    return false;
+  }
+  time = resolutionBucket(seriesResolution, day);
+  return true;
+}
+
+bool TimeSeriesParser::malformed(const QString &message) {
+  return starved ? false : fail(message);
+}
+
+bool TimeSeriesParser::fail(const QString &message) {
+  stage = Stage::Failed;
+  error = message;
+  seriesBars.clear();
+  seriesActions.clear();
+  pending.clear();
+  std::vector<Row>().swap(rows);
+  return false;
+}
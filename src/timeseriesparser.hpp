@@ -0,0 +1,93 @@
+#ifndef _TIME_SERIES_PARSER_HEADER_
+#define _TIME_SERIES_PARSER_HEADER_
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <utility>
+#include <vector>
+
+#include "barresolution.hpp"
+#include "barseries.hpp"
+#include "corporateactions.hpp"
+
+// Single-pass parser for Alpha Vantage time series responses (TIME_SERIES_INTRADAY, _DAILY_ADJUSTED, _WEEKLY_ADJUSTED).
+// The bytes are tokenized once, keys are matched and numbers parsed in place (parsePrice), there is no QJsonDocument,
+// QJsonObject or QString per bar. Rows are collected in a buffer and appended to the series oldest first (the vendor sends
+// the newest first).
+// The tokenizer is resumable, so a reply can be parsed while it downloads: the response is cut into units (a bar, a
+// member of the root object) and a unit cut by the end of a piece is undone and kept back until the next piece completes
+// it. Only the decoded rows and that partial unit are held, never the whole response.
+// Intraday keys are US/Eastern wall-clock times and become UTC epoch seconds (parseEasternTimestamp), daily ones 00:00 UTC
+// of the day, weekly ones 00:00 UTC of the Monday. Only the daily series yields corporate actions, the weekly dividends
+// have no exact ex-date.
+class TimeSeriesParser {
+  public:
+    TimeSeriesParser() = default;
+
+    // Parses a whole response, false when it holds no time series (an "Error Message", "Note" or "Information" object,
+    // truncated or malformed JSON); errorString() says why. A parser can be reused, each call starts over
+    bool parse(const char *begin, const char *end);
+    bool parse(const QByteArray &response) { return parse(response.constData(), response.constData() + response.size()); }
+
+    // The same in pieces: reset, feed the bytes as they arrive, however they are cut, then finish, which gives what parse
+    // would have. expectedBytes (the Content-Length, -1 if unknown) sizes the row buffer. feed is false once the response
+    // is known to be malformed, the rest can still be fed and is ignored
+    void reset(qint64 expectedBytes = -1);
+    bool feed(const char *begin, const char *end);
+    bool feed(const QByteArray &bytes) { return feed(bytes.constData(), bytes.constData() + bytes.size()); }
+    bool finish();
+
+    BarResolution                 resolution() const { return seriesResolution; }
+    const BarSeries              &bars() const { return seriesBars; }  // Sorted, not normalized (normalizeBars)
+    BarSeries                     takeBars() { return std::move(seriesBars); }  // Hands them over without a copy
+    const QList<CorporateAction> &actions() const { return seriesActions; }
+    const QString                &symbol() const { return seriesSymbol; }  // "2. Symbol" of the meta data, empty if missing
+    const QString                &errorString() const { return error; }
+    qsizetype                     rejected() const { return rejectedBars; }  // Bars with a missing or malformed field
+
+  private:
+    struct Field {
+        const char *begin {};
+        const char *end {};
+    };
+    using Row = std::pair<time_record_t, HistoricalDataRecord>;
+
+    // Where the next unit starts: before the root object, before a member of it, before a bar, after the series
+    enum class Stage { Start, RootMember, SeriesBar, RootSeparator, Done, Failed };
+
+    Stage       stage { Stage::Start };
+    const char *p {};  // Next byte to read, in the piece being fed or in pending
+    const char *end {};
+    bool        starved {};  // The current unit ran into the end of the bytes, it is incomplete rather than malformed
+    bool        foundSeries {};
+    QByteArray  pending;  // Start of a unit cut by the end of the last piece
+
+    BarResolution          seriesResolution { BarResolution::FiveMinutes };
+    BarSeries              seriesBars;
+    QList<CorporateAction> seriesActions;
+    QString                seriesSymbol;
+    QString                error;
+    qsizetype              rejectedBars {};
+    std::vector<Row>       rows;  // In the order of the response
+
+    const static qsizetype RESPONSE_BYTES_PER_BAR { 150 };  // Pretty-printed intraday bar, sizes the row buffer
+
+    const char *parseUnits(const char *begin, const char *end);  // Returns where the first incomplete unit starts
+    bool        parseUnit();
+
+    void skipSpace();
+    bool atEnd();                      // No byte left, marks the unit starved
+    bool expect(char c);               // Skips whitespace, then consumes c
+    bool readString(Field &text);      // Raw bytes between the quotes, escapes are left as they are
+    bool skipValue();                  // Any JSON value, nested ones included
+    bool atObjectEnd();                // Right after '{': consumes the '}' of an empty object
+    bool nextMember(bool &done);       // Between members of an object: ',' or the closing '}'
+    bool parseMetaData();
+    bool parseBar(Field key);
+    bool parseTime(Field key, time_record_t &time);
+    bool malformed(const QString &message);  // fail, unless the unit is only starved. Always false
+    bool fail(const QString &message);       // Sets the error and stops, always false
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "timestampparser.hpp"
+#include <vector>
+
+namespace {
+  const qint64 SECS_PER_DAY   = 24 * 60 * 60;
+  const qint64 EST_OFFSET     = 5 * 60 * 60;  // UTC - EST
+  const qint64 EDT_OFFSET     = 4 * 60 * 60;
+  const int    FIRST_DST_YEAR = 1967;  // Uniform Time Act, standard time all year before
+  const int    LAST_DST_YEAR  = 2199;
+
+  int digitsAt(const char *p, int count) {
+    int value = 0;
+    for (int i = 0; i < count; ++i) {
+      if (p[i] < '0' || p[i] > '9') {
+        return -1;
+      }
+      value = value * 10 + (p[i] - '0');
+    }
+    return value;
+  }
+
+  int daysInMonth(int year, int month) {
+    static const int DAYS[] { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    const bool       leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return DAYS[month - 1] + (month == 2 && leap);
+  }
+
+  qint64 dayNumber(int year, int month, int day) { return utcDayStart(year, month, day) / SECS_PER_DAY; }
+  int    weekday(qint64 day) { return int(((day + 4) % 7 + 7) % 7); }  // 0 is Sunday, 1970-01-01 was a Thursday
+
+  qint64 nthSunday(int year, int month, int n) {
+    const qint64 first = dayNumber(year, month, 1);
+    return first + (7 - weekday(first)) % 7 + 7 * (n - 1);
+  }
+
+  qint64 lastSunday(int year, int month) {
+    const qint64 last = dayNumber(year, month, daysInMonth(year, month));
+    return last - weekday(last);
+  }
+
+  // Wall-clock seconds the daylight time of a year starts and ends at, both at 02:00 local
+  struct DstYear {
+      time_record_t dstStart;
+      time_record_t dstEnd;
+  };
+
+  DstYear dstYear(int year) {
+    qint64 start, end;
+    if (year >= 2007) {
+      start = nthSunday(year, 3, 2);
+      end   = nthSunday(year, 11, 1);
+    } else if (year >= 1987) {
+      start = nthSunday(year, 4, 1);
+      end   = lastSunday(year, 10);
+    } else if (year == 1974 || year == 1975) {  // Emergency daylight saving time of the oil crisis
+      start = year == 1974 ? dayNumber(1974, 1, 6) : dayNumber(1975, 2, 23);
+      end   = lastSunday(year, 10);
+    } else {
+      start = lastSunday(year, 4);
+      end   = lastSunday(year, 10);
+    }
+    const qint64 twoAm = 2 * 60 * 60;
+    return { start * SECS_PER_DAY + twoAm, end * SECS_PER_DAY + twoAm };
+  }
+
+  // Built once, shared by the importer's pool threads (static initialization is thread-safe)
+  const std::vector<DstYear> &dstTable() {
+    static const std::vector<DstYear> table = []() {
+      std::vector<DstYear> years;
+      years.reserve(LAST_DST_YEAR - FIRST_DST_YEAR + 1);
+      for (int year = FIRST_DST_YEAR; year <= LAST_DST_YEAR; ++year) {
+        years.push_back(dstYear(year));
+      }
+      return years;
+    }();
+    return table;
+  }
+
+  qint64 easternUtcOffset(int year, time_record_t wallClock) {
+    if (year < FIRST_DST_YEAR || year > LAST_DST_YEAR) {
+      return EST_OFFSET;
+    }
+    const DstYear &dst = dstTable()[size_t(year - FIRST_DST_YEAR)];
+    return wallClock >= dst.dstStart && wallClock < dst.dstEnd ? EDT_OFFSET : EST_OFFSET;
+  }
+
+  bool parseWallClock(const char *begin, const char *end, int &year, time_record_t &wallClock) {
+    const qsizetype length = end - begin;
+    const char     *p      = begin;
+    if ((length != 10 && length != 16 && length != 19) || (p[4] != '-' && p[4] != '/') || p[7] != p[4]) {
+      return false;
+    }
+    year            = digitsAt(p, 4);
+    const int month = digitsAt(p + 5, 2), day = digitsAt(p + 8, 2);
+    if (year < 0 || month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month)) {
+      return false;
+    }
+    wallClock = utcDayStart(year, month, day);
+    if (length == 10) {
+      return true;
+    }
+    if ((p[10] != ' ' && p[10] != 'T') || p[13] != ':' || (length == 19 && p[16] != ':')) {
+      return false;
+    }
+    const int hour = digitsAt(p + 11, 2), minute = digitsAt(p + 14, 2), second = length == 19 ? digitsAt(p + 17, 2) : 0;
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59) {
+      return false;
+    }
+    wallClock += hour * 60 * 60 + minute * 60 + second;
+    return true;
+  }
+}  // namespace
+
+bool parseWallClock(const char *begin, const char *end, time_record_t &wallClock) {
+  int year;
+  return parseWallClock(begin, end, year, wallClock);
+}
+
+qint64 easternUtcOffset(time_record_t wallClock) {
+  // The year from the days elapsed, off by one at most around New Year
+  const qint64 days = wallClock / SECS_PER_DAY - (wallClock % SECS_PER_DAY < 0);
+  int          year = int(1970 + days * 400 / 146097);
+  year             += wallClock >= utcDayStart(year + 1, 1, 1);
+  year             -= wallClock < utcDayStart(year, 1, 1);
+  return easternUtcOffset(year, wallClock);
+}
+
+time_record_t easternWallClock(time_record_t time) {
+  const time_record_t daylight = time - 4 * 60 * 60;
+  return easternUtcOffset(daylight) == 4 * 60 * 60 ? daylight : time - 5 * 60 * 60;
+}
+
+bool parseEasternTimestamp(const char *begin, const char *end, time_record_t &time) {
+  int           year;  // Known from the key, no need to work it out from the seconds
+  time_record_t wallClock;
+  if (!parseWallClock(begin, end, year, wallClock)) {
+    return false;
+  }
+  time = wallClock + easternUtcOffset(year, wallClock);
+  return true;
+}
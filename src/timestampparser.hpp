@@ -0,0 +1,40 @@
+#ifndef _TIMESTAMP_PARSER_HEADER_
+#define _TIMESTAMP_PARSER_HEADER_
+
+#include <QtGlobal>
+
+#include "global.hpp"
+
+// Timestamp parsing for the hot paths (bar keys of the Alpha Vantage responses, CSV rows), without QDateTime, locale or
+// zone database lookups. Vendors stamp intraday bars in US/Eastern wall-clock time whatever the user's zone, so the keys
+// are converted with the US/Eastern rules instead of the local ones.
+
+// Epoch seconds of 00:00 UTC on a proleptic Gregorian date (days from civil, H. Hinnant). Daily and weekly bars are
+// stamped with it, wall-clock times below count from it, so a wall clock rounded down to the day is a daily bar's stamp
+constexpr time_record_t utcDayStart(int year, int month, int day) {
+  year            -= month <= 2;
+  const qint64 era = (year >= 0 ? year : year - 399) / 400;
+  const qint64 yoe = year - era * 400;
+  const qint64 doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const qint64 doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return (era * 146097 + doe - 719468) * 24 * 60 * 60;
+}
+
+// "yyyy-MM-dd", "yyyy-MM-dd hh:mm" or "yyyy-MM-dd hh:mm:ss", with 'T' for the space or '/' for the dashes. Gives the
+// wall-clock time as seconds since 1970-01-01 00:00 of the same clock (utcDayStart plus the time of day); false if the
+// layout does not match or a field is out of range (2025-02-30, 24:00)
+bool parseWallClock(const char *begin, const char *end, time_record_t &wallClock);
+
+// Seconds to add to a US/Eastern wall-clock time (as above) to get UTC: 4 hours in daylight saving time, 5 otherwise.
+// Follows the US rules since 1967 (2007 on: second Sunday of March to first Sunday of November). A time skipped by the
+// spring change counts as daylight time, a repeated one in the fall as its first (daylight) occurrence.
+qint64 easternUtcOffset(time_record_t wallClock);
+
+// The other way: the US/Eastern wall-clock time of UTC epoch seconds. The hour before the spring change reads an hour late,
+// as the skipped hour above. Sessions run from 4:00 to 20:00 Eastern, so its day is the trading date whatever the UTC day
+time_record_t easternWallClock(time_record_t time);
+
+// A US/Eastern key (any parseWallClock layout) to UTC epoch seconds, a plain date is its 00:00 Eastern
+bool parseEasternTimestamp(const char *begin, const char *end, time_record_t &time);
+
+#endif